@@ -0,0 +1,408 @@
+// Kernel benchmark: runs every command type on synthetic maps over a range of
+// resolutions, point counts and thread counts and reports the throughput.
+// Usage: mstbench [options]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Stdafx.h"
+#include "CommandBuffer.hpp"
+#include "CmdDistance.hpp"
+#include "PerfCounters.hpp"
+#include "ThreadPool.hpp"
+#include "WorkCounters.hpp"
+
+/// Size of the synthetic maps in world units (square).
+const float WORLD_SIZE = 256.0f;
+/// Number of points of the small layers which feed the blend commands.
+const int BLEND_INPUT_POINTS = 16;
+
+// ************************************************************************* //
+struct Options
+{
+	std::vector<int> Resolutions;
+	std::vector<int> PointCounts;
+	std::vector<int> ThreadCounts;
+	int Repetitions;
+	unsigned int Seed;
+	bool Json;
+	bool UseCounters;		///< Capture hardware counters (timings include their overhead).
+	bool UseWork;			///< Report the work counters (requires MST_WORK_COUNTERS).
+	std::string OutputFile;
+};
+
+/// \brief One synthetic map.
+struct Workload
+{
+	const char* Name;
+	bool UsesPoints;		///< Runs once per point count, otherwise once with 0 points.
+	bool IsMST;				///< Times ComputeMST directly instead of a pipeline.
+	std::string (*CreateLayers)(std::mt19937& random, int numPoints);
+};
+
+/// \brief Timings of one workload/resolution/points/threads combination.
+struct Result
+{
+	std::string Workload;
+	int Resolution;
+	int Points;
+	int Threads;
+	int Repetitions;
+	double MeanMs;
+	double StdDevMs;
+	double MinMs;
+	double Throughput;		///< Pixels (or points for ComputeMST) per second.
+	double Efficiency;		///< Speedup over the smallest thread count divided by the thread ratio.
+	bool HasCounters;
+	CounterValues Counters;	///< Mean of all repetitions.
+	WorkStats Work;			///< Work of all repetitions.
+	double PixelsPerRun;
+};
+
+// ************************************************************************* //
+static std::string CreatePoints( std::mt19937& random, int numPoints )
+{
+	std::uniform_real_distribution<float> position( 0.0f, WORLD_SIZE );
+	std::uniform_real_distribution<float> height( 0.0f, 1.0f );
+	std::ostringstream json;
+	json << "\"PointSet\": {\"Points\": [";
+	for( int i=0; i<numPoints; ++i )
+	{
+		if( i > 0 ) json << ",";
+		float x = position( random );
+		float y = position( random );
+		json << "[" << x << "," << y << "," << height( random ) << "]";
+	}
+	json << "]}";
+	return json.str();
+}
+
+static std::vector<Vec3> CreatePointList( std::mt19937& random, int numPoints )
+{
+	std::uniform_real_distribution<float> position( 0.0f, WORLD_SIZE );
+	std::uniform_real_distribution<float> height( 0.0f, 1.0f );
+	std::vector<Vec3> points( numPoints );
+	for( int i=0; i<numPoints; ++i )
+	{
+		points[i].x = position( random );
+		points[i].y = position( random );
+		points[i].z = height( random );
+	}
+	return points;
+}
+
+static std::string PointLayer( std::mt19937& random, const char* type, int numPoints, const char* extra = "" )
+{
+	return std::string("{\"Type\": \"") + type + "\", \"Height\": 10, " + extra + CreatePoints( random, numPoints ) + "}";
+}
+
+// Two Voronoi layers where the second one is blended onto the first one.
+static std::string BlendLayers( std::mt19937& random, const char* blending )
+{
+	std::string extra = std::string("\"Blending\": \"") + blending + "\", \"BlendFactor\": 0.5, ";
+	return PointLayer( random, "Voronoi", BLEND_INPUT_POINTS ) + ",\n"
+		+ PointLayer( random, "Voronoi", BLEND_INPUT_POINTS, extra.c_str() );
+}
+
+static const Workload WORKLOADS[] = {
+	{ "MST Distance", true, false, [](std::mt19937& r, int n){ return PointLayer( r, "MST Distance", n, "\"QuadraticSpline\": 0.3, " ); } },
+	{ "MST Inverse Distance", true, false, [](std::mt19937& r, int n){ return PointLayer( r, "MST Inverse Distance", n, "\"QuadraticSpline\": 0.3, " ); } },
+	{ "Voronoi", true, false, [](std::mt19937& r, int n){ return PointLayer( r, "Voronoi", n ); } },
+	{ "Worley Noise", true, false, [](std::mt19937& r, int n){ return PointLayer( r, "Worley Noise", n, "\"NthNeighbor\": 1, " ); } },
+	{ "Value Noise", false, false, [](std::mt19937&, int){ return std::string("{\"Type\": \"Value Noise\", \"Height\": 10}"); } },
+	{ "Voronoise", false, false, [](std::mt19937&, int){ return std::string("{\"Type\": \"Voronoise\", \"Height\": 10, \"MinOctave\": 1, \"MaxOctave\": 6}"); } },
+	{ "ADDITIVE", false, false, [](std::mt19937& r, int){ return BlendLayers( r, "ADDITIVE" ); } },
+	{ "MULTIPLICATIVE", false, false, [](std::mt19937& r, int){ return BlendLayers( r, "MULTIPLICATIVE" ); } },
+	{ "INTERPOLATE", false, false, [](std::mt19937& r, int){ return BlendLayers( r, "INTERPOLATE" ); } },
+	{ "REFRACTIVE", false, false, [](std::mt19937& r, int){ return BlendLayers( r, "REFRACTIVE" ); } },
+	{ "ComputeMST", true, true, nullptr },
+};
+
+// ************************************************************************* //
+static std::vector<int> ParseList( const char* list )
+{
+	std::vector<int> values;
+	std::stringstream stream( list );
+	std::string item;
+	while( std::getline( stream, item, ',' ) )
+	{
+		int value = atoi( item.c_str() );
+		if( value > 0 ) values.push_back( value );
+	}
+	return values;
+}
+
+static void PrintUsage()
+{
+	printf( "Usage: mstbench [options]\n"
+			"  --resolutions <a,b,..>  Square map resolutions (default 256,512).\n"
+			"  --points <a,b,..>       Point counts of the point based layers (default 100,1000).\n"
+			"  --threads <a,b,..>      Thread counts (default 1 and all cores).\n"
+			"  --repetitions <n>       Timed runs per combination (default 5).\n"
+			"  --seed <n>              Seed of the synthetic maps and the noise (default 0).\n"
+			"  --workload <name>       Only run workloads which contain the name.\n"
+			"  --counters              Add hardware counters (Linux perf) to the report.\n"
+			"  --work                  Add the work counters (build with MST_WORK_COUNTERS).\n"
+			"  --format <csv|json>     Output format (default csv).\n"
+			"  --output <file>         Write the report to a file instead of stdout.\n" );
+}
+
+// ************************************************************************* //
+/// \brief Mean, standard deviation and minimum of the timings.
+static void Statistics( const std::vector<double>& times, Result& result )
+{
+	double sum = 0.0;
+	for( size_t i=0; i<times.size(); ++i ) sum += times[i];
+	result.MeanMs = sum / times.size();
+	double variance = 0.0;
+	for( size_t i=0; i<times.size(); ++i )
+		variance += (times[i] - result.MeanMs) * (times[i] - result.MeanMs);
+	result.StdDevMs = times.size() > 1 ? sqrt( variance / (times.size() - 1) ) : 0.0;
+	result.MinMs = *std::min_element( times.begin(), times.end() );
+}
+
+static double MillisecondsSince( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string CreateMap( const Workload& workload, unsigned int seed, int numPoints )
+{
+	std::mt19937 random( seed );
+	std::ostringstream json;
+	json << "{\"HeightmapWidth\": " << WORLD_SIZE << ", \"HeightmapHeight\": " << WORLD_SIZE
+		<< ", \"HeightmapPixelPerWorldUnit\": 1, \"Layers\": [\n"
+		<< workload.CreateLayers( random, numPoints ) << "\n]}";
+	return json.str();
+}
+
+static void AverageCounters( const Options& options, Result& result )
+{
+	CounterValues& counters = result.Counters;
+	if( !result.HasCounters ) counters = CounterValues();
+	counters.Cycles /= options.Repetitions;
+	counters.Instructions /= options.Repetitions;
+	counters.CacheMisses /= options.Repetitions;
+	counters.BranchMisses /= options.Repetitions;
+}
+
+/// \brief Time a whole pipeline. The first run does the precomputation
+///		and is not part of the result.
+static void RunPipeline( const Workload& workload, const Options& options, int resolution, int numPoints, Result& result )
+{
+	GeneratorPipeline pipeline( CreateMap( workload, options.Seed, numPoints ) );
+	std::vector<float> map( size_t(resolution) * resolution );
+	pipeline.Execute( resolution, resolution, map.data(), false, options.Seed );
+	ResetWorkCounters();
+
+	std::vector<double> times( options.Repetitions );
+	result.HasCounters = options.UseCounters;
+	for( int i=0; i<options.Repetitions; ++i )
+	{
+		ExecutionStats stats;
+		stats.UseHardwareCounters = options.UseCounters;
+		auto start = std::chrono::steady_clock::now();
+		pipeline.Execute( resolution, resolution, map.data(), false, options.Seed, options.UseCounters ? &stats : nullptr );
+		times[i] = MillisecondsSince( start );
+		result.HasCounters &= stats.HasHardwareCounters;
+		for( size_t c=0; c<stats.Commands.size(); ++c )
+			result.Counters += stats.Commands[c].Counters;
+	}
+	Statistics( times, result );
+	AverageCounters( options, result );
+	if( options.UseWork ) CollectWorkCounters( result.Work );
+	result.PixelsPerRun = double(resolution) * resolution;
+	result.Throughput = result.PixelsPerRun / (result.MeanMs * 0.001);
+}
+
+/// \brief Time the construction of the spanning tree alone (single threaded).
+static void RunMST( const Options& options, int numPoints, Result& result )
+{
+	std::mt19937 random( options.Seed );
+	std::vector<Vec3> points = CreatePointList( random, numPoints );
+	std::vector<double> times( options.Repetitions );
+	result.HasCounters = options.UseCounters;
+	for( int i=0; i<options.Repetitions; ++i )
+	{
+		CounterValues begin, end;
+		result.HasCounters &= options.UseCounters && ReadThreadCounters( begin );
+		auto start = std::chrono::steady_clock::now();
+		OrE::ADT::Mesh* mst = ComputeMST( points.data(), numPoints, 1.0f );
+		times[i] = MillisecondsSince( start );
+		result.HasCounters &= options.UseCounters && ReadThreadCounters( end );
+		result.Counters += end - begin;
+		delete mst;
+	}
+	Statistics( times, result );
+	AverageCounters( options, result );
+	result.PixelsPerRun = 0.0;
+	result.Throughput = numPoints / (result.MeanMs * 0.001);
+}
+
+// ************************************************************************* //
+// Mean work per pixel of the map.
+static double WorkPerPixel( const Result& result, int counter )
+{
+	double pixels = result.PixelsPerRun * result.Repetitions;
+	return pixels > 0.0 ? double(result.Work.Total[counter]) / pixels : 0.0;
+}
+
+static void WriteCSV( FILE* file, const std::vector<Result>& results )
+{
+	fprintf( file, "workload,resolution,points,threads,repetitions,mean_ms,stddev_ms,min_ms,cv,throughput,unit,efficiency,"
+		"cycles,instructions,ipc,cache_misses,branch_misses" );
+	for( int c=0; c<NUM_WORK_COUNTERS; ++c )
+		fprintf( file, ",%s_per_pixel", WorkStats::GetName( c ) );
+	fprintf( file, "\n" );
+	for( size_t i=0; i<results.size(); ++i )
+	{
+		const Result& r = results[i];
+		fprintf( file, "%s,%d,%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%.1f,%s,%.3f,%llu,%llu,%.3f,%llu,%llu",
+			r.Workload.c_str(), r.Resolution, r.Points, r.Threads, r.Repetitions,
+			r.MeanMs, r.StdDevMs, r.MinMs, r.StdDevMs / r.MeanMs, r.Throughput,
+			r.Resolution > 0 ? "pixels/s" : "points/s", r.Efficiency,
+			(unsigned long long)r.Counters.Cycles, (unsigned long long)r.Counters.Instructions, r.Counters.GetIPC(),
+			(unsigned long long)r.Counters.CacheMisses, (unsigned long long)r.Counters.BranchMisses );
+		for( int c=0; c<NUM_WORK_COUNTERS; ++c )
+			fprintf( file, ",%.2f", WorkPerPixel( r, c ) );
+		fprintf( file, "\n" );
+	}
+}
+
+static void WriteJSON( FILE* file, const std::vector<Result>& results, const Options& options )
+{
+	fprintf( file, "{\n  \"seed\": %u,\n  \"hardware_threads\": %u,\n  \"results\": [\n",
+		options.Seed, std::thread::hardware_concurrency() );
+	for( size_t i=0; i<results.size(); ++i )
+	{
+		const Result& r = results[i];
+		fprintf( file, "    {\"workload\": \"%s\", \"resolution\": %d, \"points\": %d, \"threads\": %d, "
+			"\"repetitions\": %d, \"mean_ms\": %.4f, \"stddev_ms\": %.4f, \"min_ms\": %.4f, \"cv\": %.4f, "
+			"\"throughput\": %.1f, \"unit\": \"%s\", \"efficiency\": %.3f, "
+			"\"cycles\": %llu, \"instructions\": %llu, \"ipc\": %.3f, \"cache_misses\": %llu, \"branch_misses\": %llu",
+			r.Workload.c_str(), r.Resolution, r.Points, r.Threads, r.Repetitions,
+			r.MeanMs, r.StdDevMs, r.MinMs, r.StdDevMs / r.MeanMs, r.Throughput,
+			r.Resolution > 0 ? "pixels/s" : "points/s", r.Efficiency,
+			(unsigned long long)r.Counters.Cycles, (unsigned long long)r.Counters.Instructions, r.Counters.GetIPC(),
+			(unsigned long long)r.Counters.CacheMisses, (unsigned long long)r.Counters.BranchMisses );
+		// Work per pixel and the histogram of each kind of work.
+		if( options.UseWork )
+		{
+			fprintf( file, ", \"work\": {" );
+			for( int c=0; c<NUM_WORK_COUNTERS; ++c )
+			{
+				fprintf( file, "%s\"%s\": {\"per_pixel\": %.2f, \"histogram\": [", c ? ", " : "", WorkStats::GetName( c ), WorkPerPixel( r, c ) );
+				for( int b=0; b<WORK_HISTOGRAM_SIZE; ++b )
+					fprintf( file, "%s%llu", b ? "," : "", (unsigned long long)r.Work.Histogram[c][b] );
+				fprintf( file, "]}" );
+			}
+			fprintf( file, "}" );
+		}
+		fprintf( file, "}%s\n", i + 1 < results.size() ? "," : "" );
+	}
+	fprintf( file, "  ]\n}\n" );
+}
+
+// ************************************************************************* //
+int main( int argc, char** argv )
+{
+	Options options;
+	options.Resolutions = { 256, 512 };
+	options.PointCounts = { 100, 1000 };
+	options.ThreadCounts = { 1 };
+	int hardwareThreads = int(std::max(1u, std::thread::hardware_concurrency()));
+	if( hardwareThreads > 1 ) options.ThreadCounts.push_back( hardwareThreads );
+	options.Repetitions = 5;
+	options.Seed = 0;
+	options.Json = false;
+	options.UseCounters = false;
+	options.UseWork = false;
+	std::string filter;
+	for( int i=1; i<argc; ++i )
+	{
+		if( !strcmp( argv[i], "--resolutions" ) && i+1 < argc )
+			options.Resolutions = ParseList( argv[++i] );
+		else if( !strcmp( argv[i], "--points" ) && i+1 < argc )
+			options.PointCounts = ParseList( argv[++i] );
+		else if( !strcmp( argv[i], "--threads" ) && i+1 < argc )
+			options.ThreadCounts = ParseList( argv[++i] );
+		else if( !strcmp( argv[i], "--repetitions" ) && i+1 < argc )
+			options.Repetitions = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "--seed" ) && i+1 < argc )
+			options.Seed = (unsigned int)strtoul( argv[++i], nullptr, 10 );
+		else if( !strcmp( argv[i], "--workload" ) && i+1 < argc )
+			filter = argv[++i];
+		else if( !strcmp( argv[i], "--counters" ) )
+			options.UseCounters = true;
+		else if( !strcmp( argv[i], "--work" ) )
+			options.UseWork = true;
+		else if( !strcmp( argv[i], "--format" ) && i+1 < argc )
+			options.Json = !strcmp( argv[++i], "json" );
+		else if( !strcmp( argv[i], "--output" ) && i+1 < argc )
+			options.OutputFile = argv[++i];
+		else {
+			fprintf( stderr, "Unknown option %s\n", argv[i] );
+			PrintUsage();
+			return 1;
+		}
+	}
+	if( options.Resolutions.empty() || options.PointCounts.empty()
+		|| options.ThreadCounts.empty() || options.Repetitions <= 0 )
+	{
+		PrintUsage();
+		return 1;
+	}
+	std::sort( options.ThreadCounts.begin(), options.ThreadCounts.end() );
+
+	std::vector<Result> results;
+	for( const Workload& workload : WORKLOADS )
+	{
+		if( !filter.empty() && std::string(workload.Name).find( filter ) == std::string::npos )
+			continue;
+		std::vector<int> pointCounts = workload.UsesPoints ? options.PointCounts : std::vector<int>(1, 0);
+		// The spanning tree does not depend on the resolution or the pool.
+		std::vector<int> resolutions = workload.IsMST ? std::vector<int>(1, 0) : options.Resolutions;
+		std::vector<int> threadCounts = workload.IsMST ? std::vector<int>(1, 1) : options.ThreadCounts;
+		for( int resolution : resolutions )
+			for( int numPoints : pointCounts )
+			{
+				double baseTime = 0.0;
+				for( size_t t=0; t<threadCounts.size(); ++t )
+				{
+					ThreadPool::Get().SetNumThreads( threadCounts[t] );
+					Result result;
+					result.Workload = workload.Name;
+					result.Resolution = resolution;
+					result.Points = numPoints;
+					result.Threads = threadCounts[t];
+					result.Repetitions = options.Repetitions;
+					if( workload.IsMST ) RunMST( options, numPoints, result );
+					else RunPipeline( workload, options, resolution, numPoints, result );
+					if( t == 0 ) baseTime = result.MeanMs * threadCounts[0];
+					result.Efficiency = baseTime / (result.MeanMs * threadCounts[t]);
+					results.push_back( result );
+					fprintf( stderr, "%s %d px %d points %d threads: %.2f ms\n",
+						workload.Name, resolution, numPoints, threadCounts[t], result.MeanMs );
+				}
+			}
+	}
+
+	FILE* file = options.OutputFile.empty() ? stdout : fopen( options.OutputFile.c_str(), "w" );
+	if( !file )
+	{
+		fprintf( stderr, "Cannot write %s\n", options.OutputFile.c_str() );
+		return 1;
+	}
+	if( options.Json ) WriteJSON( file, results, options );
+	else WriteCSV( file, results );
+	if( file != stdout ) fclose( file );
+	return 0;
+}
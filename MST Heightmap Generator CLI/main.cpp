@@ -0,0 +1,187 @@
+// Headless generator: renders a json map into a raw float or PGM file.
+// Usage: mstgen <map.json> <width> <height> <output.raw|output.pgm> [options]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "CApi.h"
+
+// ************************************************************************* //
+static double MillisecondsSince( std::chrono::steady_clock::time_point start )
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void PrintUsage()
+{
+	printf( "Usage: mstgen <map.json> <width> <height> <output.raw|output.pgm> [options]\n"
+			"  --seed <n>         Seed of the noise layers (default 0).\n"
+			"  --snapshot <file>  Load or create precomputed data (e.g. MSTs).\n"
+			"  --no-normalize     Write the heights without scaling them to [0,1] (raw only).\n"
+			"  --trace <file>     Write a Chrome trace event file of the execution.\n"
+			"  --progress         Show the progress of the execution.\n"
+			"  --memory-limit <MB> Fail instead of using more memory for the map buffers\n"
+			"                     and precomputed data.\n"
+			"Raw files contain width*height 32 bit floats (row major). PGM files are\n"
+			"16 bit binary grayscale images.\n" );
+}
+
+// ************************************************************************* //
+static bool WriteRaw( const std::string& fileName, const std::vector<float>& data )
+{
+	FILE* file = fopen( fileName.c_str(), "wb" );
+	if( !file ) return false;
+	bool success = fwrite( data.data(), sizeof(float), data.size(), file ) == data.size();
+	success &= fclose( file ) == 0;
+	return success;
+}
+
+// 16 bit PGM (big endian). The data must be in [0,1].
+static bool WritePGM( const std::string& fileName, const std::vector<float>& data, int width, int height )
+{
+	std::vector<unsigned char> pixels( data.size() * 2 );
+	for( size_t i=0; i<data.size(); ++i )
+	{
+		float value = data[i] < 0.0f ? 0.0f : (data[i] > 1.0f ? 1.0f : data[i]);
+		unsigned int gray = (unsigned int)(value * 65535.0f + 0.5f);
+		pixels[2*i] = (unsigned char)(gray >> 8);
+		pixels[2*i+1] = (unsigned char)(gray & 0xff);
+	}
+	FILE* file = fopen( fileName.c_str(), "wb" );
+	if( !file ) return false;
+	bool success = fprintf( file, "P5\n%d %d\n65535\n", width, height ) > 0;
+	success &= fwrite( pixels.data(), 1, pixels.size(), file ) == pixels.size();
+	success &= fclose( file ) == 0;
+	return success;
+}
+
+// Progress line on stderr, so the output stays clean.
+static int PrintProgress( float progress, void* )
+{
+	fprintf( stderr, "\r%3d%%", int(progress * 100.0f) );
+	return 0;
+}
+
+static bool EndsWith( const std::string& string, const char* suffix )
+{
+	size_t length = strlen( suffix );
+	return string.size() >= length && string.compare( string.size() - length, length, suffix ) == 0;
+}
+
+// ************************************************************************* //
+int main( int argc, char** argv )
+{
+	if( argc < 5 )
+	{
+		PrintUsage();
+		return 1;
+	}
+	std::string scriptFile = argv[1];
+	int width = atoi( argv[2] );
+	int height = atoi( argv[3] );
+	std::string outputFile = argv[4];
+	unsigned int seed = 0;
+	std::string snapshotFile;
+	std::string traceFile;
+	bool normalize = true;
+	bool showProgress = false;
+	size_t memoryLimit = 0;
+	for( int i=5; i<argc; ++i )
+	{
+		if( !strcmp( argv[i], "--seed" ) && i+1 < argc )
+			seed = (unsigned int)strtoul( argv[++i], nullptr, 10 );
+		else if( !strcmp( argv[i], "--snapshot" ) && i+1 < argc )
+			snapshotFile = argv[++i];
+		else if( !strcmp( argv[i], "--trace" ) && i+1 < argc )
+			traceFile = argv[++i];
+		else if( !strcmp( argv[i], "--memory-limit" ) && i+1 < argc )
+			memoryLimit = size_t(strtoull( argv[++i], nullptr, 10 )) * 1024 * 1024;
+		else if( !strcmp( argv[i], "--progress" ) )
+			showProgress = true;
+		else if( !strcmp( argv[i], "--no-normalize" ) )
+			normalize = false;
+		else {
+			fprintf( stderr, "Unknown option %s\n", argv[i] );
+			PrintUsage();
+			return 1;
+		}
+	}
+	bool isPGM = EndsWith( outputFile, ".pgm" );
+	if( width <= 0 || height <= 0 )
+	{
+		fprintf( stderr, "Invalid resolution %s x %s\n", argv[2], argv[3] );
+		return 1;
+	}
+	if( isPGM && !normalize )
+	{
+		fprintf( stderr, "PGM output requires normalized heights.\n" );
+		return 1;
+	}
+
+	// Load
+	auto start = std::chrono::steady_clock::now();
+	std::ifstream scriptStream( scriptFile, std::ios::binary );
+	if( !scriptStream )
+	{
+		fprintf( stderr, "Cannot open %s\n", scriptFile.c_str() );
+		return 1;
+	}
+	std::stringstream script;
+	script << scriptStream.rdbuf();
+	std::string json = script.str();
+	MstPipeline* pipeline = mstCreatePipeline( json.data(), json.size(),
+		snapshotFile.empty() ? nullptr : snapshotFile.c_str() );
+	if( !pipeline )
+	{
+		fprintf( stderr, "Invalid map %s\n", scriptFile.c_str() );
+		return 1;
+	}
+	double loadTime = MillisecondsSince( start );
+	mstSetMemoryLimit( pipeline, memoryLimit );
+
+	// Generate
+	start = std::chrono::steady_clock::now();
+	std::vector<float> map( size_t(width) * height );
+	int result;
+	if( !traceFile.empty() )
+		result = mstExecutePipelineTraced( pipeline, width, height, map.data(), normalize ? 1 : 0, seed, traceFile.c_str() );
+	else if( showProgress )
+	{
+		result = mstExecutePipelineWithProgress( pipeline, width, height, map.data(), normalize ? 1 : 0, seed, PrintProgress, nullptr );
+		fprintf( stderr, "\n" );
+	} else
+		result = mstExecutePipeline( pipeline, width, height, map.data(), normalize ? 1 : 0, seed );
+	double executeTime = MillisecondsSince( start );
+	mstDestroyPipeline( pipeline );
+	if( result == -2 )
+		fprintf( stderr, "Cannot write %s\n", traceFile.c_str() );
+	else if( result == -3 )
+	{
+		fprintf( stderr, "Memory limit of %s MB exceeded\n", std::to_string( memoryLimit / (1024 * 1024) ).c_str() );
+		return 1;
+	}
+	else if( result != 0 )
+	{
+		fprintf( stderr, "Execution failed\n" );
+		return 1;
+	}
+
+	// Save
+	start = std::chrono::steady_clock::now();
+	bool saved = isPGM ? WritePGM( outputFile, map, width, height ) : WriteRaw( outputFile, map );
+	double writeTime = MillisecondsSince( start );
+	if( !saved )
+	{
+		fprintf( stderr, "Cannot write %s\n", outputFile.c_str() );
+		return 1;
+	}
+
+	printf( "%s %dx%d: load %.1f ms, execute %.1f ms, write %.1f ms\n",
+		scriptFile.c_str(), width, height, loadTime, executeTime, writeTime );
+	return 0;
+}
@@ -9,6 +9,9 @@ namespace MST_Heightmap_Generator_GUI.Layers
         [LayerAttributes.LayerAttributeFloat(Default = 0.3, MinValue = 0.0f, MaxValue = 1.0f, Name = "Quadratic Spline")]
         public float QuadraticSpline { get; set; }
 
+        [LayerAttributes.LayerAttributeFloat(Default = 0.0, MinValue = 0.0f, MaxValue = 1.0f, Name = "Tolerance")]
+        public float Tolerance { get; set; }
+
         [LayerAttributes.LayerAttributePointSet(InvertedPointSetRendering = false)]
         public PointSet PointSet { get; set; }
     }
@@ -21,6 +24,9 @@ namespace MST_Heightmap_Generator_GUI.Layers
         [LayerAttributes.LayerAttributeFloat(Default = 0.3, MinValue = 0.0f, MaxValue = 1.0f, Name = "Quadratic Spline")]
         public float QuadraticSpline { get; set; }
 
+        [LayerAttributes.LayerAttributeFloat(Default = 0.0, MinValue = 0.0f, MaxValue = 1.0f, Name = "Tolerance")]
+        public float Tolerance { get; set; }
+
         [LayerAttributes.LayerAttributePointSet(InvertedPointSetRendering = true)]
         public PointSet PointSet { get; set; }
     }
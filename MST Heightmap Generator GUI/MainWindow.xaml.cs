@@ -131,7 +131,8 @@ namespace MST_Heightmap_Generator_GUI
             terrainRenderingPreview.DeactivateRendering = true;
 
             int resolution = GetResolution();
-            heightmapData = new float[resolution, resolution];
+            // The old map stays valid if the generation is cancelled.
+            float[,] newHeightmapData = new float[resolution, resolution];
 
             // predeclare progress bar
             ProgressBar progressBar = null;
@@ -140,13 +141,15 @@ namespace MST_Heightmap_Generator_GUI
             long heightmapGentimeMS = 0;
             
             string json = SerializeSettingsToJSON();    // access to stuff from this thread - not possible in Task
+            var pipeline = new MstBasedHeightmap.GeneratorPipeline(json);
+            bool isComplete = false;
             Task generateTask = new Task(() =>
                 {
                     try
                     {
                         Stopwatch sw = new Stopwatch();
                         sw.Start();
-                        new MstBasedHeightmap.GeneratorPipeline(json).Execute(heightmapData);
+                        isComplete = pipeline.Execute(newHeightmapData);
                         heightmapGentimeMS = sw.ElapsedMilliseconds;
                     }
                     catch
@@ -156,9 +159,18 @@ namespace MST_Heightmap_Generator_GUI
                 });
             generateTask.Start();
 
-            progressBar = new ProgressBar(() => generateTask.IsCompleted ||generateTask.IsCanceled || generateTask.IsFaulted);
+            progressBar = new ProgressBar(() => generateTask.IsCompleted ||generateTask.IsCanceled || generateTask.IsFaulted,
+                                          () => pipeline.Progress, () => pipeline.Cancel());
             progressBar.TaskDescription.Content = "Generating Heightmap ...";
             progressBar.ShowDialog();
+            pipeline.Dispose();
+
+            if (!isComplete)
+            {
+                terrainRenderingPreview.DeactivateRendering = false;
+                return;
+            }
+            heightmapData = newHeightmapData;
 
             // upload to graphics cards (needs to stay in mainthread!
             terrainRenderingPreview.LoadNewHeightMap(heightmapData, resolution / (float)MAP_SIZE);
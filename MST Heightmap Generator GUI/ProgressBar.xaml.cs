@@ -11,23 +11,45 @@ namespace MST_Heightmap_Generator_GUI
     /// </summary>
     public partial class ProgressBar : Window
     {
-        public ProgressBar(Func<bool> closeFunc)
+        private Action cancelAction;
+
+        /// <param name="closeFunc">Polled until it returns true, then the window closes.</param>
+        /// <param name="progressFunc">Optional finished fraction [0,1]. Without it the bar is indeterminate.</param>
+        /// <param name="cancelAction">Optional action of a cancel button.</param>
+        public ProgressBar(Func<bool> closeFunc, Func<float> progressFunc = null, Action cancelAction = null)
         {
             InitializeComponent();
 
+            this.cancelAction = cancelAction;
+            if (cancelAction != null)
+                CancelButton.Visibility = Visibility.Visible;
+            if (progressFunc != null)
+                Bar.IsIndeterminate = false;
+
             Action onIdle = null;
             onIdle = new Action(() =>
             {
                 if (closeFunc())
                     Close();
                 else
+                {
+                    if (progressFunc != null)
+                        Bar.Value = progressFunc();
                     this.Dispatcher.BeginInvoke(onIdle, DispatcherPriority.ApplicationIdle);
+                }
             });
             this.Dispatcher.BeginInvoke(onIdle, DispatcherPriority.ApplicationIdle);
 
             this.Loaded += ProgressBar_Loaded;
         }
 
+        void CancelButton_Click(object sender, RoutedEventArgs e)
+        {
+            CancelButton.IsEnabled = false;
+            TaskDescription.Content = "Cancelling ...";
+            cancelAction();
+        }
+
         void ProgressBar_Loaded(object sender, RoutedEventArgs e)
         {
             var hwnd = new WindowInteropHelper(this).Handle;
@@ -0,0 +1,161 @@
+#include <cassert>
+#include <cstdlib>
+#include "BufferArena.hpp"
+#include "CommandInfo.h"
+#include "MemoryAccount.hpp"
+#include "math.hpp"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/// Granularity of the parallel first touch of new memory.
+const size_t ARENA_TOUCH_PAGE_SIZE = 4096;
+
+// ************************************************************************* //
+BufferArena::BufferArena() :
+	_memory(nullptr),
+	_capacity(0),
+	_blockSize(0),
+	_isExternal(false),
+	_useHugePages(false),
+	_offset(0),
+	_peak(0),
+	_allocatedBytes(0),
+	_account(nullptr),
+	_enforceLimit(false)
+{
+}
+
+BufferArena::~BufferArena()
+{
+	Release(0);
+	if( !_isExternal )
+		FreeBlock(_memory, _blockSize);
+}
+
+// ************************************************************************* //
+char* BufferArena::AllocateBlock( size_t& size )
+{
+	size_t alignment = _useHugePages ? ARENA_HUGE_PAGE_SIZE : ARENA_ALIGNMENT;
+	size = (size + alignment - 1) & ~(alignment - 1);
+	if( _account )
+	{
+		if( !_enforceLimit )
+			_account->Charge(size);
+		else if( !_account->TryCharge(size) )
+			return nullptr;
+	}
+#ifdef _WIN32
+	char* memory = (char*)_aligned_malloc(size, alignment);
+#else
+	char* memory = nullptr;
+	if( posix_memalign((void**)&memory, alignment, size) != 0 )
+		memory = nullptr;
+#ifdef MADV_HUGEPAGE
+	if( memory && _useHugePages )
+		madvise(memory, size, MADV_HUGEPAGE);
+#endif
+#endif
+	if( !memory )
+	{
+		// Callers with a limit handle the failure like an exceeded limit.
+		assert( _enforceLimit && "Out of memory" );
+		if( _account ) _account->Refund(size);
+		return nullptr;
+	}
+	_allocatedBytes += size;
+	return memory;
+}
+
+void BufferArena::FreeBlock( char* memory, size_t size )
+{
+	if( !memory ) return;
+	if( _account )
+		_account->Refund(size);
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+// ************************************************************************* //
+void BufferArena::SetWorkspace( void* memory, size_t size )
+{
+	assert( _offset == 0 && "Cannot change the workspace during an execution." );
+	if( !_isExternal )
+		FreeBlock(_memory, _blockSize);
+	_isExternal = memory != nullptr;
+	_memory = (char*)memory;
+	_capacity = memory ? size : 0;
+	_blockSize = 0;
+	// The user memory must be aligned too.
+	assert( (size_t(_memory) & (ARENA_ALIGNMENT-1)) == 0 && "Workspace must be 64 byte aligned." );
+}
+
+// ************************************************************************* //
+void BufferArena::Begin()
+{
+	Release(0);
+	// Resize only if the last run did not fit. The arena never shrinks.
+	if( !_isExternal && _peak > _capacity )
+	{
+		FreeBlock(_memory, _blockSize);
+		_blockSize = _peak;
+		_memory = AllocateBlock(_blockSize);
+		// Beyond the memory limit: the allocations fail during the run.
+		_capacity = _memory ? _peak : 0;
+		if( !_memory ) _blockSize = 0;
+
+		// First touch in parallel, so the page faults are not serialized
+		// inside the first kernel writing this memory.
+		char* memory = _memory;
+		int numPages = int((_capacity + ARENA_TOUCH_PAGE_SIZE - 1) / ARENA_TOUCH_PAGE_SIZE);
+		GenerateLines( numPages, [memory](int page, int num){
+			for( int i=page; i<page+num; ++i )
+				memory[size_t(i) * ARENA_TOUCH_PAGE_SIZE] = 0;
+		});
+	}
+	_peak = 0;
+}
+
+// ************************************************************************* //
+void* BufferArena::Allocate( size_t size )
+{
+	size = AlignedSize(size);
+	size_t offset = _offset;
+	if( offset + size <= _capacity )
+	{
+		_offset += size;
+		_peak = _peak > _offset ? _peak : _offset;
+		return _memory + offset;
+	}
+
+	// Does not fit into the main block. Use a temporary block which is
+	// released with the marker.
+	OverflowBlock block;
+	block.Offset = offset;
+	block.Size = size;
+	block.Memory = AllocateBlock(block.Size);
+	// A failed allocation changes nothing, the next Begin() does not
+	// try to grow to this size.
+	if( !block.Memory ) return nullptr;
+	_offset += size;
+	_peak = _peak > _offset ? _peak : _offset;
+	_overflow.push_back(block);
+	return block.Memory;
+}
+
+void BufferArena::Release( size_t marker )
+{
+	assert( marker <= _offset );
+	while( !_overflow.empty() && _overflow.back().Offset >= marker )
+	{
+		FreeBlock(_overflow.back().Memory, _overflow.back().Size);
+		_overflow.pop_back();
+	}
+	_offset = marker;
+}
\ No newline at end of file
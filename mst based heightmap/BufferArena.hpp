@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class MemoryAccount;
+
+/// Alignment of each allocation from a BufferArena (one cache line).
+const size_t ARENA_ALIGNMENT = 64;
+/// Alignment of the arena memory if huge pages are requested.
+const size_t ARENA_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/// \brief Stack like memory for all map buffers of GeneratorPipeline::Execute.
+/// \details The arena keeps its memory alive between two executions. During
+///		an execution allocations are taken from one large block. If the block
+///		is too small, additional blocks are allocated temporarily and the
+///		main block is enlarged to the peak usage at the next Begin(). So after
+///		the first run with the largest resolution no more allocations happen.
+///
+///		Instead of owning its memory the arena can use a workspace supplied
+///		by the user (SetWorkspace). It is never freed or resized then.
+///
+///		All owned blocks are charged to a MemoryAccount. If its limit is
+///		exceeded Allocate returns nullptr.
+class BufferArena
+{
+	char* _memory;				///< The main block (owned or external).
+	size_t _capacity;			///< Size of the main block in bytes.
+	size_t _blockSize;			///< Allocated size of an owned main block.
+	bool _isExternal;			///< _memory is a user workspace.
+	bool _useHugePages;			///< Align to 2MB and advise transparent huge pages.
+
+	size_t _offset;				///< Currently used bytes (may exceed the capacity).
+	size_t _peak;				///< Max. of _offset since the last Begin().
+	size_t _allocatedBytes;		///< Sum of all blocks requested from the OS.
+	MemoryAccount* _account;	///< Charged for all owned blocks or nullptr.
+	bool _enforceLimit;			///< Fail allocations beyond the limit of the account.
+
+	/// Blocks for allocations beyond the capacity. Each block starts at a
+	/// logical offset >= _capacity and is freed on release.
+	struct OverflowBlock { size_t Offset; char* Memory; size_t Size; };
+	std::vector<OverflowBlock> _overflow;
+
+	/// \param [inout] size Requested size, returns the allocated size.
+	/// \return nullptr if the limit of the account is exceeded.
+	char* AllocateBlock( size_t& size );
+	void FreeBlock( char* memory, size_t size );
+
+	// Prevent copy constructor and operator = being generated.
+	BufferArena(const BufferArena&);
+	BufferArena& operator = (const BufferArena&);
+public:
+	BufferArena();
+	~BufferArena();
+
+	/// \brief Use transparent huge pages for the owned memory (if supported
+	///		by the OS). Takes effect on the next reallocation.
+	void SetUseHugePages( bool useHugePages )	{ _useHugePages = useHugePages; }
+
+	/// \brief Charge all owned memory to an account.
+	/// \param [in] enforceLimit If true Allocate fails when the limit of the
+	///		account is exceeded. Otherwise the memory is only counted.
+	/// \details Must be set before the first allocation.
+	void SetAccount( MemoryAccount* account, bool enforceLimit )	{ _account = account; _enforceLimit = enforceLimit; }
+
+	/// \brief Use external memory instead of owning the main block.
+	/// \param [in] memory Workspace of the caller which must be alive as long
+	///		as the arena is used. nullptr switches back to owned memory.
+	/// \param [in] size Size of the workspace in bytes. If it is too small
+	///		the missing memory is allocated temporarily during each execution.
+	void SetWorkspace( void* memory, size_t size );
+
+	/// \brief Start of an execution. All previous allocations are invalid.
+	/// \details If the last execution needed more memory than available the
+	///		owned main block grows to this size. The new memory is touched
+	///		in parallel, so page faults do not happen in the kernels.
+	void Begin();
+
+	/// \brief Do not grow the main block to the usage since the last Begin()
+	///		(e.g. of a cancelled execution).
+	void DiscardPeak()	{ _peak = 0; }
+
+	/// \brief Get cache line aligned memory for count elements of type T.
+	/// \details Not thread safe. Allocate before starting parallel kernels.
+	/// \return nullptr if the memory limit of the account is exceeded.
+	template<typename T> T* Allocate( size_t count )	{ return (T*)Allocate( count * sizeof(T) ); }
+	void* Allocate( size_t size );
+
+	/// Markers allow to release everything allocated after GetMarker().
+	size_t GetMarker() const		{ return _offset; }
+	void Release( size_t marker );
+
+	/// \brief Number of bytes required by the last execution.
+	size_t GetPeakUsage() const		{ return _peak; }
+
+	/// \brief Total number of bytes allocated from the OS since the
+	///		construction (freed blocks are not subtracted).
+	size_t GetAllocatedBytes() const	{ return _allocatedBytes; }
+
+	/// \brief Size of an allocation including the alignment padding.
+	static size_t AlignedSize( size_t size )	{ return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1); }
+};
+
+/// \brief Releases all allocations of a scope on destruction.
+class ArenaScope
+{
+	BufferArena& _arena;
+	size_t _marker;
+
+	ArenaScope(const ArenaScope&);
+	ArenaScope& operator = (const ArenaScope&);
+public:
+	ArenaScope( BufferArena& arena ) : _arena(arena), _marker(arena.GetMarker())	{}
+	~ArenaScope()	{ _arena.Release(_marker); }
+};
\ No newline at end of file
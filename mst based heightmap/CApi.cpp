@@ -0,0 +1,208 @@
+#include "Stdafx.h"
+#include "CApi.h"
+#include "CommandBuffer.hpp"
+#include <new>
+
+// The handle is the pipeline itself.
+static GeneratorPipeline* ToPipeline( MstPipeline* pipeline )
+{
+	return reinterpret_cast<GeneratorPipeline*>(pipeline);
+}
+
+// Error codes of the execution functions.
+static int ToResult( ExecuteStatus status )
+{
+	switch( status )
+	{
+	case ExecuteStatus::OUT_OF_MEMORY: return -3;
+	case ExecuteStatus::CANCELLED: return -4;
+	default: return 0;
+	}
+}
+
+// Error code of the exception which is being handled. Exceptions must not
+// pass the C interface.
+static int ExceptionToResult()
+{
+	try { throw; }
+	catch( const std::bad_alloc& ) { return -3; }
+	catch( ... ) { return -6; }
+}
+
+/// Asynchronous execution with the C callback.
+struct MstAsync
+{
+	AsyncExecution Execution;
+	MstCompletionCallback Callback;
+	void* UserData;
+
+	MstAsync( float* buffer0, float* buffer1, MstCompletionCallback callback, void* userData );
+};
+
+static void ForwardCompletion( ExecuteStatus status, const float* map, void* userData )
+{
+	MstAsync* async = (MstAsync*)userData;
+	if( async->Callback )
+		async->Callback( ToResult( status ), map, async->UserData );
+}
+
+MstAsync::MstAsync( float* buffer0, float* buffer1, MstCompletionCallback callback, void* userData ) :
+	Execution( buffer0, buffer1, ForwardCompletion, this ),
+	Callback( callback ),
+	UserData( userData )
+{
+}
+
+// ************************************************************************* //
+MstPipeline* mstCreatePipeline( const char* json, size_t length, const char* snapshotFile )
+{
+	if( !json ) return nullptr;
+	try {
+		GeneratorPipeline* pipeline = new GeneratorPipeline( std::string(json, length),
+			snapshotFile ? std::string(snapshotFile) : std::string() );
+		if( !pipeline->IsValid() )
+		{
+			delete pipeline;
+			return nullptr;
+		}
+		return reinterpret_cast<MstPipeline*>(pipeline);
+	} catch( ... ) {
+		return nullptr;
+	}
+}
+
+// ************************************************************************* //
+int mstExecutePipeline( MstPipeline* pipeline, int resolutionX, int resolutionY,
+	float* destination, int normalize, unsigned int seed )
+{
+	if( !pipeline || !destination || resolutionX <= 0 || resolutionY <= 0 )
+		return -1;
+	try {
+		return ToResult( ToPipeline(pipeline)->Execute( resolutionX, resolutionY, destination, normalize != 0, seed ) );
+	} catch( ... ) {
+		return ExceptionToResult();
+	}
+}
+
+int mstExecutePipelineTraced( MstPipeline* pipeline, int resolutionX, int resolutionY,
+	float* destination, int normalize, unsigned int seed, const char* traceFile )
+{
+	if( !pipeline || !destination || !traceFile || resolutionX <= 0 || resolutionY <= 0 )
+		return -1;
+	try {
+		ExecutionStats stats;
+		int result = ToResult( ToPipeline(pipeline)->Execute( resolutionX, resolutionY, destination, normalize != 0, seed, &stats ) );
+		if( result != 0 ) return result;
+		return stats.WriteChromeTrace( traceFile ) ? 0 : -2;
+	} catch( ... ) {
+		return ExceptionToResult();
+	}
+}
+
+// Forwards the progress to the C callback which may cancel.
+struct ProgressForward
+{
+	MstProgressCallback Callback;
+	void* UserData;
+	ExecutionControl* Control;
+};
+
+static void ForwardProgress( float progress, void* userData )
+{
+	ProgressForward* forward = (ProgressForward*)userData;
+	if( forward->Callback( progress, forward->UserData ) != 0 )
+		forward->Control->Cancel();
+}
+
+int mstExecutePipelineWithProgress( MstPipeline* pipeline, int resolutionX, int resolutionY,
+	float* destination, int normalize, unsigned int seed, MstProgressCallback callback, void* userData )
+{
+	if( !pipeline || !destination || !callback || resolutionX <= 0 || resolutionY <= 0 )
+		return -1;
+	try {
+		ProgressForward forward = { callback, userData, nullptr };
+		ExecutionControl control( ForwardProgress, &forward );
+		forward.Control = &control;
+		return ToResult( ToPipeline(pipeline)->Execute( resolutionX, resolutionY, destination, normalize != 0, seed, nullptr, &control ) );
+	} catch( ... ) {
+		return ExceptionToResult();
+	}
+}
+
+int mstExecutePipelineProgressive( MstPipeline* pipeline, int resolutionX, int resolutionY,
+	float* destination, int normalize, unsigned int seed, MstPassCallback callback, void* userData )
+{
+	if( !pipeline || !destination || resolutionX <= 0 || resolutionY <= 0 )
+		return -1;
+	try {
+		return ToResult( ToPipeline(pipeline)->ExecuteProgressive( resolutionX, resolutionY, destination, normalize != 0, seed,
+			callback, userData ) );
+	} catch( ... ) {
+		return ExceptionToResult();
+	}
+}
+
+// ************************************************************************* //
+MstAsync* mstCreateAsync( float* buffer0, float* buffer1, MstCompletionCallback callback, void* userData )
+{
+	if( !buffer0 || !buffer1 || buffer0 == buffer1 ) return nullptr;
+	try {
+		return new MstAsync( buffer0, buffer1, callback, userData );
+	} catch( ... ) {
+		return nullptr;
+	}
+}
+
+int mstExecutePipelineAsync( MstPipeline* pipeline, MstAsync* async, int resolutionX, int resolutionY,
+	int normalize, unsigned int seed )
+{
+	if( !pipeline || !async || resolutionX <= 0 || resolutionY <= 0 )
+		return -1;
+	try {
+		return ToPipeline(pipeline)->ExecuteAsync( async->Execution, resolutionX, resolutionY, normalize != 0, seed ) ? 0 : -5;
+	} catch( ... ) {
+		return ExceptionToResult();
+	}
+}
+
+int mstWaitAsync( MstAsync* async )
+{
+	if( !async ) return -1;
+	try {
+		return ToResult( async->Execution.Wait() );
+	} catch( ... ) {
+		return ExceptionToResult();
+	}
+}
+
+const float* mstGetAsyncFront( MstAsync* async )
+{
+	return async ? async->Execution.GetFront() : nullptr;
+}
+
+void mstDestroyAsync( MstAsync* async )
+{
+	try {
+		delete async;
+	} catch( ... ) {
+	}
+}
+
+void mstSetMemoryLimit( MstPipeline* pipeline, size_t bytes )
+{
+	try {
+		if( pipeline )
+			ToPipeline(pipeline)->SetMemoryLimit( bytes );
+		else GeneratorPipeline::SetProcessMemoryLimit( bytes );
+	} catch( ... ) {
+	}
+}
+
+// ************************************************************************* //
+void mstDestroyPipeline( MstPipeline* pipeline )
+{
+	try {
+		delete ToPipeline(pipeline);
+	} catch( ... ) {
+	}
+}
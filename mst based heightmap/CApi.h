@@ -0,0 +1,129 @@
+#pragma once
+
+/// \file
+/// \brief Plain C interface of the generator for other languages and
+///		platforms without C++/CLI. All functions are thread safe in the same
+///		way as GeneratorPipeline: one pipeline can be executed concurrently.
+///		No exception leaves the functions: functions which return a result
+///		code return -3 for std::bad_alloc and -6 for other exceptions,
+///		functions which return a handle return NULL.
+
+#include <stddef.h>
+
+#if !defined(_WIN32)
+#define MST_API __attribute__((visibility("default")))
+#elif defined(DLL)
+#define MST_API __declspec(dllexport)
+#else
+#define MST_API __declspec(dllimport)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Opaque handle of a loaded GeneratorPipeline.
+typedef struct MstPipeline MstPipeline;
+
+/// \brief Load the commands of a json script.
+/// \param [in] json The script. It need not be null terminated.
+/// \param [in] length Number of bytes in json.
+/// \param [in] snapshotFile Optional file for the precomputed data (see
+///		GeneratorPipeline) or NULL.
+/// \return NULL if the script or one of its point set files is invalid
+///		or the pipeline cannot be created.
+MST_API MstPipeline* mstCreatePipeline( const char* json, size_t length, const char* snapshotFile );
+
+/// \brief Generate a map.
+/// \param [out] destination Caller owned buffer of resolutionX *
+///		resolutionY floats (row major).
+/// \param [in] normalize Non zero to scale the heights to [0,1].
+/// \param [in] seed Seed of all noise functions.
+/// \return 0 on success, -1 if an argument is invalid, -3 if the memory
+///		limit is exceeded (the destination is not changed then) or -6 on an
+///		internal error.
+MST_API int mstExecutePipeline( MstPipeline* pipeline, int resolutionX, int resolutionY,
+	float* destination, int normalize, unsigned int seed );
+
+/// \brief Generate a map like mstExecutePipeline and write a Chrome trace
+///		event file (chrome://tracing, Perfetto) with the timing of all
+///		layers and worker threads.
+/// \return 0 on success, -1 if an argument is invalid, -2 if the trace
+///		file cannot be written (the map is complete then), -3 if the
+///		memory limit is exceeded or -6 on an internal error.
+MST_API int mstExecutePipelineTraced( MstPipeline* pipeline, int resolutionX, int resolutionY,
+	float* destination, int normalize, unsigned int seed, const char* traceFile );
+
+/// \brief Receives the finished fraction [0,1] of an execution.
+/// \details Called from the worker threads, possibly concurrently.
+/// \return Non zero to cancel the execution.
+typedef int (*MstProgressCallback)( float progress, void* userData );
+
+/// \brief Generate a map like mstExecutePipeline and report the progress.
+/// \details A cancelled execution stops after the running tiles.
+/// \return 0 on success, -1 if an argument is invalid, -3 if the memory
+///		limit is exceeded, -4 if the callback cancelled the execution
+///		(the destination is incomplete then) or -6 on an internal error.
+MST_API int mstExecutePipelineWithProgress( MstPipeline* pipeline, int resolutionX, int resolutionY,
+	float* destination, int normalize, unsigned int seed, MstProgressCallback callback, void* userData );
+
+/// \brief Receives one pass of mstExecutePipelineProgressive.
+/// \param [in] map resolutionX * resolutionY samples, valid during the call.
+/// \param [in] stride Distance of the samples in pixels of the final map.
+typedef void (*MstPassCallback)( const float* map, int resolutionX, int resolutionY, int stride, void* userData );
+
+/// \brief Generate a map in passes from 1/8 to the full resolution (see
+///		GeneratorPipeline::ExecuteProgressive).
+/// \details The callback is called on the calling thread after each pass.
+/// \return Result code like mstExecutePipeline.
+MST_API int mstExecutePipelineProgressive( MstPipeline* pipeline, int resolutionX, int resolutionY,
+	float* destination, int normalize, unsigned int seed, MstPassCallback callback, void* userData );
+
+/// \brief Two caller owned maps for asynchronous executions (see
+///		AsyncExecution): one is written while the other one shows the last
+///		complete map.
+typedef struct MstAsync MstAsync;
+
+/// \brief Called on a worker thread when an asynchronous execution is
+///		finished.
+/// \param [in] result Result code like mstExecutePipeline.
+/// \param [in] map The new complete map or NULL if the execution failed.
+typedef void (*MstCompletionCallback)( int result, const float* map, void* userData );
+
+/// \param [in] buffer0, buffer1 Two maps of resolutionX * resolutionY floats
+///		for all executions.
+/// \param [in] callback Optional completion callback or NULL.
+/// \return NULL if a buffer is invalid.
+MST_API MstAsync* mstCreateAsync( float* buffer0, float* buffer1, MstCompletionCallback callback, void* userData );
+
+/// \brief Start generating a map into the back buffer and return at once.
+/// \details The pipeline must not be destroyed before the execution is
+///		finished.
+/// \return 0 if started, -1 if an argument is invalid, -5 if the last
+///		execution of async is not finished or -3/-6 if it cannot be started.
+MST_API int mstExecutePipelineAsync( MstPipeline* pipeline, MstAsync* async, int resolutionX, int resolutionY,
+	int normalize, unsigned int seed );
+
+/// \brief Block until the execution is finished.
+/// \return Result code of the last execution like mstExecutePipeline.
+MST_API int mstWaitAsync( MstAsync* async );
+
+/// \brief The last complete map or NULL before the first one.
+MST_API const float* mstGetAsyncFront( MstAsync* async );
+
+/// \brief Wait for the execution and release async. NULL is ignored.
+MST_API void mstDestroyAsync( MstAsync* async );
+
+/// \brief Limit the memory of a pipeline (point sets, precomputed data and
+///		map buffers). Executions which need more fail with -3.
+/// \param [in] pipeline The pipeline or NULL for a limit of all pipelines
+///		of the process together.
+/// \param [in] bytes The limit, 0 for none.
+MST_API void mstSetMemoryLimit( MstPipeline* pipeline, size_t bytes );
+
+/// \brief Release a pipeline. NULL is ignored.
+MST_API void mstDestroyPipeline( MstPipeline* pipeline );
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,14 +4,39 @@
 
 using namespace std::placeholders;
 
-float CmdBlendAdd::BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+float CmdBlendAdd::BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult )
 {
-	return currentResult[y*bufferInfo.ResolutionX+x];
+	return currentResult;
 }
 
-float CmdBlendAdd::BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+float CmdBlendAdd::BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult )
 {
-	return currentResult[y*bufferInfo.ResolutionX+x] + prevResult[y*bufferInfo.ResolutionX+x];
+	return currentResult + prevResult;
+}
+
+// Sums of constant tiles are constant.
+bool CmdBlendAdd::ComputeBounds( const MapBufferInfo& bufferInfo,
+						  const float* prevResult,
+						  const float* currentResult,
+						  const ExecutionContext& context,
+						  TileBounds& bounds ) const
+{
+	const TileBounds* prev = context.InputBounds[0];
+	const TileBounds* current = context.InputBounds[1];
+	if( !current || (prevResult && !prev) )
+		return false;
+	for( int t=0; t<bounds.GetNumTiles(); ++t )
+	{
+		const ValueRange& c = current->Tiles[t];
+		ValueRange& tile = bounds.Tiles[t];
+		if( !prevResult )
+			tile = c;
+		else if( c.IsConstant() && prev->Tiles[t].IsConstant() )
+			tile.Min = tile.Max = c.Min + prev->Tiles[t].Min;
+		else
+			tile = TileBounds::Bilinear( c, prev->Tiles[t], [](float a, float b){ return a + b; } );
+	}
+	return true;
 }
 
 // ************************************************************************* //
@@ -19,7 +44,8 @@ float CmdBlendAdd::BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, c
 void CmdBlendAdd::Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination)
+						  float* destination,
+						  const ExecutionContext& context)
 {
 	// Blending must have at least the one source
 	assert( currentResult );
@@ -33,7 +59,7 @@ void CmdBlendAdd::Execute( const MapBufferInfo& bufferInfo,
 	else kernel = std::bind(&CmdBlendAdd::BlendKernelNeutral, this, _1, _2, _3, _4, _5);
 	CommandDesc Cmd(bufferInfo, prevResult, currentResult,
 		kernel,
-		destination);
+		destination, context);
 
 	GenerateLayer(Cmd);
 }
\ No newline at end of file
@@ -4,10 +4,37 @@
 
 using namespace std::placeholders;
 
+// Interpolations of constant tiles are constant.
+bool CmdBlendInterpolate::ComputeBounds( const MapBufferInfo& bufferInfo,
+						  const float* prevResult,
+						  const float* currentResult,
+						  const ExecutionContext& context,
+						  TileBounds& bounds ) const
+{
+	const TileBounds* prev = context.InputBounds[0];
+	const TileBounds* current = context.InputBounds[1];
+	if( !current || (prevResult && !prev) )
+		return false;
+	for( int t=0; t<bounds.GetNumTiles(); ++t )
+	{
+		const ValueRange& c = current->Tiles[t];
+		ValueRange& tile = bounds.Tiles[t];
+		if( !prevResult )
+			tile = c;
+		else if( c.IsConstant() && prev->Tiles[t].IsConstant() )
+			tile.Min = tile.Max = lrp( prev->Tiles[t].Min, c.Min, _blendFactor );
+		else
+			tile = TileBounds::Bilinear( prev->Tiles[t], c, [this](float a, float b){ return lrp( a, b, _blendFactor ); } );
+	}
+	return true;
+}
+
+// ************************************************************************* //
 void CmdBlendInterpolate::Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination)
+						  float* destination,
+						  const ExecutionContext& context)
 {
 	// Blending must have at least the one source
 	assert( currentResult );
@@ -16,9 +43,16 @@ void CmdBlendInterpolate::Execute( const MapBufferInfo& bufferInfo,
 	if( prevResult )
 	{
 		CommandDesc Cmd(bufferInfo, prevResult, currentResult,
-			[&](const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult)
-				{ return lrp(prevResult[y*bufferInfo.ResolutionX+x], currentResult[y*bufferInfo.ResolutionX+x], _blendFactor); },
-			destination);
+			[&](const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult)
+				{ return lrp(prevResult, currentResult, _blendFactor); },
+			destination, context);
+		GenerateLayer(Cmd);
+	} else {
+		// Nothing to interpolate with -> copy the current result.
+		CommandDesc Cmd(bufferInfo, prevResult, currentResult,
+			[](const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult)
+				{ return currentResult; },
+			destination, context);
 		GenerateLayer(Cmd);
 	}
 }
\ No newline at end of file
@@ -4,14 +4,45 @@
 
 using namespace std::placeholders;
 
-float CmdBlendMultiply::BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+float CmdBlendMultiply::BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult )
 {
-	return currentResult[y*bufferInfo.ResolutionX+x];
+	return currentResult;
 }
 
-float CmdBlendMultiply::BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+float CmdBlendMultiply::BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult )
 {
-	return currentResult[y*bufferInfo.ResolutionX+x] * prevResult[y*bufferInfo.ResolutionX+x];
+	return currentResult * prevResult;
+}
+
+// Products with a constant 0 tile are constant (except for infinite values).
+bool CmdBlendMultiply::ComputeBounds( const MapBufferInfo& bufferInfo,
+						  const float* prevResult,
+						  const float* currentResult,
+						  const ExecutionContext& context,
+						  TileBounds& bounds ) const
+{
+	const TileBounds* prev = context.InputBounds[0];
+	const TileBounds* current = context.InputBounds[1];
+	if( !current || (prevResult && !prev) )
+		return false;
+	for( int t=0; t<bounds.GetNumTiles(); ++t )
+	{
+		const ValueRange& c = current->Tiles[t];
+		ValueRange& tile = bounds.Tiles[t];
+		if( !prevResult )
+			tile = c;
+		else {
+			const ValueRange& p = prev->Tiles[t];
+			bool isFinite = std::isfinite(c.Min) && std::isfinite(c.Max) && std::isfinite(p.Min) && std::isfinite(p.Max);
+			if( c.IsConstant() && p.IsConstant() )
+				tile.Min = tile.Max = c.Min * p.Min;
+			else if( isFinite && ((c.IsConstant() && c.Min == 0.0f) || (p.IsConstant() && p.Min == 0.0f)) )
+				tile.Min = tile.Max = 0.0f;
+			else
+				tile = TileBounds::Bilinear( c, p, [](float a, float b){ return a * b; } );
+		}
+	}
+	return true;
 }
 
 // ************************************************************************* //
@@ -19,7 +50,8 @@ float CmdBlendMultiply::BlendKernel( const MapBufferInfo& bufferInfo, int x, int
 void CmdBlendMultiply::Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination)
+						  float* destination,
+						  const ExecutionContext& context)
 {
 	// Blending must have at least the one source
 	assert( currentResult );
@@ -33,7 +65,7 @@ void CmdBlendMultiply::Execute( const MapBufferInfo& bufferInfo,
 	else kernel = std::bind(&CmdBlendMultiply::BlendKernelNeutral, this, _1, _2, _3, _4, _5);
 	CommandDesc Cmd(bufferInfo, prevResult, currentResult,
 		kernel,
-		destination);
+		destination, context);
 
 	GenerateLayer(Cmd);
 }
\ No newline at end of file
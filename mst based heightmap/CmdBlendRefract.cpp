@@ -1,54 +1,120 @@
 #include <cassert>
+#include <mutex>
 #include "CommandInfo.h"
 #include "math.hpp"
 
 using namespace std::placeholders;
 
-float CmdBlendRefract::BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+/// Number of columns for which the addressing and offsets are kept on the stack.
+const int REFRACT_CHUNK_SIZE = 256;
+
+float CmdBlendRefract::BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult )
 {
-	return currentResult[y*bufferInfo.ResolutionX+x];
+	return currentResult;
 }
 
-float linearSample( float x, float y, int w, int h, const float* data )
+/// \brief Precomputed addressing of a linear sample along one axis.
+/// \details Both taps are already clamped to the map, so the inner loops do
+///		not need any bounds checks.
+struct SampleTap
+{
+	int i0;		///< Index of the lower tap
+	int i1;		///< Index of the upper tap
+	float f;	///< Interpolation factor between the two taps
+};
+
+static SampleTap MakeTap( float x, int size )
 {
-	int dx = Floor(x);	x -= dx;
-	int dy = Floor(y);	y -= dy;
-	return lrp(lrp(data[min(h-1,max(0, dy)) * w + min(w-1,max(0, dx))], data[min(h-1,max(0, dy)) * w + min(w-1,max(0, dx + 1))], x),
-		   lrp(data[min(h-1,max(0, dy+1)) * w + min(w-1,max(0, dx))], data[min(h-1,max(0, dy+1)) * w + min(w-1,max(0, dx + 1))], x), y);
+	SampleTap tap;
+	int dx = Floor(x);
+	tap.f = x - dx;
+	tap.i0 = min(size-1, max(0, dx));
+	tap.i1 = min(size-1, max(0, dx + 1));
+	return tap;
 }
 
-float CmdBlendRefract::BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+// Linear sample with precomputed taps: the rows are already resolved.
+inline float linearSample( const SampleTap& tx, const float* row0, const float* row1, float fy )
 {
-	//float fCurrentHeight = max(1.0f,abs(currentResult[y*bufferInfo.ResolutionX+x]));
-
-	// Compute gradient with finite difference on currentResult.
-	int off = max( 1, bufferInfo.ResolutionX / 4 );
-	/*int cx = x / 2 + bufferInfo.ResolutionX / 4;
-	int cy = y / 2 + bufferInfo.ResolutionY / 4;
-	Vec3 vGradient = nrm(Vec3(
-		currentResult[cy*bufferInfo.ResolutionX + min(bufferInfo.ResolutionX-1,int(cx+off))] - currentResult[cy*bufferInfo.ResolutionX + max(0,int(cx-off))],
-		2.0f,
-		currentResult[min(bufferInfo.ResolutionY-1,int(cy+off))*bufferInfo.ResolutionX + cx] - currentResult[max(0,int(cy-off))*bufferInfo.ResolutionX + cx]
-		));*/
-	float cx = x * 0.5f + bufferInfo.ResolutionX / 4;
-	float cy = y * 0.5f + bufferInfo.ResolutionY / 4;
-	Vec3 vGradient = nrm(Vec3(
-		linearSample(cx+off, cy, bufferInfo.ResolutionX, bufferInfo.ResolutionY, currentResult ) - linearSample(cx-off, cy, bufferInfo.ResolutionX, bufferInfo.ResolutionY, currentResult ),
-		2.0f,
-		linearSample(cx, cy+off, bufferInfo.ResolutionX, bufferInfo.ResolutionY, currentResult ) - linearSample(cx, cy-off, bufferInfo.ResolutionX, bufferInfo.ResolutionY, currentResult )
-	));
-
-	// Compute distortion source position
-	float fStep = _refractionDistance / vGradient.y;
-	float x_refrac = max(0.0f,min(float(bufferInfo.ResolutionX-2), x + vGradient.x * fStep));
-	float y_refrac = max(0.0f,min(float(bufferInfo.ResolutionY-2), y + vGradient.z * fStep));
-	//int dx = Floor(x_refrac);	x_refrac -= dx;
-	//int dy = Floor(y_refrac);	y_refrac -= dy;
-
-	// Sample prevResult linear at the distorted position
-	return linearSample( x_refrac, y_refrac, bufferInfo.ResolutionX, bufferInfo.ResolutionY, prevResult );
-//	return lrp(lrp(prevResult[dy * bufferInfo.ResolutionX + dx], prevResult[dy * bufferInfo.ResolutionX + dx + 1], x_refrac),
-	//		   lrp(prevResult[(dy+1) * bufferInfo.ResolutionX + dx], prevResult[(dy+1) * bufferInfo.ResolutionX + dx + 1], x_refrac), y_refrac);
+	return lrp(lrp(row0[tx.i0], row0[tx.i1], tx.f),
+			   lrp(row1[tx.i0], row1[tx.i1], tx.f), fy);
+}
+
+ValueRange CmdBlendRefract::BlendLines( const MapBufferInfo& bufferInfo, int y, int numLines, const float* prevResult, const float* currentResult, float* destination )
+{
+	const int w = bufferInfo.ResolutionX;
+	const int h = bufferInfo.ResolutionY;
+
+	// The gradient is computed with finite differences on currentResult
+	// which is magnified by 2 around the map center. All sample coordinates
+	// are separable, so the addressing is precomputed per column and per row.
+	// The columns are processed in chunks, so all tables fit on the stack.
+	int off = max( 1, w / 4 );
+	SampleTap tapsX[REFRACT_CHUNK_SIZE*3];
+
+	// Per line gradient field (interpreted as refraction offset) in structure
+	// of arrays layout.
+	float offsetX[REFRACT_CHUNK_SIZE];
+	float offsetY[REFRACT_CHUNK_SIZE];
+
+	// The surface normal nrm(gx, 2, gz) is scaled such that its y component
+	// becomes _refractionDistance. The normalization cancels out.
+	const float offsetScale = _refractionDistance * 0.5f;
+	const float maxX = float(max(0, w-2));
+	const float maxY = float(max(0, h-2));
+
+	ValueRange range;
+	for( int x0=0; x0<w; x0+=REFRACT_CHUNK_SIZE )
+	{
+		int numColumns = min(REFRACT_CHUNK_SIZE, w-x0);
+		for( int c=0; c<numColumns; ++c )
+		{
+			float cx = (x0+c) * 0.5f + w / 4;
+			tapsX[c*3]   = MakeTap(cx-off, w);
+			tapsX[c*3+1] = MakeTap(cx, w);
+			tapsX[c*3+2] = MakeTap(cx+off, w);
+		}
+
+		for( int i=0; i<numLines; ++i )
+		{
+			int yi = y+i;
+			float cy = yi * 0.5f + h / 4;
+			SampleTap ym = MakeTap(cy-off, h);
+			SampleTap yc = MakeTap(cy, h);
+			SampleTap yp = MakeTap(cy+off, h);
+			const float* ym0 = currentResult + ym.i0 * w;	const float* ym1 = currentResult + ym.i1 * w;
+			const float* yc0 = currentResult + yc.i0 * w;	const float* yc1 = currentResult + yc.i1 * w;
+			const float* yp0 = currentResult + yp.i0 * w;	const float* yp1 = currentResult + yp.i1 * w;
+
+			// Pass 1: gradient field of the current line.
+			for( int c=0; c<numColumns; ++c )
+			{
+				const SampleTap* t = &tapsX[c*3];
+				float gx = linearSample(t[2], yc0, yc1, yc.f) - linearSample(t[0], yc0, yc1, yc.f);
+				float gz = linearSample(t[1], yp0, yp1, yp.f) - linearSample(t[1], ym0, ym1, ym.f);
+				offsetX[c] = gx * offsetScale;
+				offsetY[c] = gz * offsetScale;
+			}
+
+			// Pass 2: sample prevResult linear at the distorted positions.
+			float* dst = destination + yi * w;
+			for( int c=0; c<numColumns; ++c )
+			{
+				int x = x0 + c;
+				float xr = max(0.0f, min(maxX, x + offsetX[c]));
+				float yr = max(0.0f, min(maxY, yi + offsetY[c]));
+				// Coordinates are positive -> truncation is the same as Floor.
+				int dx = int(xr);	xr -= dx;
+				int dy = int(yr);	yr -= dy;
+				const float* row0 = prevResult + dy * w;
+				const float* row1 = prevResult + min(h-1, dy+1) * w;
+				int dx1 = min(w-1, dx+1);
+				dst[x] = lrp(lrp(row0[dx], row0[dx1], xr), lrp(row1[dx], row1[dx1], xr), yr);
+				range.Add(dst[x]);
+			}
+		}
+	}
+	return range;
 }
 
 // ************************************************************************* //
@@ -56,21 +122,31 @@ float CmdBlendRefract::BlendKernel( const MapBufferInfo& bufferInfo, int x, int
 void CmdBlendRefract::Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination)
+						  float* destination,
+						  const ExecutionContext& context)
 {
 	// Blending must have at least the one source
 	assert( currentResult );
 
-	// **** Precomputations **** //
-	// None
-
 	// **** Per pixel **** //
-	Kernel_t kernel;
-	if( prevResult ) kernel = std::bind(&CmdBlendRefract::BlendKernel, this, _1, _2, _3, _4, _5);
-	else kernel = std::bind(&CmdBlendRefract::BlendKernelNeutral, this, _1, _2, _3, _4, _5);
-	CommandDesc Cmd(bufferInfo, prevResult, currentResult,
-		kernel,
-		destination);
-
-	GenerateLayer(Cmd);
+	if( prevResult )
+	{
+		// The kernel needs the gradient of a whole line -> process line blocks.
+		std::mutex rangeLock;
+		GenerateLines( bufferInfo.ResolutionY, [&](int y, int numLines)
+		{
+			ValueRange range = BlendLines( bufferInfo, y, numLines, prevResult, currentResult, destination );
+			if( context.OutputRange )
+			{
+				std::lock_guard<std::mutex> lock(rangeLock);
+				context.OutputRange->Merge(range);
+			}
+		} );
+	} else {
+		CommandDesc Cmd(bufferInfo, prevResult, currentResult,
+			std::bind(&CmdBlendRefract::BlendKernelNeutral, this, _1, _2, _3, _4, _5),
+			destination, context);
+
+		GenerateLayer(Cmd);
+	}
 }
\ No newline at end of file
@@ -1,16 +1,19 @@
+#include <limits>
 #include "CmdDistance.hpp"
+#include "PointSet.hpp"
+#include "WorkCounters.hpp"
 
 // ************************************************************************* //
 // Use a global interpolation to generate a height for a certain point
-float computeHeight(const OrE::ADT::Mesh* graph, float x, float y)
+float computeHeight(const SpanningTree& tree, float x, float y)
 {
 	// Calculate a weighted sum of all heights where the weight is the radial
 	// basis function.
-	auto it = graph->GetNodeIterator();
 	float height = 0;
 	float weightSum = 0;
-	while( ++it ) {
-		const Vec3& vPos = ((PNode*)&it)->GetPos();
+	WORK_COUNT(WORK_RBF_NODES, tree.NumNodes);
+	for( int i=0; i<tree.NumNodes; ++i ) {
+		const Vec3& vPos = tree.Nodes[i];
 		//float distance = 1.0f/(1.0f + 2.0f*(sqr(vPos.y-y) + sqr(vPos.x-x)));	// Inverse quadric RBF
 		float distance = exp(-0.0006f*(sqr(vPos.y-y) + sqr(vPos.x-x)));		// Gaussian
 		height += distance * vPos.z;
@@ -19,6 +22,42 @@ float computeHeight(const OrE::ADT::Mesh* graph, float x, float y)
 	return height * HEIGHT_CODE_FACTOR / weightSum;
 }
 
+// The weighted average is within the node heights.
+bool GetHeightBounds(const SpanningTree& tree, float& minHeight, float& maxHeight)
+{
+	if( tree.NumNodes == 0 ) return false;
+	minHeight = maxHeight = tree.Nodes[0].z;
+	for( int i=1; i<tree.NumNodes; ++i )
+	{
+		minHeight = min(minHeight, tree.Nodes[i].z);
+		maxHeight = max(maxHeight, tree.Nodes[i].z);
+	}
+	minHeight *= HEIGHT_CODE_FACTOR;
+	maxHeight *= HEIGHT_CODE_FACTOR;
+	return true;
+}
+
+// Distance of the rectangle center +- the radius of the rectangle.
+bool GetDistanceBounds(const SpanningTree& tree, const float* rect, float& minDistance, float& maxDistance)
+{
+	if( tree.NumEdges == 0 ) return false;
+	float cx = (rect[0] + rect[2]) * 0.5f;
+	float cy = (rect[1] + rect[3]) * 0.5f;
+	float radius = 0.5f * sqrtf(sqr(rect[2] - rect[0]) + sqr(rect[3] - rect[1]));
+	// The kernels compute the distances in float: a few ulps of the coordinates.
+	float margin = 1e-4f * (fabsf(cx) + fabsf(cy) + radius);
+	float nearest = std::numeric_limits<float>::max();
+	for( int i=0; i<tree.NumEdges; ++i )
+	{
+		float r;
+		nearest = min(nearest, PointLineDistanceSq(tree.Edges[2*i], tree.Edges[2*i+1], cx, cy, r));
+	}
+	nearest = sqrtf(nearest);
+	minDistance = max(0.0f, nearest - radius - margin);
+	maxDistance = nearest + radius + margin;
+	return true;
+}
+
 
 
 // ******************************************************************************** //
@@ -26,7 +65,7 @@ float computeHeight(const OrE::ADT::Mesh* graph, float x, float y)
 typedef OrE::ADT::Mesh::PosNode PNode;
 
 // Create the minimal spanning tree of a set of points.
-OrE::ADT::Mesh* ComputeMST( const Vec3* pointList, int numPoints )
+OrE::ADT::Mesh* ComputeMST( const Vec3* pointList, int numPoints, float heightScale )
 {
 	assert( numPoints > 0 );
 
@@ -36,13 +75,14 @@ OrE::ADT::Mesh* ComputeMST( const Vec3* pointList, int numPoints )
 	for( int i=0; i<numPoints; ++i )
 	{
 		auto node = pGraph->AddNode<PNode>();
-		node->SetPos( Vec3(pointList[i].x, pointList[i].y, pointList[i].z/HEIGHT_CODE_FACTOR) );
+		Vec3 point( pointList[i].x, pointList[i].y, pointList[i].z*heightScale );
+		node->SetPos( Vec3(point.x, point.y, point.z/HEIGHT_CODE_FACTOR) );
 		// Add edges from this too all other nodes
 		int iLastOfLayer = pGraph->GetNumNodes();
 		float minLen = 10000000000.0f;
 		for( int j=0; j<i; ++j )
 		{
-			float edgeLen = len( pointList[i] - pointList[j] );
+			float edgeLen = len( point - Vec3(pointList[j].x, pointList[j].y, pointList[j].z*heightScale) );
 			if( edgeLen < minLen )
 			{
 				minLen = edgeLen;
@@ -57,4 +97,74 @@ OrE::ADT::Mesh* ComputeMST( const Vec3* pointList, int numPoints )
 		
 	delete pGraph;
 	return pMST;
-}
\ No newline at end of file
+}
+
+// ******************************************************************************** //
+/// Layout of a SpanningTree in a snapshot: this header, the nodes and then
+/// two positions per edge.
+struct SpanningTreeHeader
+{
+	uint32_t NumNodes;
+	uint32_t NumEdges;
+	uint32_t Reserved[2];
+};
+
+/// Peak heap memory of BuildSpanningTree per point: the graph of ComputeMST
+/// (arena for numPoints*10 edges and the adjacency maps of the nodes), the
+/// heap of Prim, the MST and the flat arrays. Measured 4.5-5.5 KB.
+const size_t SPANNING_TREE_BYTES_PER_POINT = 6 * 1024;
+
+size_t EstimateSpanningTreeSize( int numPoints )
+{
+	return size_t(numPoints) * SPANNING_TREE_BYTES_PER_POINT;
+}
+
+void BuildSpanningTree( const PointSet& points, float heightScale, SpanningTree& tree )
+{
+	OrE::ADT::Mesh* pMST = ComputeMST( points.GetPoints(), points.GetNumPoints(), heightScale );
+
+	// The kernels iterate over plain arrays instead of the graph.
+	tree.Storage.resize( pMST->GetNumNodes() + 2 * pMST->GetNumEdges() );
+	Vec3* pNodes = tree.Storage.data();
+	Vec3* pEdges = pNodes + pMST->GetNumNodes();
+	auto nodeIt = pMST->GetNodeIterator();
+	int i = 0;
+	while( ++nodeIt )
+		pNodes[i++] = ((PNode*)&nodeIt)->GetPos();
+	auto edgeIt = pMST->GetEdgeIterator();
+	i = 0;
+	while( ++edgeIt )
+	{
+		pEdges[i++] = ((PNode*)edgeIt->GetSrc())->GetPos();
+		pEdges[i++] = ((PNode*)edgeIt->GetDst())->GetPos();
+	}
+
+	tree.Nodes = pNodes;
+	tree.Edges = pEdges;
+	tree.NumNodes = pMST->GetNumNodes();
+	tree.NumEdges = pMST->GetNumEdges();
+	delete pMST;
+}
+
+void SaveSpanningTree( const SpanningTree& tree, std::vector<char>& data )
+{
+	SpanningTreeHeader header = { uint32_t(tree.NumNodes), uint32_t(tree.NumEdges), {0, 0} };
+	const char* pHeader = (const char*)&header;
+	data.insert( data.end(), pHeader, pHeader + sizeof(header) );
+	data.insert( data.end(), (const char*)tree.Nodes, (const char*)(tree.Nodes + tree.NumNodes) );
+	data.insert( data.end(), (const char*)tree.Edges, (const char*)(tree.Edges + 2 * tree.NumEdges) );
+}
+
+bool LoadSpanningTree( const void* data, size_t size, SpanningTree& tree )
+{
+	if( size < sizeof(SpanningTreeHeader) ) return false;
+	const SpanningTreeHeader* header = (const SpanningTreeHeader*)data;
+	if( size - sizeof(SpanningTreeHeader) < (size_t(header->NumNodes) + 2 * size_t(header->NumEdges)) * sizeof(Vec3) )
+		return false;
+	tree.Storage.clear();
+	tree.Nodes = (const Vec3*)(header + 1);
+	tree.Edges = tree.Nodes + header->NumNodes;
+	tree.NumNodes = int(header->NumNodes);
+	tree.NumEdges = int(header->NumEdges);
+	return true;
+}
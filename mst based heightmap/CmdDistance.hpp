@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 #include "src-mst/OrADTObjects.h"
+#include "src-mst/OrArena.h"
 #include "src-mst/OrHeap.h"
 #include "src-mst/OrHash.h"
 #include "src-mst/OrGraph.h"
@@ -13,15 +15,59 @@ typedef OrE::ADT::Mesh::PosNode PNode;
 ///		edited.
 const float HEIGHT_CODE_FACTOR = 256.0f;
 
+class PointSet;
+
+/// \brief Flat copy of a minimal spanning tree which is used by the kernels.
+/// \details The arrays are either owned (Storage) or point into a mapped
+///		snapshot file. The order of nodes and edges is the same as in the
+///		graph of ComputeMST.
+struct SpanningTree
+{
+	const Vec3* Nodes;			///< Node positions. z is the height / HEIGHT_CODE_FACTOR.
+	const Vec3* Edges;			///< Start and end position of each edge.
+	int NumNodes;
+	int NumEdges;
+	std::vector<Vec3> Storage;
+
+	SpanningTree() : Nodes(nullptr), Edges(nullptr), NumNodes(0), NumEdges(0) {}
+};
+
+/// \brief Compute the MST of a point set and store it flat.
+/// \param [in] heightScale Factor for the z-coordinate of all points.
+void BuildSpanningTree( const PointSet& points, float heightScale, SpanningTree& tree );
+
+/// \brief Upper estimate of the peak heap memory of BuildSpanningTree.
+/// \details Most of it is the temporary graph of ComputeMST.
+size_t EstimateSpanningTreeSize( int numPoints );
+
+/// \brief Append a tree in a binary form to a snapshot.
+void SaveSpanningTree( const SpanningTree& tree, std::vector<char>& data );
+
+/// \brief Use the tree from SaveSpanningTree without a copy.
+/// \return false if the data is too small.
+bool LoadSpanningTree( const void* data, size_t size, SpanningTree& tree );
+
 /// \brief Use a global interpolation to generate a height for a certain point.
-/// \param [in] graph A graph structure with points. The interpolation is done
+/// \param [in] tree A tree with points. The interpolation is done
 ///		between the points
 /// \param [in] x World space x coordinate.
 /// \param [in] y World space y coordinate.
 /// \return An interpolated height froms the nodes in the graph.
-float computeHeight(const OrE::ADT::Mesh* graph, float x, float y);
+float computeHeight(const SpanningTree& tree, float x, float y);
+
+/// \brief Bounds of computeHeight over the whole plane.
+/// \return false if the tree has no nodes.
+bool GetHeightBounds(const SpanningTree& tree, float& minHeight, float& maxHeight);
+
+/// \brief Bounds of the distance from any point of a rectangle to the
+///		nearest edge of a tree.
+/// \details Includes a margin for the rounding errors of the kernels.
+/// \param [in] rect World space rectangle [minX, minY, maxX, maxY].
+/// \return false if the tree has no edges.
+bool GetDistanceBounds(const SpanningTree& tree, const float* rect, float& minDistance, float& maxDistance);
 
 
 /// \brief Create the minimal spanning tree of a set of points.
-///
-OrE::ADT::Mesh* ComputeMST( const Vec3* pointList, int numPoints );
\ No newline at end of file
+/// \param [in] heightScale Factor for the z-coordinate of all points. The
+///		list itself is not changed (it might be a mapped file).
+OrE::ADT::Mesh* ComputeMST( const Vec3* pointList, int numPoints, float heightScale );
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include <cassert>
+#include "BufferArena.hpp"
+#include "CommandInfo.h"
+#include "math.hpp"
+
+/// Pipe model constant: time step * gravity * pipe cross section / pipe length.
+const float EROSION_FLUX_FACTOR = 0.2f;
+/// Below this amount of water the sediment concentration is zero.
+const float EROSION_MIN_WATER = 0.0001f;
+/// Minimal slope for the sediment capacity. Otherwise there is no erosion
+/// in flat areas at all.
+const float EROSION_MIN_SLOPE = 0.05f;
+/// Number of temporary map sized planes (all except the terrain).
+const int EROSION_NUM_PLANES = 9;
+
+/// \brief All planes of the cellular simulation in structure of arrays layout.
+/// \details Terrain, water and sediment are read from the neighborhood of
+///		a cell and need two buffers (ping-pong). Water and sediment toggle
+///		each iteration. The terrain is written to Terrain[1] by the water
+///		step and back to Terrain[0] by the thermal step. The flux is only
+///		read from neighbors in a later step and can be updated in place.
+struct ErosionState
+{
+	int Width;
+	int Height;
+	float* Terrain[2];
+	float* Water[2];
+	float* Sediment[2];
+	float* Flux[4];			///< Outflow to left, right, top and bottom neighbor.
+};
+
+enum { FLUX_L, FLUX_R, FLUX_T, FLUX_B };
+
+// ************************************************************************* //
+// Step 1: Update the outflow of each cell based on the water surface height
+// difference to its neighbors. The outflow is scaled such that no cell
+// looses more water than it has.
+// At the border the neighbor index is clamped, so the height difference and
+// therefore the flux to the outside stays zero.
+inline void FluxCell( const ErosionState& s, int src, int x, int xl, int xr, int rowT, int rowB, int row )
+{
+	const float* b = s.Terrain[0];
+	const float* w = s.Water[src];
+	int i = row + x;
+	float h = b[i] + w[i];
+	float fl = max(0.0f, s.Flux[FLUX_L][i] + EROSION_FLUX_FACTOR * (h - b[row+xl] - w[row+xl]));
+	float fr = max(0.0f, s.Flux[FLUX_R][i] + EROSION_FLUX_FACTOR * (h - b[row+xr] - w[row+xr]));
+	float ft = max(0.0f, s.Flux[FLUX_T][i] + EROSION_FLUX_FACTOR * (h - b[rowT+x] - w[rowT+x]));
+	float fb = max(0.0f, s.Flux[FLUX_B][i] + EROSION_FLUX_FACTOR * (h - b[rowB+x] - w[rowB+x]));
+	float scale = min(1.0f, w[i] / max(EROSION_MIN_WATER, fl + fr + ft + fb));
+	s.Flux[FLUX_L][i] = fl * scale;
+	s.Flux[FLUX_R][i] = fr * scale;
+	s.Flux[FLUX_T][i] = ft * scale;
+	s.Flux[FLUX_B][i] = fb * scale;
+}
+
+static void FluxLines( const ErosionState& s, int src, int y, int numLines )
+{
+	const int w = s.Width;
+	for( int yi=y; yi<y+numLines; ++yi )
+	{
+		int row = yi * w;
+		int rowT = max(0, yi-1) * w;
+		int rowB = min(s.Height-1, yi+1) * w;
+		FluxCell( s, src, 0, 0, min(1, w-1), rowT, rowB, row );
+		// Interior without clamping -> vectorizable
+		for( int x=1; x<w-1; ++x )
+			FluxCell( s, src, x, x-1, x+1, rowT, rowB, row );
+		if( w > 1 )
+			FluxCell( s, src, w-1, w-2, w-1, rowT, rowB, row );
+	}
+}
+
+// ************************************************************************* //
+// Step 2: Move water and suspended sediment along the flux. Then dissolve
+// or deposit sediment depending on the transport capacity.
+inline void WaterCell( const ErosionState& s, const CmdErosion::Parameters& p, float slopeScale,
+					   int src, int x, int xl, int xr, int rowT, int rowB, int row )
+{
+	const float* b = s.Terrain[0];
+	const float* w = s.Water[src];
+	const float* sed = s.Sediment[src];
+	int i = row + x;
+	int il = row + xl, ir = row + xr, it = rowT + x, ib = rowB + x;
+
+	// Water exchange. On the borders the clamped neighbor is the cell itself,
+	// which has no flux towards itself (height difference 0).
+	float inL = xl != x ? s.Flux[FLUX_R][il] : 0.0f;
+	float inR = xr != x ? s.Flux[FLUX_L][ir] : 0.0f;
+	float inT = it != i ? s.Flux[FLUX_B][it] : 0.0f;
+	float inB = ib != i ? s.Flux[FLUX_T][ib] : 0.0f;
+	float outL = s.Flux[FLUX_L][i], outR = s.Flux[FLUX_R][i];
+	float outT = s.Flux[FLUX_T][i], outB = s.Flux[FLUX_B][i];
+	float outSum = outL + outR + outT + outB;
+	float water = max(0.0f, w[i] + inL + inR + inT + inB - outSum);
+
+	// Sediment is transported with the water (concentration * flux).
+	float cSelf = w[i] > EROSION_MIN_WATER ? sed[i] / w[i] : 0.0f;
+	float cL = w[il] > EROSION_MIN_WATER ? sed[il] / w[il] : 0.0f;
+	float cR = w[ir] > EROSION_MIN_WATER ? sed[ir] / w[ir] : 0.0f;
+	float cT = w[it] > EROSION_MIN_WATER ? sed[it] / w[it] : 0.0f;
+	float cB = w[ib] > EROSION_MIN_WATER ? sed[ib] / w[ib] : 0.0f;
+	float sediment = max(0.0f, sed[i] - cSelf * outSum + cL * inL + cR * inR + cT * inT + cB * inB);
+
+	// Capacity depends on the water velocity and the terrain slope.
+	float meanWater = max(EROSION_MIN_WATER, 0.5f * (w[i] + water));
+	float vx = 0.5f * (inL - outL + outR - inR) / meanWater;
+	float vy = 0.5f * (inT - outT + outB - inB) / meanWater;
+	float gx = (b[ir] - b[il]) * slopeScale;
+	float gy = (b[ib] - b[it]) * slopeScale;
+	float slope = max(EROSION_MIN_SLOPE, sqrtf((gx*gx + gy*gy) / (1.0f + gx*gx + gy*gy)));
+	float capacity = p.Capacity * slope * sqrt(vx*vx + vy*vy);
+
+	float terrain = b[i];
+	float delta = capacity > sediment ? p.Dissolving * (capacity - sediment) : -p.Deposition * (sediment - capacity);
+	terrain -= delta;
+	sediment += delta;
+
+	int dst = 1 - src;
+	s.Terrain[1][i] = terrain;
+	s.Sediment[dst][i] = sediment;
+	s.Water[dst][i] = water * (1.0f - p.Evaporation) + p.Rain;
+}
+
+static void WaterLines( const ErosionState& s, const CmdErosion::Parameters& p, float slopeScale, int src, int y, int numLines )
+{
+	const int w = s.Width;
+	for( int yi=y; yi<y+numLines; ++yi )
+	{
+		int row = yi * w;
+		int rowT = max(0, yi-1) * w;
+		int rowB = min(s.Height-1, yi+1) * w;
+		WaterCell( s, p, slopeScale, src, 0, 0, min(1, w-1), rowT, rowB, row );
+		for( int x=1; x<w-1; ++x )
+			WaterCell( s, p, slopeScale, src, x, x-1, x+1, rowT, rowB, row );
+		if( w > 1 )
+			WaterCell( s, p, slopeScale, src, w-1, w-2, w-1, rowT, rowB, row );
+	}
+}
+
+// ************************************************************************* //
+// Step 3: Thermal erosion. Material slides down to each neighbor which is
+// more than the talus height lower. The exchange is antisymmetric per pair
+// of cells, so the total mass is preserved.
+inline float ThermalExchange( float b, float bn, float talus, float rate )
+{
+	return rate * (max(0.0f, bn - b - talus) - max(0.0f, b - bn - talus));
+}
+
+static void ThermalLines( const ErosionState& s, float talus, float rate, int y, int numLines )
+{
+	const int w = s.Width;
+	const float* b = s.Terrain[1];
+	float* dst = s.Terrain[0];
+	for( int yi=y; yi<y+numLines; ++yi )
+	{
+		const float* line = b + yi * w;
+		const float* lineT = b + max(0, yi-1) * w;
+		const float* lineB = b + min(s.Height-1, yi+1) * w;
+		float* out = dst + yi * w;
+		for( int x=0; x<w; ++x )
+		{
+			float c = line[x];
+			out[x] = c + ThermalExchange(c, line[max(0, x-1)], talus, rate)
+					   + ThermalExchange(c, line[min(w-1, x+1)], talus, rate)
+					   + ThermalExchange(c, lineT[x], talus, rate)
+					   + ThermalExchange(c, lineB[x], talus, rate);
+		}
+	}
+}
+
+// ************************************************************************* //
+// Simulate erosion on the last result.
+void CmdErosion::Execute( const MapBufferInfo& bufferInfo,
+						  const float* prevResult,
+						  const float* currentResult,
+						  float* destination,
+						  const ExecutionContext& context)
+{
+	// Erosion must have a source
+	assert( currentResult );
+
+	// **** Precomputations **** //
+	ErosionState state;
+	state.Width = bufferInfo.ResolutionX;
+	state.Height = bufferInfo.ResolutionY;
+	size_t numPixels = size_t(state.Width) * state.Height;
+
+	// One allocation for all planes except the terrain which is written to
+	// destination after each full iteration.
+	ArenaScope scope(*context.Arena);
+	float* planes = context.Arena->Allocate<float>(numPixels * EROSION_NUM_PLANES);
+	state.Terrain[0] = destination;
+	state.Terrain[1] = planes;
+	state.Water[0] = planes + numPixels;		state.Water[1] = planes + numPixels * 2;
+	state.Sediment[0] = planes + numPixels * 3;	state.Sediment[1] = planes + numPixels * 4;
+	for( int i=0; i<4; ++i )
+		state.Flux[i] = planes + numPixels * (5 + i);
+
+	memcpy( destination, currentResult, numPixels * sizeof(float) );
+	std::fill( state.Water[0], state.Water[0] + numPixels, _params.Rain );
+	memset( state.Sediment[0], 0, numPixels * sizeof(float) );
+	memset( state.Flux[0], 0, numPixels * 4 * sizeof(float) );
+
+	// Terrain heights are in world units, the cells have the pixel size.
+	float slopeScale = 0.5f * bufferInfo.HeightmapPixelPerWorldUnit;
+	float talus = _params.Talus * bufferInfo.PixelSize;
+	// More than 1/4 per neighbor can oscillate.
+	float thermalRate = saturate(_params.ThermalRate) * 0.25f;
+
+	// **** Per pixel **** //
+	// Each step is a cellular update which reads the neighbors of the last
+	// step. The parallel blocks of lines exchange their border lines through
+	// the shared buffers; the join after each step is the barrier.
+	int water = 0;
+	for( int it=0; it<_params.Iterations; ++it )
+	{
+		GenerateLines( state.Height, [&](int y, int numLines){ FluxLines( state, water, y, numLines ); } );
+		GenerateLines( state.Height, [&](int y, int numLines){ WaterLines( state, _params, slopeScale, water, y, numLines ); } );
+		GenerateLines( state.Height, [&](int y, int numLines){ ThermalLines( state, talus, thermalRate, y, numLines ); } );
+		water = 1 - water;
+	}
+}
+size_t CmdErosion::GetScratchSize( const MapBufferInfo& bufferInfo ) const
+{
+	return BufferArena::AlignedSize( size_t(bufferInfo.ResolutionX) * bufferInfo.ResolutionY * EROSION_NUM_PLANES * sizeof(float) );
+}
@@ -2,18 +2,22 @@
 #include "CommandInfo.h"
 #include "math.hpp"
 #include "CmdDistance.hpp"
+#include "PointSet.hpp"
+#include "WorkCounters.hpp"
 
 using namespace std::placeholders;
 
 
 
 // ************************************************************************* //
-CmdInvMSTDistance::CmdInvMSTDistance(const Vec3* pointList, int numPoints, float height, float quadraticSplineHeight) :
+CmdInvMSTDistance::CmdInvMSTDistance(std::shared_ptr<const PointSet> points, float height, float quadraticSplineHeight, float tolerance) :
 	Command(CommandType::MST_INV_DISTANCE),
+	_points(points),
+	_mst(new SpanningTree),
 	_height(height),
-	_quadraticSplineHeight(quadraticSplineHeight)
+	_quadraticSplineHeight(quadraticSplineHeight),
+	_tolerance(tolerance)
 {
-	_mst = ComputeMST( pointList, numPoints );
 }
 
 CmdInvMSTDistance::~CmdInvMSTDistance()
@@ -21,20 +25,47 @@ CmdInvMSTDistance::~CmdInvMSTDistance()
 	delete _mst;
 }
 
+void CmdInvMSTDistance::Precompute()
+{
+	// The heights of the points are scaled to the layer height.
+	BuildSpanningTree( *_points, _height, *_mst );
+}
+
+bool CmdInvMSTDistance::SavePrecomputed( std::vector<char>& data ) const
+{
+	SaveSpanningTree( *_mst, data );
+	return true;
+}
+
+bool CmdInvMSTDistance::LoadPrecomputed( const void* data, size_t size )
+{
+	return LoadSpanningTree( data, size, *_mst );
+}
+
+size_t CmdInvMSTDistance::GetPrecomputedSize() const
+{
+	return _mst->Storage.capacity() * sizeof(Vec3);
+}
+
+size_t CmdInvMSTDistance::GetPrecomputeEstimate() const
+{
+	return EstimateSpanningTreeSize( _points->GetNumPoints() );
+}
 
-float CmdInvMSTDistance::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+float CmdInvMSTDistance::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult )
 {
 	const float maxHeight = _height + _quadraticSplineHeight;
 	const float py = y*bufferInfo.PixelSize;
 
 	float height = -_quadraticSplineHeight;
 	// Compute minimum distance to the mst for each pixel
-	auto it = _mst->GetEdgeIterator();
-	while( ++it )
+	const Vec3* edges = _mst->Edges;
+	WORK_COUNT(WORK_MST_SEGMENTS, _mst->NumEdges);
+	for( int i=0; i<_mst->NumEdges; ++i )
 	{
 		float r;
-		const Vec3& vP0 = ((PNode*)it->GetSrc())->GetPos();
-		const Vec3& vP1 = ((PNode*)it->GetDst())->GetPos();
+		const Vec3& vP0 = edges[2*i];
+		const Vec3& vP1 = edges[2*i+1];
 		float distance = PointLineDistanceSq( vP0,
 								vP1,
 								x*bufferInfo.PixelSize, py, r );
@@ -50,7 +81,57 @@ float CmdInvMSTDistance::GeneratorKernel( const MapBufferInfo& bufferInfo, int x
 		height = max( unparametrizedHeight, height );
 	}
 
-	return height * computeHeight(_mst, x*bufferInfo.PixelSize, py) / _height;
+	return height * computeHeight(*_mst, x*bufferInfo.PixelSize, py) / _height;
+}
+
+// Contribution of one edge at a distance, like in the kernel.
+static float EdgeHeight( float height, float quadraticSplineHeight, float distance )
+{
+	float edgeHeight = height + quadraticSplineHeight - distance;
+	if( edgeHeight >= quadraticSplineHeight )
+		return edgeHeight;
+	// Without a spline the kernel ignores the edge (0/0).
+	if( quadraticSplineHeight <= 0.0f )
+		return 0.0f;
+	edgeHeight = max( 0.0f, edgeHeight + quadraticSplineHeight );
+	return sqr(edgeHeight)/(4.0f*quadraticSplineHeight);
+}
+
+// Beyond _height + 2*_quadraticSplineHeight from all edges every edge
+// contributes 0 and so does the RBF height.
+bool CmdInvMSTDistance::ComputeBounds( const MapBufferInfo& bufferInfo,
+						  const float* prevResult,
+						  const float* currentResult,
+						  const ExecutionContext& context,
+						  TileBounds& bounds ) const
+{
+	ValueRange rbf;
+	if( _height <= 0.0f || _quadraticSplineHeight < 0.0f || !GetHeightBounds( *_mst, rbf.Min, rbf.Max ) )
+		return false;
+	const float saturation = _height + 2.0f * _quadraticSplineHeight;
+	for( int ty=0; ty<bounds.NumTilesY; ++ty )
+		for( int tx=0; tx<bounds.NumTilesX; ++tx )
+		{
+			float rect[4];
+			TileBounds::GetWorldRect( bufferInfo, tx, ty, rect );
+			ValueRange distance;
+			if( !GetDistanceBounds( *_mst, rect, distance.Min, distance.Max ) )
+				return false;
+			ValueRange& tile = bounds.Tiles[ty * bounds.NumTilesX + tx];
+			if( distance.Min >= saturation )
+				tile.Min = tile.Max = 0.0f;
+			// The adaptive sampling may leave the bounds between the samples.
+			else if( _tolerance > 0.0f )
+				tile = TileBounds::Unbounded();
+			else {
+				// The height decreases with the distance.
+				ValueRange height;
+				height.Min = EdgeHeight( _height, _quadraticSplineHeight, distance.Max );
+				height.Max = EdgeHeight( _height, _quadraticSplineHeight, distance.Min );
+				tile = TileBounds::Bilinear( height, rbf, [this](float h, float c){ return h * c / _height; } );
+			}
+		}
+	return true;
 }
 
 // ************************************************************************* //
@@ -58,12 +139,16 @@ float CmdInvMSTDistance::GeneratorKernel( const MapBufferInfo& bufferInfo, int x
 void CmdInvMSTDistance::Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination)
+						  float* destination,
+						  const ExecutionContext& context)
 {
 	// **** Per pixel **** //
 	CommandDesc Cmd(bufferInfo, prevResult, currentResult,
 		std::bind(&CmdInvMSTDistance::GeneratorKernel, this, _1, _2, _3, _4, _5),
-		destination);
+		destination, context);
 
-	GenerateLayer(Cmd);
+	if( _tolerance > 0.0f )
+		GenerateLayerAdaptive(Cmd, _tolerance);
+	else
+		GenerateLayer(Cmd);
 }
\ No newline at end of file
@@ -2,16 +2,20 @@
 #include "CommandInfo.h"
 #include "math.hpp"
 #include "CmdDistance.hpp"
+#include "PointSet.hpp"
+#include "WorkCounters.hpp"
 
 using namespace std::placeholders;
 
 // ************************************************************************* //
-CmdMSTDistance::CmdMSTDistance(const Vec3* pointList, int numPoints, float height, float quadraticSplineHeight) :
+CmdMSTDistance::CmdMSTDistance(std::shared_ptr<const PointSet> points, float height, float quadraticSplineHeight, float tolerance) :
 	Command(CommandType::MST_DISTANCE),
+	_points(points),
+	_mst(new SpanningTree),
 	_height(height),
-	_quadraticSplineHeight(quadraticSplineHeight)
+	_quadraticSplineHeight(quadraticSplineHeight),
+	_tolerance(tolerance)
 {
-	_mst = ComputeMST( pointList, numPoints );
 }
 
 CmdMSTDistance::~CmdMSTDistance()
@@ -19,7 +23,34 @@ CmdMSTDistance::~CmdMSTDistance()
 	delete _mst;
 }
 
-float CmdMSTDistance::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+void CmdMSTDistance::Precompute()
+{
+	// The heights of the points are scaled to the layer height.
+	BuildSpanningTree( *_points, _height, *_mst );
+}
+
+bool CmdMSTDistance::SavePrecomputed( std::vector<char>& data ) const
+{
+	SaveSpanningTree( *_mst, data );
+	return true;
+}
+
+bool CmdMSTDistance::LoadPrecomputed( const void* data, size_t size )
+{
+	return LoadSpanningTree( data, size, *_mst );
+}
+
+size_t CmdMSTDistance::GetPrecomputedSize() const
+{
+	return _mst->Storage.capacity() * sizeof(Vec3);
+}
+
+size_t CmdMSTDistance::GetPrecomputeEstimate() const
+{
+	return EstimateSpanningTreeSize( _points->GetNumPoints() );
+}
+
+float CmdMSTDistance::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult )
 {
 	float result;
 	const float maxHeight = sqr(_height + _quadraticSplineHeight);
@@ -28,12 +59,13 @@ float CmdMSTDistance::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, i
 	float fx = x*bufferInfo.PixelSize;
 	float fy = y*bufferInfo.PixelSize;
 	// Compute minimum distance to the mst for each pixel
-	auto it = _mst->GetEdgeIterator();
-	while( ++it )
+	const Vec3* edges = _mst->Edges;
+	WORK_COUNT(WORK_MST_SEGMENTS, _mst->NumEdges);
+	for( int i=0; i<_mst->NumEdges; ++i )
 	{
 		float r;
-		float distance = PointLineDistanceSq( ((PNode*)it->GetSrc())->GetPos(),
-								((PNode*)it->GetDst())->GetPos(),
+		float distance = PointLineDistanceSq( edges[2*i],
+								edges[2*i+1],
 								fx, fy, r );
 
 		height = min(height, _height-(_height-sqrtf(distance)));
@@ -51,22 +83,74 @@ float CmdMSTDistance::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, i
 	// The points on the mst are 0 so multiplication is not possible.
 	// Therefore multiply the inverses.
 	result = _height - (_height - result)
-		* (1-computeHeight(_mst, fx, fy)/_height);
+		* (1-computeHeight(*_mst, fx, fy)/_height);
 
 	return result;
 }
 
+// Distance term of the kernel (before the RBF height) for the distance to
+// the nearest edge.
+static float DistanceHeight( float height, float quadraticSplineHeight, float distance )
+{
+	float result = min( sqr(height + quadraticSplineHeight), distance );
+	if( result >= quadraticSplineHeight )
+		return result;
+	result = max( 0.0f, result + quadraticSplineHeight );
+	return result*result/(4.0f*quadraticSplineHeight);
+}
+
+// The distance term saturates far from all edges. The RBF height still
+// varies, so tiles are only constant if all points have the height 0.
+bool CmdMSTDistance::ComputeBounds( const MapBufferInfo& bufferInfo,
+						  const float* prevResult,
+						  const float* currentResult,
+						  const ExecutionContext& context,
+						  TileBounds& bounds ) const
+{
+	ValueRange rbf;
+	if( _height <= 0.0f || _quadraticSplineHeight < 0.0f || !GetHeightBounds( *_mst, rbf.Min, rbf.Max ) )
+		return false;
+	const float saturation = sqr(_height + _quadraticSplineHeight);
+	for( int ty=0; ty<bounds.NumTilesY; ++ty )
+		for( int tx=0; tx<bounds.NumTilesX; ++tx )
+		{
+			float rect[4];
+			TileBounds::GetWorldRect( bufferInfo, tx, ty, rect );
+			ValueRange distance;
+			if( !GetDistanceBounds( *_mst, rect, distance.Min, distance.Max ) )
+				return false;
+			ValueRange& tile = bounds.Tiles[ty * bounds.NumTilesX + tx];
+			if( distance.Min >= saturation && rbf.Min == 0.0f && rbf.Max == 0.0f )
+				tile.Min = tile.Max = _height - (_height - saturation) * (1 - 0.0f/_height);
+			// The adaptive sampling may leave the bounds between the samples.
+			else if( _tolerance > 0.0f )
+				tile = TileBounds::Unbounded();
+			else {
+				// The distance term increases with the distance.
+				ValueRange height;
+				height.Min = DistanceHeight( _height, _quadraticSplineHeight, distance.Min );
+				height.Max = DistanceHeight( _height, _quadraticSplineHeight, distance.Max );
+				tile = TileBounds::Bilinear( height, rbf, [this](float h, float c){ return _height - (_height - h) * (1 - c/_height); } );
+			}
+		}
+	return true;
+}
+
 // ************************************************************************* //
 // This commando creates a value noise which may depend on the previous step.
 void CmdMSTDistance::Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination)
+						  float* destination,
+						  const ExecutionContext& context)
 {
 	// **** Per pixel **** //
 	CommandDesc Cmd(bufferInfo, prevResult, currentResult,
 		std::bind(&CmdMSTDistance::GeneratorKernel, this, _1, _2, _3, _4, _5),
-		destination);
+		destination, context);
 
-	GenerateLayer(Cmd);
+	if( _tolerance > 0.0f )
+		GenerateLayerAdaptive(Cmd, _tolerance);
+	else
+		GenerateLayer(Cmd);
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include <cassert>
+#include "BufferArena.hpp"
+#include "CommandInfo.h"
+#include "Filter.h"
+#include "math.hpp"
+
+// ************************************************************************* //
+// Smooth the last result with iterated box filters.
+void CmdSmooth::Execute( const MapBufferInfo& bufferInfo,
+						 const float* prevResult,
+						 const float* currentResult,
+						 float* destination,
+						 const ExecutionContext& context)
+{
+	// Filtering must have a source
+	assert( currentResult );
+
+	int width = bufferInfo.ResolutionX;
+	int height = bufferInfo.ResolutionY;
+	int radius = int(_radius * bufferInfo.HeightmapPixelPerWorldUnit + 0.5f);
+	if( radius < 1 )
+	{
+		memcpy( destination, currentResult, width * height * sizeof(float) );
+		return;
+	}
+
+	// **** Precomputations **** //
+	ArenaScope scope(*context.Arena);
+	float* scratch = context.Arena->Allocate<float>(width * height);
+
+	// **** Per pixel **** //
+	// All passes toggle between the scratch buffer and the destination. There
+	// is an even number of passes (2 transpositions + 2*_iterations filters)
+	// starting with the scratch buffer -> the last one writes destination.
+	float* buffers[2] = { scratch, destination };
+	int target = 0;
+	const float* source = currentResult;
+	for( int i=0; i<_iterations; ++i )
+	{
+		BoxFilterColumns( source, buffers[target], width, height, radius );
+		source = buffers[target];	target = 1 - target;
+	}
+	Transpose( source, buffers[target], width, height );
+	source = buffers[target];	target = 1 - target;
+	// Filter the former lines
+	for( int i=0; i<_iterations; ++i )
+	{
+		BoxFilterColumns( source, buffers[target], height, width, radius );
+		source = buffers[target];	target = 1 - target;
+	}
+	Transpose( source, buffers[target], height, width );
+	assert( buffers[target] == destination );
+}
+
+size_t CmdSmooth::GetScratchSize( const MapBufferInfo& bufferInfo ) const
+{
+	return BufferArena::AlignedSize( size_t(bufferInfo.ResolutionX) * bufferInfo.ResolutionY * sizeof(float) );
+}
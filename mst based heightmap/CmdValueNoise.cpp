@@ -5,14 +5,15 @@
 const float HORIZONTAL_NOISE_SCALE = 0.01f;
 using namespace std::placeholders;
 
-float CmdValueNoise::CalculateFrequenceAmplitude( const MapBufferInfo& bufferDesc, float _fCurrentHeight, float _fFrequence, float _fGradientX, float _fGradientY )
+float CmdValueNoise::CalculateFrequenceAmplitude( const MapBufferInfo& bufferDesc, float _fCurrentHeight, float _fFrequence, float _fGradientX, float _fGradientY, float _fHeightScale )
 {
-	float fHeightDependency = exp( (_fCurrentHeight-_heightDependencyOffset) * _heightDependency);
-	float fGradientDependency = 1.0f + sqrt(_fGradientX*_fGradientX + _fGradientY*_fGradientY) * _gradientDependency;
+	// The dependencies are normalized by the height (see constructor)
+	float fHeightDependency = exp( (_fCurrentHeight-_heightDependencyOffset*_fHeightScale) * (_heightDependency/_fHeightScale));
+	float fGradientDependency = 1.0f + sqrt(_fGradientX*_fGradientX + _fGradientY*_fGradientY) * (_gradientDependency/_fHeightScale);
 	return min( 6.0f, fHeightDependency*fGradientDependency ) / _fFrequence;
 }
 
-float CmdValueNoise::NoiseKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+float CmdValueNoise::NoiseKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult, int maxOctave, unsigned int seed, float heightScale )
 {
 	float fGX = 0.0f;
 	float fGY = 0.0f;
@@ -20,17 +21,17 @@ float CmdValueNoise::NoiseKernel( const MapBufferInfo& bufferInfo, int x, int y,
 	float fx = HORIZONTAL_NOISE_SCALE * x;
 	float fy = HORIZONTAL_NOISE_SCALE * y;
 
-	float fHeightOffset = currentResult ? currentResult[y*bufferInfo.ResolutionX+x] : 0.0f;
+	float fHeightOffset = currentResult;
 
 	// *************** Noise function ***************
-	for( int i=0; i<_maxOctave; ++i )
+	for( int i=0; i<maxOctave; ++i )
 	{
 		float fdX;
 		float fdY;
 		float fFrequence = float(1<<i);
-		float fAmplitude = CalculateFrequenceAmplitude( bufferInfo, fSum+fHeightOffset, fFrequence, fGX, fGY ) * _heightScale;
+		float fAmplitude = CalculateFrequenceAmplitude( bufferInfo, fSum+fHeightOffset, fFrequence, fGX, fGY, heightScale ) * (_heightScale*heightScale);
 		//fSum += abs(Rand2D( fx, fy, fFrequence, fdX, fdY ) - 0.5f) * fAmplitude;
-		fSum += (Rand2D( fx, fy, fFrequence, fdX, fdY ) * 2.0f - 1.0f) * fAmplitude;
+		fSum += (Rand2D( fx, fy, fFrequence, seed, fdX, fdY ) * 2.0f - 1.0f) * fAmplitude;
 		// Update global gradient
 		fGX += fdX*fFrequence*fAmplitude;		fGY += fdY*fFrequence*fAmplitude;
 	}
@@ -43,15 +44,16 @@ float CmdValueNoise::NoiseKernel( const MapBufferInfo& bufferInfo, int x, int y,
 void CmdValueNoise::Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination)
+						  float* destination,
+						  const ExecutionContext& context)
 {
 	// **** Precomputations **** //
-	_maxOctave = int(log( std::max(bufferInfo.ResolutionX, bufferInfo.ResolutionY) )/log(2));
+	int maxOctave = int(log( std::max(bufferInfo.ResolutionX, bufferInfo.ResolutionY) )/log(2));
 
 	// **** Per pixel **** //
 	CommandDesc Cmd(bufferInfo, prevResult, currentResult,
-		std::bind(&CmdValueNoise::NoiseKernel, this, _1, _2, _3, _4, _5),
-		destination);
+		std::bind(&CmdValueNoise::NoiseKernel, this, _1, _2, _3, _4, _5, maxOctave, context.Seed, context.HeightScale),
+		destination, context);
 
 	GenerateLayer(Cmd);
 }
\ No newline at end of file
@@ -2,25 +2,24 @@
 #include <memory>
 #include "CommandInfo.h"
 #include "math.hpp"
+#include "PointSet.hpp"
+#include "WorkCounters.hpp"
 
 using namespace std::placeholders;
 
 // ************************************************************************* //
-CmdVoronoi::CmdVoronoi(const Vec3* pointList, int numPoints, float height) :
+CmdVoronoi::CmdVoronoi(std::shared_ptr<const PointSet> points, float height) :
 	Command(CommandType::MST_DISTANCE),
-	_numPoints(numPoints),
+	_points(std::move(points)),
 	_height(height)
 {
-	_points = new Vec3[numPoints];
-	memcpy( _points, pointList, numPoints * sizeof(Vec3) );
 }
 
 CmdVoronoi::~CmdVoronoi()
 {
-	delete[] _points;
 }
 
-float CmdVoronoi::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+float CmdVoronoi::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult )
 {
 	float fx = x*bufferInfo.PixelSize;
 	float fy = y*bufferInfo.PixelSize;
@@ -29,9 +28,12 @@ float CmdVoronoi::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y
 	// linear search.
 	float fMinDistanceSq = std::numeric_limits<float>::max();
 
-	for(int i=0; i<_numPoints; ++i)
+	const Vec3* points = _points->GetPoints();
+	const int numPoints = _points->GetNumPoints();
+	WORK_COUNT(WORK_POINTS_SCANNED, numPoints);
+	for(int i=0; i<numPoints; ++i)
 	{
-		float fDistanceSq = sqrt(sqr(fx-_points[i].x) + sqr(fy-_points[i].y)) - _points[i].z;
+		float fDistanceSq = sqrt(sqr(fx-points[i].x) + sqr(fy-points[i].y)) - points[i].z * _height;
 		// Update minimum
 		if( fDistanceSq < fMinDistanceSq )
 			fMinDistanceSq = fDistanceSq;
@@ -45,12 +47,13 @@ float CmdVoronoi::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y
 void CmdVoronoi::Execute( const MapBufferInfo& bufferInfo,
 						const float* prevResult,
 						const float* currentResult,
-						float* destination)
+						float* destination,
+						const ExecutionContext& context)
 {
 	// **** Per pixel **** //
 	CommandDesc Cmd(bufferInfo, prevResult, currentResult,
 		std::bind(&CmdVoronoi::GeneratorKernel, this, _1, _2, _3, _4, _5),
-		destination);
+		destination, context);
 
 	GenerateLayer(Cmd);
 }
\ No newline at end of file
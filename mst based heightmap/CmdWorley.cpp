@@ -3,28 +3,26 @@
 #include <cassert>
 #include "CommandInfo.h"
 #include "math.hpp"
+#include "PointSet.hpp"
+#include "WorkCounters.hpp"
 
 using namespace std::placeholders;
 
 // ************************************************************************* //
-CmdWorly::CmdWorly(const Vec3* pointList, int numPoints, int nthNeighbor, float height) :
+CmdWorly::CmdWorly(std::shared_ptr<const PointSet> points, int nthNeighbor, float height) :
 	Command(CommandType::MST_DISTANCE),
-	_numPoints(numPoints),
+	_points(std::move(points)),
 	_nthNeighbor(nthNeighbor),
 	_height(height)
 {
-	assert(numPoints > nthNeighbor);
-
-	_points = new Vec3[numPoints];
-	memcpy( _points, pointList, numPoints * sizeof(Vec3) );
+	assert(_points->GetNumPoints() > nthNeighbor);
 }
 
 CmdWorly::~CmdWorly()
 {
-	delete[] _points;
 }
 
-float CmdWorly::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult )
+float CmdWorly::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult )
 {
 	float fx = x*bufferInfo.PixelSize;
 	float fy = y*bufferInfo.PixelSize;
@@ -34,9 +32,12 @@ float CmdWorly::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y,
 	std::unique_ptr<float[]> aDistancesSq(new float[_nthNeighbor+1]);
 	for(int i=0; i<=_nthNeighbor; ++i) aDistancesSq[i] = std::numeric_limits<float>::max();
 
-	for(int i=0; i<_numPoints; ++i)
+	const Vec3* points = _points->GetPoints();
+	const int numPoints = _points->GetNumPoints();
+	WORK_COUNT(WORK_POINTS_SCANNED, numPoints);
+	for(int i=0; i<numPoints; ++i)
 	{
-		float fDistanceSq = sqr(fx-_points[i].x) + sqr(fy-_points[i].y) + sqr(_points[i].z);
+		float fDistanceSq = sqr(fx-points[i].x) + sqr(fy-points[i].y) + sqr(points[i].z * _height);
 		// Update minimum list (sorted)
 		int j=0;
 		while( j<=_nthNeighbor )
@@ -60,12 +61,13 @@ float CmdWorly::GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y,
 void CmdWorly::Execute( const MapBufferInfo& bufferInfo,
 						const float* prevResult,
 						const float* currentResult,
-						float* destination)
+						float* destination,
+						const ExecutionContext& context)
 {
 	// **** Per pixel **** //
 	CommandDesc Cmd(bufferInfo, prevResult, currentResult,
 		std::bind(&CmdWorly::GeneratorKernel, this, _1, _2, _3, _4, _5),
-		destination);
+		destination, context);
 
 	GenerateLayerSeq(Cmd);
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "Stdafx.h"
+#include "CommandBuffer.hpp"
+#include "ExecutionState.hpp"
+
+// ************************************************************************* //
+AsyncExecution::AsyncExecution( float* buffer0, float* buffer1, CompletionCallback callback, void* userData ) :
+	_state(new State)
+{
+	assert( buffer0 && buffer1 && buffer0 != buffer1 );
+	_state->Buffers[0] = buffer0;
+	_state->Buffers[1] = buffer1;
+	_state->Callback = callback;
+	_state->UserData = userData;
+	_state->Thread = std::thread(&State::Run, _state);
+}
+
+AsyncExecution::~AsyncExecution()
+{
+	// The exception of a last execution which nobody waited for is lost.
+	try {
+		Wait();
+	} catch(...) {
+	}
+	{
+		std::lock_guard<std::mutex> lock( _state->Lock );
+		_state->IsShutdown = true;
+	}
+	_state->Changed.notify_all();
+	_state->Thread.join();
+	delete _state;
+}
+
+void AsyncExecution::State::Run()
+{
+	std::unique_lock<std::mutex> lock( Lock );
+	while( true )
+	{
+		while( !Job && !IsShutdown )
+			Changed.wait( lock );
+		if( !Job ) return;
+		std::function<void()> job = std::move(Job);
+		Job = nullptr;
+		lock.unlock();
+		std::exception_ptr exception;
+		try {
+			job();
+		} catch(...) {
+			exception = std::current_exception();
+		}
+		lock.lock();
+		if( exception ) Exception = exception;
+		// The callback may have started the next execution.
+		if( !Job )
+		{
+			IsBusy = false;
+			Changed.notify_all();
+		}
+	}
+}
+
+bool AsyncExecution::IsFinished() const
+{
+	return !_state->IsRunning.load();
+}
+
+ExecuteStatus AsyncExecution::Wait()
+{
+	// Executions which the callback starts are waited for as well.
+	std::unique_lock<std::mutex> lock( _state->Lock );
+	while( _state->IsBusy )
+		_state->Changed.wait( lock );
+	if( _state->Exception )
+	{
+		std::exception_ptr exception = _state->Exception;
+		_state->Exception = nullptr;
+		std::rethrow_exception( exception );
+	}
+	return _state->Status;
+}
+
+const float* AsyncExecution::GetFront() const
+{
+	int front = _state->Front.load();
+	return front >= 0 ? _state->Buffers[front] : nullptr;
+}
+
+// ************************************************************************* //
+bool GeneratorPipeline::ExecuteAsync( AsyncExecution& execution, int resolutionX, int resolutionY, bool normalizeData, unsigned int seed,
+	ExecutionControl* control )
+{
+	AsyncExecution::State* state = execution._state;
+	bool isRunning = false;
+	if( !state->IsRunning.compare_exchange_strong( isRunning, true ) )
+		return false;
+
+	std::function<void()> job = [=]()
+	{
+		// The back buffer is the one which is not shown.
+		int back = state->Front.load() == 0 ? 1 : 0;
+		float* map = state->Buffers[back];
+		ExecuteStatus status;
+		try {
+			status = Execute( resolutionX, resolutionY, map, normalizeData, seed, nullptr, control );
+		} catch(...) {
+			state->IsRunning.store( false );
+			throw;
+		}
+		state->Status = status;
+		if( status == ExecuteStatus::OK )
+			state->Front.store( back );
+		else map = nullptr;
+		// From now on another execution can be started.
+		state->IsRunning.store( false );
+		if( state->Callback )
+			state->Callback( status, map, state->UserData );
+	};
+	{
+		std::lock_guard<std::mutex> lock( state->Lock );
+		state->Job = std::move(job);
+		state->IsBusy = true;
+	}
+	state->Changed.notify_all();
+	return true;
+}
@@ -1,6 +1,7 @@
-#include "stdafx.h"
+#include "Stdafx.h"
 #include "CommandBuffer.hpp"
-#include "json-parser\json.h"
+#include "PointSet.hpp"
+#include "json-parser/json.h"
 
 using namespace std;
 
@@ -18,9 +19,30 @@ void GeneratorPipeline::InitializeTypeMap()
 	_typeMap.insert(pair<string, CommandType>(string("INTERPOLATE"), CommandType::INTERPOLATE));
 	_typeMap.insert(pair<string, CommandType>(string("Smooth"), CommandType::SMOOTH));
 	_typeMap.insert(pair<string, CommandType>(string("Normalize"), CommandType::NORMALIZE));
+	_typeMap.insert(pair<string, CommandType>(string("Erosion"), CommandType::EROSION));
 	_typeMap.insert(pair<string, CommandType>(string("NONE"), CommandType::NONE));
 }
 
+// ************************************************************************* //
+StorageDesc GeneratorPipeline::LoadStorage( const Json::Value& commandInfo, const StorageDesc& defaultStorage )
+{
+	// "Storage": "FLOAT", "HALF" or "UNORM16" and for UNORM16 the value range
+	// "StorageRange": [min, max]. Without a range UNORM16 falls back to HALF.
+	if( !commandInfo.isMember("Storage") )
+		return defaultStorage;
+	string format = commandInfo["Storage"].asString();
+	if( format == "HALF" )
+		return StorageDesc(StorageFormat::HALF);
+	if( format == "UNORM16" )
+	{
+		const Json::Value& range = commandInfo["StorageRange"];
+		if( range.size() != 2 || range[1u].asFloat() <= range[0u].asFloat() )
+			return StorageDesc(StorageFormat::HALF);
+		return StorageDesc(StorageFormat::UNORM16, range[0u].asFloat(), range[1u].asFloat() - range[0u].asFloat());
+	}
+	return StorageDesc();
+}
+
 
 // ************************************************************************* //
 Command* GeneratorPipeline::LoadValueNoiseCommand( const Json::Value& commandInfo )
@@ -37,30 +59,16 @@ Command* GeneratorPipeline::LoadMSTDistanceCommand( const Json::Value& commandIn
 {
 	float height = commandInfo.get("Height", 1.0f).asFloat();
 	float quadraticSplineHeight = commandInfo.get("QuadraticSpline", 0.3f).asFloat();
+	// Maximum interpolation error in height units. 0 evaluates each pixel.
+	float tolerance = max(0.0f, commandInfo.get("Tolerance", 0.0f).asFloat());
 
-	// read point array
-	auto pointSetArray = commandInfo.get("PointSet", Json::Value(Json::ValueType::objectValue)).get("Points", Json::Value(Json::ValueType::arrayValue));
-	int numPoints = pointSetArray.size();
-	std::unique_ptr<Vec3[]> points(new Vec3[numPoints]);
-//	float maxHeight = 0.0f;
-	for(int i=0; i<numPoints; ++i)
-	{
-		if(pointSetArray[i].size() != 3)
-			points[i] = Vec3(0,0,0);
-		else
-			points[i] = Vec3(pointSetArray[i][0].asFloat(),pointSetArray[i][1].asFloat(),pointSetArray[i][2].asFloat());
-//		maxHeight = std::max(maxHeight, points[i].z);
-	}
-
-	// scale points to height!
-	float scale = height; // height / maxHeight; 
-	for(int i=0; i<numPoints; ++i)
-		points[i].z *= scale;
+	// The points are scaled to height by the command
+	std::shared_ptr<const PointSet> points = LoadPointSet(commandInfo);
 
 	if(inverted)
-		return new CmdInvMSTDistance(points.get(), numPoints, height, quadraticSplineHeight);
+		return new CmdInvMSTDistance(points, height, quadraticSplineHeight, tolerance);
 	else
-		return new CmdMSTDistance(points.get(), numPoints, height, quadraticSplineHeight);
+		return new CmdMSTDistance(points, height, quadraticSplineHeight, tolerance);
 }
 
 
@@ -69,18 +77,8 @@ Command* GeneratorPipeline::LoadVoronoiCommand( const Json::Value& commandInfo )
 	// Read height scale
 	float heightScale = commandInfo.get("Height", 1.0f).asFloat();
 
-	// Read point array
-	auto pointSetArray = commandInfo.get("PointSet", Json::Value(Json::ValueType::objectValue)).get("Points", Json::Value(Json::ValueType::arrayValue));
-	int numPoints = pointSetArray.size();
-	std::unique_ptr<Vec3[]> points(new Vec3[numPoints]);
-	for(int i=0; i<numPoints; ++i)
-	{
-		if(pointSetArray[i].size() != 3)
-			points[i] = Vec3(0,0,0);
-		else
-			points[i] = Vec3(pointSetArray[i][0].asFloat(),pointSetArray[i][1].asFloat(),pointSetArray[i][2].asFloat()*heightScale);
-	}
-	return new CmdVoronoi(points.get(), numPoints, heightScale);
+	// Read point array (shared, the command scales the heights)
+	return new CmdVoronoi(LoadPointSet(commandInfo), heightScale);
 }
 
 
@@ -90,18 +88,8 @@ Command* GeneratorPipeline::LoadWorleyNoiseCommand( const Json::Value& commandIn
 	float heightScale = commandInfo.get("Height", 1.0f).asFloat();
 	int nthNeighbor = int(commandInfo.get("NthNeighbor", 0.0f).asFloat()+0.5f);
 
-	// Read point array
-	auto pointSetArray = commandInfo.get("PointSet", Json::Value(Json::ValueType::objectValue)).get("Points", Json::Value(Json::ValueType::arrayValue));
-	int numPoints = pointSetArray.size();
-	std::unique_ptr<Vec3[]> points(new Vec3[numPoints]);
-	for(int i=0; i<numPoints; ++i)
-	{
-		if(pointSetArray[i].size() != 3)
-			points[i] = Vec3(0,0,0);
-		else
-			points[i] = Vec3(pointSetArray[i][0].asFloat(),pointSetArray[i][1].asFloat(),pointSetArray[i][2].asFloat()*heightScale);
-	}
-	return new CmdWorly(points.get(), numPoints, nthNeighbor, heightScale);
+	// Read point array (shared, the command scales the heights)
+	return new CmdWorly(LoadPointSet(commandInfo), nthNeighbor, heightScale);
 }
 
 Command* GeneratorPipeline::LoadVoronoiseCommand( const Json::Value& commandInfo )
@@ -115,6 +103,27 @@ Command* GeneratorPipeline::LoadVoronoiseCommand( const Json::Value& commandInfo
 }
 
 
+Command* GeneratorPipeline::LoadSmoothCommand( const Json::Value& commandInfo )
+{
+	float radius = commandInfo.get("Radius", 1.0f).asFloat();
+	int iterations = commandInfo.get("Iterations", 3).asInt();
+	return new CmdSmooth(radius, max(1, iterations));
+}
+
+Command* GeneratorPipeline::LoadErosionCommand( const Json::Value& commandInfo )
+{
+	CmdErosion::Parameters params;
+	params.Iterations = commandInfo.get("Iterations", 50).asInt();
+	params.Rain = commandInfo.get("Rain", 0.01f).asFloat();
+	params.Evaporation = commandInfo.get("Evaporation", 0.05f).asFloat();
+	params.Capacity = commandInfo.get("Capacity", 1.0f).asFloat();
+	params.Dissolving = commandInfo.get("Dissolving", 0.3f).asFloat();
+	params.Deposition = commandInfo.get("Deposition", 0.3f).asFloat();
+	params.Talus = commandInfo.get("Talus", 1.0f).asFloat();
+	params.ThermalRate = commandInfo.get("ThermalRate", 0.5f).asFloat();
+	return new CmdErosion(params);
+}
+
 
 Command* GeneratorPipeline::LoadBlendCommand( const Json::Value& commandInfo )
 {
@@ -134,14 +143,17 @@ Command* GeneratorPipeline::LoadBlendCommand( const Json::Value& commandInfo )
 }
 
 
-GeneratorPipeline::GeneratorPipeline(const std::string& jsonCode)
+GeneratorPipeline::GeneratorPipeline(const std::string& jsonCode, const std::string& snapshotFile)
 {
 	InitializeTypeMap();
+	_contentHash = OrE::Algorithm::CreateHash64(jsonCode.data(), jsonCode.size());
 
 	Json::Value root;   // will contains the root value after parsing.
-	Json::Reader reader;
-	bool parsingSuccessful = reader.parse( jsonCode, root );
+	bool parsingSuccessful = ParseScript( jsonCode, root );
 	assert(parsingSuccessful && "JSON parsing failed");
+	// Continue with an empty script.
+	_isValid = parsingSuccessful;
+	if( !parsingSuccessful ) root = Json::Value();
 
 	// Read general map infos
 	_worldSizeX = root["HeightmapWidth"].asFloat();
@@ -149,16 +161,18 @@ GeneratorPipeline::GeneratorPipeline(const std::string& jsonCode)
 	_heightMapPixelPerWorldUnit = root["HeightmapPixelPerWorldUnit"].asFloat();
 
 	// Read command array
-	Json::Value layers = root["Layers"];
+	const Json::Value& layers = root["Layers"];
 	_numCommands = 0;
 	// Allocate enough, that each layer can have a blend command
 	_commands = new Command*[layers.size()*2];
 	memset(_commands, 0, sizeof(Command*) * layers.size()*2);
+	_storage.resize(layers.size()*2);
+	StorageDesc defaultStorage = LoadStorage(root, StorageDesc());
 
 	for(unsigned int jsonLayerIndex=0; jsonLayerIndex<layers.size(); ++jsonLayerIndex)
 	{
 		CommandType type = _typeMap[layers[jsonLayerIndex].get("Type", "NONE").asString()];
-		Json::Value& currentLayer = layers[jsonLayerIndex];
+		const Json::Value& currentLayer = layers[jsonLayerIndex];
 		bool bIsKnown = true;
 		switch(type)
 		{
@@ -180,9 +194,13 @@ GeneratorPipeline::GeneratorPipeline(const std::string& jsonCode)
 		case CommandType::VORONOISE:
 			_commands[_numCommands] = LoadVoronoiseCommand(currentLayer);
 			break;
-	/*	case CommandType::SMOOTH:
+		case CommandType::SMOOTH:
+			_commands[_numCommands] = LoadSmoothCommand(currentLayer);
 			break;
-		case CommandType::NORMALIZE:
+		case CommandType::EROSION:
+			_commands[_numCommands] = LoadErosionCommand(currentLayer);
+			break;
+	/*	case CommandType::NORMALIZE:
 			break;
 			*/
 		default:
@@ -192,17 +210,32 @@ GeneratorPipeline::GeneratorPipeline(const std::string& jsonCode)
 
 		if( bIsKnown )
 		{
-			// Count the new commando and read its blending
+			std::string layerName = "Layer " + std::to_string(jsonLayerIndex) + ": ";
+			_commandNames.push_back( layerName + currentLayer.get("Type", "NONE").asString() );
+			// Count the new commando and read its blending. Both results
+			// are stored in the precision of the layer.
+			StorageDesc storage = LoadStorage(currentLayer, defaultStorage);
+			_storage[_numCommands] = storage;
 			++_numCommands;
 			assert(_numCommands < (int)layers.size() * 2 && "More commands than expected, array size is not sufficient!");
 			_commands[_numCommands] = LoadBlendCommand(currentLayer);
-			if( _commands[_numCommands] ) _numCommands++;
+			_storage[_numCommands] = storage;
+			if( _commands[_numCommands] )
+			{
+				_commandNames.push_back( layerName + currentLayer.get("Blending", "NONE").asString() );
+				_numCommands++;
+			}
 		}
 	}
+
+	CompileGraph();
+	CreateStatePool();
+	LoadSnapshot(snapshotFile);
 }
 
 GeneratorPipeline::~GeneratorPipeline()
 {
+	DeleteStatePool();
 	for(int i=0; i<_numCommands; ++i)
 		delete _commands[i];
 	delete[] _commands;
@@ -1,11 +1,123 @@
 #pragma once
 
 #include "CommandInfo.h"
+#include "ExecutionStats.hpp"
+#include "MappedFile.hpp"
+#include <memory>
+#include <vector>
 
 // Predeclarations
 namespace Json {
 	class Value;
 };
+struct TaskTrace;
+
+/// \brief Result of GeneratorPipeline::Execute and ExecuteBatch.
+enum struct ExecuteStatus
+{
+	OK,
+	OUT_OF_MEMORY,		///< The buffers would exceed a memory limit. Nothing was computed.
+	CANCELLED			///< ExecutionControl::Cancel was called. The destination is incomplete.
+};
+
+/// \brief Progress reporting and cancellation of one execution.
+/// \details The progress is estimated from the finished tiles (blocks of
+///		lines) of all commands. Each executed command has the same weight.
+///		Cancel can be called from any thread. The execution stops after the
+///		tiles which are running, releases its buffers and returns CANCELLED.
+///		The precomputation of the first execution is not interrupted.
+///
+///		A control is used by one execution at a time. Cancellation is
+///		permanent, a new execution needs a new control.
+class ExecutionControl
+{
+public:
+	/// \brief Receives the finished fraction [0,1] of the execution.
+	/// \details Called from the pool threads whenever the progress grows.
+	///		Calls may be concurrent, so it must be thread safe and fast.
+	typedef void (*ProgressCallback)(float progress, void* userData);
+
+	CPP_DLL ExecutionControl(ProgressCallback callback = nullptr, void* userData = nullptr);
+	CPP_DLL ~ExecutionControl();
+
+	CPP_DLL void Cancel();
+	CPP_DLL bool IsCancelled() const;
+	/// \brief Finished fraction [0,1] for polling instead of a callback.
+	CPP_DLL float GetProgress() const;
+
+private:
+	/// Counters of the running execution (ExecutionState.hpp).
+	struct State;
+	State* _state;
+	friend class GeneratorPipeline;
+
+	// Prevent copy constructor and operator = being generated.
+	ExecutionControl(const ExecutionControl&);
+	ExecutionControl& operator = (const ExecutionControl&);
+};
+
+/// \brief Asynchronous executions into two caller owned maps.
+/// \details GeneratorPipeline::ExecuteAsync writes the back buffer while
+///		the caller reads the front buffer - the last complete map. A
+///		successful execution swaps them, so a new map is shown without any
+///		copy. The back buffer must not be read while an execution runs.
+///
+///		One execution per object runs at a time on a thread of the object,
+///		which uses the pool for the parallel work. The object must live
+///		until it is finished; the destructor waits for it.
+class AsyncExecution
+{
+public:
+	/// \brief Called on the thread of the object when an execution is
+	///		finished.
+	/// \param [in] map The new front buffer or nullptr if the execution
+	///		failed (the front buffer is unchanged then).
+	/// \details May start the next execution of the same object.
+	typedef void (*CompletionCallback)(ExecuteStatus status, const float* map, void* userData);
+
+	/// \param [in] buffer0 First map of resolutionX * resolutionY floats
+	///		for all executions.
+	/// \param [in] buffer1 Second map of the same size.
+	CPP_DLL AsyncExecution(float* buffer0, float* buffer1, CompletionCallback callback = nullptr, void* userData = nullptr);
+	CPP_DLL ~AsyncExecution();
+
+	/// \brief True if no execution is running.
+	CPP_DLL bool IsFinished() const;
+	/// \brief Block until the execution is finished. Must not be called
+	///		from the callback.
+	/// \return The result of the last execution. An exception of the
+	///		execution (e.g. std::bad_alloc) is rethrown.
+	CPP_DLL ExecuteStatus Wait();
+	/// \brief The last complete map or nullptr before the first one.
+	CPP_DLL const float* GetFront() const;
+
+private:
+	/// Buffers and synchronization (ExecutionState.hpp).
+	struct State;
+	State* _state;
+	friend class GeneratorPipeline;
+
+	// Prevent copy constructor and operator = being generated.
+	AsyncExecution(const AsyncExecution&);
+	AsyncExecution& operator = (const AsyncExecution&);
+};
+
+/// \brief Memory which a pipeline holds (see GeneratorPipeline::GetMemoryUsage).
+struct MemoryUsage
+{
+	size_t CurrentBytes;	///< Point sets, precomputed data and the buffers kept for the next execution.
+	size_t PeakBytes;		///< Maximum of CurrentBytes since the construction.
+	size_t LimitBytes;		///< See GeneratorPipeline::SetMemoryLimit, 0 if unlimited.
+	std::vector<size_t> CommandBytes;	///< Precomputed data of each command (e.g. MSTs).
+};
+
+/// \brief Parameters of one map in GeneratorPipeline::ExecuteBatch.
+struct PipelineVariant
+{
+	unsigned int Seed;		///< Seed of all noise functions.
+	float HeightScale;		///< Factor for the "Height" of all seed dependent layers.
+	float* Destination;		///< Buffer of resolutionX * resolutionY floats for the result.
+};
 
 class GeneratorPipeline
 {
@@ -13,27 +125,166 @@ private:
 	float _worldSizeX;
 	float _worldSizeY;
 	float _heightMapPixelPerWorldUnit;
+	bool _isValid;			///< The script and all its files could be read.
 
 	int _numCommands;
 	Command** _commands;
+	std::vector<std::string> _commandNames;	///< Layer and type of each command for the stats.
+	std::vector<StorageDesc> _storage;	///< Requested precision of each command result.
+
+	/// \brief Node of the execution graph.
+	/// \details Node i executes _commands[i] and its result is buffer i. A
+	///		command reads the buffers of the two commands before it (as far
+	///		as it uses them, see Command::GetInputs). Commands without a path
+	///		to the final command are never executed.
+	struct GraphNode
+	{
+		int Inputs[2];					///< Buffers for prevResult and currentResult or -1.
+		std::vector<int> Readers;		///< Nodes which read this result.
+		bool IsRequired;				///< Contributes to the final result.
+		bool IsVariant;					///< Depends on the seed (directly or through an input).
+	};
+	std::vector<GraphNode> _graph;
+	void CompileGraph();
+
+	/// What a plan does with a node.
+	enum NodeRole
+	{
+		NODE_SKIP,			///< Not executed. Its result might be an external input.
+		NODE_RUN,			///< Executed, the result is in the workspace.
+		NODE_OUTPUT			///< Executed, the result is written to an external float buffer.
+	};
+	/// Roles for a normal execution: all required nodes, the final one is the output.
+	void GetExecuteRoles(std::vector<char>& roles) const;
+
+	/// \brief Assignment of all temporary buffers to memory for one resolution.
+	/// \details Results and scratch memory of the commands share physical
+	///		buffers if their lifetimes do not overlap. The order of the
+	///		commands defines the lifetimes. Reusing a buffer adds a dependency
+	///		from every user of the old content to the writer of the new one.
+	struct BufferPlan
+	{
+		int ResolutionX;
+		int ResolutionY;
+		int SampleStride;					///< See MapBufferInfo::SampleStride.
+		std::vector<char> Roles;			///< NodeRole of each node.
+		std::vector<size_t> SlotOffsets;	///< Offset of each physical buffer in the workspace.
+		std::vector<size_t> SlotSizes;		///< Size of each physical buffer.
+		std::vector<int> ResultSlot;		///< Physical buffer of each node result or -1.
+		std::vector<StorageDesc> ResultStorage;	///< Format of each node result.
+		std::vector<int> ScratchSlot;		///< Physical buffer of the scratch memory of each node or -1.
+		std::vector<size_t> ScratchSize;	///< Bytes of scratch memory of each node.
+		std::vector<std::vector<int> > Dependents;	///< Nodes to notify after each node (data + reuse).
+		std::vector<int> NumDependencies;	///< Number of entries in Dependents per node.
+		size_t Size;						///< Sum of all physical buffers (peak memory).
+
+		BufferPlan() : ResolutionX(0), ResolutionY(0), SampleStride(1), Size(0) {}
+	};
+	void PlanBuffers(const MapBufferInfo& bufferInfo, const std::vector<char>& roles, BufferPlan& plan) const;
+
+	/// \brief Memory and schedule of one Execute call (see ExecutionState.hpp).
+	/// \details Concurrent executions use different states. Idle states
+	///		are kept, so later executions reuse their memory.
+	struct ExecutionState;
+	/// \brief All states and the locks of the pipeline. It is only defined
+	///		in native code because std::mutex is not available with /clr.
+	struct StatePool;
+	StatePool* _states;
+	void CreateStatePool();
+	void DeleteStatePool();
+	ExecutionState* AcquireState();
+	void ReleaseState(ExecutionState* state);
+
+	/// \brief Execute all nodes of a plan with the state.
+	/// \details state.Results must contain the buffers of all NODE_OUTPUT
+	///		nodes and of the skipped nodes which are inputs.
+	/// \param [out] outputRange Value range of the final node or nullptr.
+	/// \param [in] trace Records all tasks of the execution or nullptr.
+	/// \param [out] stats Receives the command timings relative to the
+	///		start of the trace (requires a trace) or nullptr.
+	/// \param [in] control Progress and cancellation or nullptr.
+	/// \return OUT_OF_MEMORY if the workspace exceeds a memory limit. No
+	///		command was executed then.
+	ExecuteStatus RunPlan(ExecutionState& state, const MapBufferInfo& bufferInfo, const std::vector<char>& roles,
+		unsigned int seed, float heightScale, ValueRange* outputRange, TaskTrace* trace = nullptr, ExecutionStats* stats = nullptr,
+		ExecutionControl* control = nullptr);
+	/// \brief Execute all commands for one buffer info into the destination
+	///		in a state of the pool (without precomputation and normalization).
+	/// \param [out] range Value range of the final command or nullptr.
+	ExecuteStatus ExecuteMap(const MapBufferInfo& bufferInfo, float* finalDestination, ValueRange* range, unsigned int seed,
+		TaskTrace* trace, ExecutionStats* stats, ExecutionControl* control);
+	void Normalize(float* data, int resolutionX, int resolutionY, ValueRange range) const;
+
+	/// Point sets which were decoded from the script. The commands share them.
+	std::vector<std::shared_ptr<const PointSet> > _pointSets;
+
+	/// Hash of the script and all point set files. A snapshot is only used
+	/// if it was created for the same content.
+	uint64_t _contentHash;
+	MappedFile _snapshot;		///< Precomputed data of the commands if loaded from a snapshot.
+	std::string _snapshotFile;	///< Written after the precomputation if the snapshot did not fit.
+	std::vector<int> _pendingPrecompute;	///< Commands which still need Command::Precompute.
+	/// \brief Load the precomputed data of all commands from a snapshot.
+	/// \details Everything which cannot be loaded is added to
+	///		_pendingPrecompute. Nothing is computed here.
+	void LoadSnapshot(const std::string& snapshotFile);
+	/// \brief Run all pending precomputations in parallel on the pool
+	///		and write the snapshot file if required.
+	/// \details Thread safe, concurrent callers wait for the first one.
+	/// \param [out] milliseconds Optional time spent (0 if there was
+	///		nothing to do).
+	/// \return OUT_OF_MEMORY if the point sets or the estimated memory of
+	///		the precomputations exceed a memory limit. Nothing is computed
+	///		then and the next call tries again.
+	ExecuteStatus Precompute(double* milliseconds = nullptr);
+	bool WriteSnapshot(const std::string& fileName) const;
 
 	std::unordered_map<std::string, CommandType> _typeMap;
 	void InitializeTypeMap();
+	void FillBufferInfo(MapBufferInfo& bufferInfo, int resolutionX, int resolutionY) const;
 
+	/// \brief Parse the script with the streaming reader. Point arrays are
+	///		decoded into _pointSets on the way.
+	bool ParseScript( const std::string& jsonCode, Json::Value& root );
+	std::shared_ptr<const PointSet> LoadPointSet( const Json::Value& commandInfo );
+	StorageDesc LoadStorage( const Json::Value& commandInfo, const StorageDesc& defaultStorage );
 	Command* LoadBlendCommand( const Json::Value& commandInfo );
 	Command* LoadValueNoiseCommand( const Json::Value& commandInfo );
 	Command* LoadMSTDistanceCommand( const Json::Value& commandInfo, bool inverted );
 	Command* LoadVoronoiCommand( const Json::Value& commandInfo );
 	Command* LoadWorleyNoiseCommand( const Json::Value& commandInfo );
 	Command* LoadVoronoiseCommand( const Json::Value& commandInfo );
+	Command* LoadSmoothCommand( const Json::Value& commandInfo );
+	Command* LoadErosionCommand( const Json::Value& commandInfo );
 public:
 	/// \brief Loads commands from a script.
 	/// \param [in] jsonCode An array of commands in form of a json file.
+	///		Generators with points read them from "PointSet": {"Points":
+	///		[[x,y,z], ...]} or from a binary file "PointSet": {"File": path}
+	///		(see PointSetFileHeader) which is memory mapped.
+	/// \param [in] snapshotFile Optional file with the precomputed data
+	///		(e.g. MSTs) of the commands. If it belongs to the same script it
+	///		is memory mapped instead of computing everything again. Otherwise
+	///		it is created by the first Execute.
+	/// \details Expensive precomputations (e.g. MSTs) are deferred to the
+	///		first Execute where all layers are prepared in parallel.
 	/// TODO: format description
-	CPP_DLL GeneratorPipeline(const std::string& jsonCode);
+	CPP_DLL GeneratorPipeline(const std::string& jsonCode, const std::string& snapshotFile = std::string());
+
+	/// \brief Write the precomputed data of all commands into a file which
+	///		can be passed to the constructor later.
+	/// \details Finishes the deferred precomputation first.
+	/// \return false if the precomputation exceeds a memory limit or the
+	///		file cannot be written.
+	CPP_DLL bool SaveSnapshot(const std::string& fileName);
+
+	/// \brief False if the script could not be parsed or a point set file
+	///		could not be read. The pipeline is empty or incomplete then.
+	CPP_DLL bool IsValid() const	{ return _isValid; }
 
 	/// \brief After load the commands can be executed and the results are
 	///		written to the given buffer.
+	/// \details Commands which do not depend on each other run concurrently.
 	/// \param [in] resolutionX Target width of the generated map. The map
 	///		area is defined by the json input. So the shown section is always
 	///		the same. There are just more samples per world unit.
@@ -46,7 +297,94 @@ public:
 	/// \param [in] normalizeData true means that all values in
 	///		finalDestination will be scaled and offseted to a range from [0,1].
 	///		Otherwise the values of finalDestination are in an arbitrary range.
-	CPP_DLL void Execute(int resolutionX, int resolutionY, float* finalDestination, bool normalizeData = true);
+	/// \param [in] seed Seed of all noise functions.
+	/// \param [out] stats Optional timing and memory statistics of this
+	///		call. Collecting them costs a few microseconds per task.
+	/// \param [in] control Optional progress callback and cancellation.
+	/// \details Thread safe: one pipeline can run several executions with
+	///		different resolutions and seeds concurrently.
+	/// \return OUT_OF_MEMORY if the temporary buffers or the deferred
+	///		precomputation would exceed a memory limit. The destination is
+	///		not changed then. CANCELLED if the control was cancelled.
+	CPP_DLL ExecuteStatus Execute(int resolutionX, int resolutionY, float* finalDestination, bool normalizeData = true, unsigned int seed = 0,
+		ExecutionStats* stats = nullptr, ExecutionControl* control = nullptr);
+
+	/// \brief Execute without blocking the calling thread.
+	/// \details The whole execution (including the first precomputation)
+	///		runs on the thread of the AsyncExecution, also if the pool has
+	///		no workers. The result is written to the back buffer of the
+	///		AsyncExecution. The pipeline must not be destroyed before the
+	///		execution is finished.
+	/// \param [in] control Optional progress callback and cancellation.
+	/// \return false if the previous execution of the AsyncExecution is not
+	///		finished yet. Nothing is started then.
+	CPP_DLL bool ExecuteAsync(AsyncExecution& execution, int resolutionX, int resolutionY, bool normalizeData = true, unsigned int seed = 0,
+		ExecutionControl* control = nullptr);
+
+	/// \brief Receives one pass of ExecuteProgressive.
+	/// \param [in] map resolutionX * resolutionY samples of the map,
+	///		normalized on its own if requested. Valid during the call.
+	/// \param [in] stride Distance of the samples in pixels of the final
+	///		map, 1 for the final pass (then map is the destination).
+	typedef void (*PassCallback)(const float* map, int resolutionX, int resolutionY, int stride, void* userData);
+
+	/// \brief Execute in passes from a coarse to the final resolution for
+	///		interactive previews.
+	/// \details The first pass takes every 8th pixel in both directions,
+	///		each further pass halves the distance. If all required commands
+	///		are pointwise the samples of a pass are exactly pixels of the
+	///		final map. Then each pass only computes the samples which are new
+	///		(3/4) and the whole map costs little more than one Execute.
+	///		Otherwise each pass is an Execute with the reduced resolution.
+	/// \param [in] callback Called on the calling thread after each pass or
+	///		nullptr.
+	/// \return Like Execute. A cancelled or failed execution stops after
+	///		the current pass.
+	CPP_DLL ExecuteStatus ExecuteProgressive(int resolutionX, int resolutionY, float* finalDestination, bool normalizeData = true, unsigned int seed = 0,
+		PassCallback callback = nullptr, void* userData = nullptr, ExecutionControl* control = nullptr);
+
+	/// \brief Generate many variants of the map with different seeds and
+	///		heights of the noise layers.
+	/// \details Layers which do not depend on the seed (e.g. MST distances
+	///		and everything which is only computed from them) are executed
+	///		once. Their results are shared by all variants. The remaining
+	///		layers of the variants run concurrently on the pool.
+	///		The result of each variant is identical to an Execute with the
+	///		same seed and the HeightScale applied to the script.
+	/// \param [in] variants Array of numVariants parameter sets. Each one
+	///		has its own destination.
+	/// \return OUT_OF_MEMORY if a memory limit was exceeded. Some variants
+	///		may be incomplete then.
+	CPP_DLL ExecuteStatus ExecuteBatch(int resolutionX, int resolutionY, const PipelineVariant* variants, int numVariants, bool normalizeData = true);
+
+	/// \brief Number of bytes which Execute needs for its temporary buffers.
+	/// \details This is the peak memory of an execution beside the final
+	///		destination. Buffers are shared between commands with disjoint
+	///		lifetimes. The memory is kept alive between executions and only
+	///		grows if a larger resolution is requested.
+	CPP_DLL size_t GetWorkspaceSize(int resolutionX, int resolutionY) const;
+
+	/// \brief Use caller owned memory for all temporary buffers.
+	/// \param [in] workspace 64 byte aligned memory of at least
+	///		GetWorkspaceSize() bytes. Then Execute does not allocate any map
+	///		buffers. nullptr switches back to pipeline owned memory.
+	/// \details The workspace is used by one execution at a time. Other
+	///		concurrent executions use pipeline owned memory. Must not be
+	///		called during an execution.
+	CPP_DLL void SetWorkspace(void* workspace, size_t size);
+
+	/// \brief Allocate the pipeline owned memory with transparent huge pages
+	///		(if supported by the OS). Must not be called during an execution.
+	CPP_DLL void SetUseHugePages(bool useHugePages);
+
+	/// \brief Limit the memory of the pipeline. Executions which would need
+	///		more fail with OUT_OF_MEMORY before computing anything.
+	/// \param [in] bytes Maximum of MemoryUsage::CurrentBytes including the
+	///		point sets and precomputed data, 0 for no limit.
+	CPP_DLL void SetMemoryLimit(size_t bytes);
+	/// \brief Limit the memory of all pipelines of the process together.
+	static CPP_DLL void SetProcessMemoryLimit(size_t bytes);
+	CPP_DLL MemoryUsage GetMemoryUsage() const;
 
 	CPP_DLL ~GeneratorPipeline();
 };
\ No newline at end of file
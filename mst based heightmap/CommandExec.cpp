@@ -1,61 +1,552 @@
 #include "Stdafx.h"
 #include "CommandBuffer.hpp"
+#include "ExecutionState.hpp"
 #include "Filter.h"
+#include "PointSet.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
-void GeneratorPipeline::Execute(int resolutionX, int resolutionY, float* finalDestination, bool normalizeData)
-//void ExecuteCommands(Command** commands, int numCommands, const MapBufferInfo& bufferInfo, float* finalDestination)
+void GeneratorPipeline::FillBufferInfo(MapBufferInfo& bufferInfo, int resolutionX, int resolutionY) const
 {
-	// Acquire a triple buffer
-	size_t bufferSize = resolutionX * resolutionY * sizeof(float);
-	float* buffer[3] = {(float*)malloc(bufferSize), (float*)malloc(bufferSize), (float*)malloc(bufferSize)};
-
-	// Put all buffer related things together
-	MapBufferInfo bufferInfo;
 	bufferInfo.ResolutionX = resolutionX;
 	bufferInfo.ResolutionY = resolutionY;
 	bufferInfo.WorldSizeX = _worldSizeX;
 	bufferInfo.WorldSizeY = _worldSizeY;
 	bufferInfo.PixelSize = _worldSizeX / resolutionX;
 	bufferInfo.HeightmapPixelPerWorldUnit = 1.0f / bufferInfo.PixelSize;
+	bufferInfo.SampleStride = 1;
+	bufferInfo.HasEvenSamples = false;
+}
+
+// ************************************************************************* //
+ExecutionControl::ExecutionControl(ProgressCallback callback, void* userData) :
+	_state(new State)
+{
+	_state->Callback = callback;
+	_state->UserData = userData;
+}
+
+ExecutionControl::~ExecutionControl()
+{
+	delete _state;
+}
+
+void ExecutionControl::Cancel()
+{
+	_state->Tasks.IsCancelled.store(true);
+}
+
+bool ExecutionControl::IsCancelled() const
+{
+	return _state->Tasks.IsCancelled.load();
+}
+
+float ExecutionControl::GetProgress() const
+{
+	return float(_state->Progress.load()) / State::COMMAND_WORK;
+}
+
+// ************************************************************************* //
+void GeneratorPipeline::CreateStatePool()
+{
+	_states = new StatePool(_numCommands);
+	// The decoded points are owned by the pipeline. If they exceed a limit
+	// all executions fail until they fit (see Precompute).
+	size_t pointSetBytes = 0;
+	for(size_t i=0; i<_pointSets.size(); ++i)
+		pointSetBytes += _pointSets[i]->GetOwnedBytes();
+	if(!_states->Memory.TryCharge(pointSetBytes))
+		_states->PendingPointSetBytes = pointSetBytes;
+	_states->States.push_back(new ExecutionState(_numCommands, &_states->Memory));
+	_states->Idle.push_back(_states->States[0]);
+}
+
+void GeneratorPipeline::DeleteStatePool()
+{
+	for(size_t i=0; i<_states->States.size(); ++i)
+		delete _states->States[i];
+	delete _states;
+}
+
+GeneratorPipeline::ExecutionState* GeneratorPipeline::AcquireState()
+{
+	std::lock_guard<std::mutex> lock(_states->Lock);
+	if(_states->Idle.empty())
+	{
+		ExecutionState* state = new ExecutionState(_numCommands, &_states->Memory);
+		state->Arena.SetUseHugePages(_states->UseHugePages);
+		_states->States.push_back(state);
+		return state;
+	}
+	// The primary state is always at the front.
+	ExecutionState* state = _states->Idle.front();
+	_states->Idle.erase(_states->Idle.begin());
+	return state;
+}
+
+void GeneratorPipeline::ReleaseState(ExecutionState* state)
+{
+	std::lock_guard<std::mutex> lock(_states->Lock);
+	if(state == _states->States[0])
+		_states->Idle.insert(_states->Idle.begin(), state);
+	else _states->Idle.push_back(state);
+}
+
+// ************************************************************************* //
+void GeneratorPipeline::SetWorkspace(void* workspace, size_t size)
+{
+	_states->States[0]->Arena.SetWorkspace(workspace, size);
+}
+
+void GeneratorPipeline::SetUseHugePages(bool useHugePages)
+{
+	_states->UseHugePages = useHugePages;
+	for(size_t i=0; i<_states->States.size(); ++i)
+		_states->States[i]->Arena.SetUseHugePages(useHugePages);
+}
+
+// ************************************************************************* //
+void GeneratorPipeline::SetMemoryLimit(size_t bytes)
+{
+	_states->Memory.SetLimit(bytes);
+}
+
+void GeneratorPipeline::SetProcessMemoryLimit(size_t bytes)
+{
+	MemoryAccount::GetProcess().SetLimit(bytes);
+}
 
-	float* last = nullptr;
-	float* current = nullptr;
-	int destIndex = 0;
+MemoryUsage GeneratorPipeline::GetMemoryUsage() const
+{
+	MemoryUsage usage;
+	usage.CurrentBytes = _states->Memory.GetCurrent();
+	usage.PeakBytes = _states->Memory.GetPeak();
+	usage.LimitBytes = _states->Memory.GetLimit();
+	usage.CommandBytes.resize(_numCommands);
 	for(int i=0; i<_numCommands; ++i)
+		usage.CommandBytes[i] = _states->CommandMemory[i]->GetCurrent();
+	return usage;
+}
+
+// ************************************************************************* //
+// Busy time per pool thread from the outermost tasks of a trace. The
+// counters of all tasks of a command are summed up.
+static void CollectThreadStats(const TaskTrace& trace, ExecutionStats& stats)
+{
+	stats.Threads.assign(ThreadPool::Get().GetNumThreads(), ThreadStats());
+	stats.Tasks.resize(trace.Intervals.size());
+	for(size_t i=0; i<trace.Intervals.size(); ++i)
 	{
-		// Write to the temporary buffer except for the last command. Write to
-		// final destination instead.
-		_commands[i]->Execute(bufferInfo, last, current, (i==_numCommands-1 ? finalDestination : buffer[destIndex]));
-		// Toggle the 3 buffers. For the last one this is irrelevant.
-		last = current;
-		current = buffer[destIndex];
-		destIndex = (destIndex + 1) % 3;
+		const TaskTrace::Interval& interval = trace.Intervals[i];
+		TaskStats task = { interval.Thread, interval.Depth, interval.Tag, interval.BeginMs, interval.EndMs, interval.Counters };
+		stats.Tasks[i] = task;
+		if(interval.Tag >= 0 && interval.Tag < (int)stats.Commands.size())
+			stats.Commands[interval.Tag].Counters += interval.Counters;
+		if(interval.Depth == 0 && interval.Thread < (int)stats.Threads.size())
+			stats.Threads[interval.Thread].BusyMs += interval.EndMs - interval.BeginMs;
 	}
+	double duration = stats.ExecuteEndMs - stats.ExecuteBeginMs;
+	for(size_t t=0; t<stats.Threads.size(); ++t)
+		stats.Threads[t].IdleMs = max(0.0, duration - stats.Threads[t].BusyMs);
+}
 
-	free(buffer[0]);
-	free(buffer[1]);
-	free(buffer[2]);
+// ************************************************************************* //
+ExecuteStatus GeneratorPipeline::Execute(int resolutionX, int resolutionY, float* finalDestination, bool normalizeData, unsigned int seed,
+	ExecutionStats* stats, ExecutionControl* control)
+//void ExecuteCommands(Command** commands, int numCommands, const MapBufferInfo& bufferInfo, float* finalDestination)
+{
+	if(_numCommands == 0) return ExecuteStatus::OK;
+	if(control && control->IsCancelled()) return ExecuteStatus::CANCELLED;
+	// All times of the stats are relative to the trace which also records
+	// the tasks of this call.
+	std::unique_ptr<TaskTrace> trace(stats ? new TaskTrace : nullptr);
+	if(stats)
+	{
+		CounterValues probe;
+		stats->HasHardwareCounters = stats->UseHardwareCounters && ReadThreadCounters(probe);
+		trace->UseCounters = stats->HasHardwareCounters;
+	}
+	// MSTs etc. are built on the first call.
+	double precomputeTime;
+	ExecuteStatus precomputeStatus = Precompute(&precomputeTime);
+	if(precomputeStatus != ExecuteStatus::OK)
+		return precomputeStatus;
+
+	// Put all buffer related things together
+	MapBufferInfo bufferInfo;
+	FillBufferInfo(bufferInfo, resolutionX, resolutionY);
+	if(stats)
+		stats->PrecomputeMs = precomputeTime;
 
+	// The final command reports its value range while writing the results
+	// so normalization needs no additional scan.
+	ValueRange range;
+	ExecuteStatus status = ExecuteMap(bufferInfo, finalDestination, normalizeData ? &range : nullptr, seed, trace.get(), stats, control);
+	if(status != ExecuteStatus::OK)
+		return status;
 
-	// normalize data
 	if(normalizeData)
+		Normalize(finalDestination, resolutionX, resolutionY, range);
+
+	if(stats)
+	{
+		stats->TotalMs = trace->GetTime();
+		stats->NormalizeMs = normalizeData ? stats->TotalMs - stats->ExecuteEndMs : 0.0;
+		CollectThreadStats(*trace, *stats);
+	}
+	return ExecuteStatus::OK;
+}
+
+// ************************************************************************* //
+ExecuteStatus GeneratorPipeline::ExecuteMap(const MapBufferInfo& bufferInfo, float* finalDestination, ValueRange* range, unsigned int seed,
+	TaskTrace* trace, ExecutionStats* stats, ExecutionControl* control)
+{
+	// Everything this execution writes is in its own state. The commands
+	// themselves are not changed.
+	ExecutionState& state = *AcquireState();
+	// Memory which the arenas of the state got from the OS so far.
+	auto getAllocatedBytes = [&]()
 	{
-		float minHeight = std::numeric_limits<float>::max();
-		float maxHeight = std::numeric_limits<float>::min();
-		for(int i=0; i< resolutionX*resolutionY; ++i)
+		size_t allocated = state.Arena.GetAllocatedBytes();
+		for(int i=0; i<_numCommands; ++i)
+			allocated += state.NodeArenas[i].GetAllocatedBytes();
+		return allocated;
+	};
+	size_t allocatedBefore = getAllocatedBytes();
+	state.Memory.ResetPeak();
+	state.Arena.Begin();
+	state.Results[_numCommands-1] = finalDestination;
+	if(stats)
+		stats->ExecuteBeginMs = trace->GetTime();
+
+	std::vector<char> roles;
+	GetExecuteRoles(roles);
+	ExecuteStatus status;
+	try {
+		status = RunPlan(state, bufferInfo, roles, seed, 1.0f, range, trace, stats, control);
+	} catch(...) {
+		// Exceptions of the kernels (e.g. std::bad_alloc) are passed on,
+		// but the state stays usable.
+		state.Arena.Release(0);
+		ReleaseState(&state);
+		throw;
+	}
+
+	if(stats)
+	{
+		stats->ExecuteEndMs = trace->GetTime();
+		stats->WorkspaceBytes = state.Plan.Size;
+		stats->AllocatedBytes = getAllocatedBytes() - allocatedBefore;
+		stats->PeakBytes = state.Memory.GetPeak();
+	}
+	state.Arena.Release(0);
+	// An accidentally large execution must not grow the arena for the
+	// following ones.
+	if(status == ExecuteStatus::CANCELLED)
+		state.Arena.DiscardPeak();
+	if(stats)
+		stats->CurrentBytes = state.Memory.GetCurrent();
+	ReleaseState(&state);
+	return status;
+}
+
+// ************************************************************************* //
+ExecuteStatus GeneratorPipeline::ExecuteBatch(int resolutionX, int resolutionY, const PipelineVariant* variants, int numVariants, bool normalizeData)
+{
+	if(numVariants <= 0 || _numCommands == 0) return ExecuteStatus::OK;
+	ExecuteStatus precomputeStatus = Precompute();
+	if(precomputeStatus != ExecuteStatus::OK)
+		return precomputeStatus;
+
+	MapBufferInfo bufferInfo;
+	FillBufferInfo(bufferInfo, resolutionX, resolutionY);
+	size_t numPixels = size_t(resolutionX) * resolutionY;
+	const int finalNode = _numCommands-1;
+
+	// Split the graph. The seed independent part runs once. Its results
+	// which are read by the seed dependent part are outputs which all
+	// variants share.
+	std::vector<char> sharedRoles(_numCommands, NODE_SKIP);
+	std::vector<char> variantRoles(_numCommands, NODE_SKIP);
+	for(int i=0; i<_numCommands; ++i)
+	{
+		if(!_graph[i].IsRequired) continue;
+		if(_graph[i].IsVariant)
 		{
-			minHeight = std::min(finalDestination[i], minHeight);
-			maxHeight = std::max(finalDestination[i], maxHeight);
+			variantRoles[i] = i == finalNode ? NODE_OUTPUT : NODE_RUN;
+			continue;
 		}
+		bool isShared = i == finalNode;
+		for(size_t r=0; r<_graph[i].Readers.size(); ++r)
+			isShared |= _graph[_graph[i].Readers[r]].IsVariant;
+		sharedRoles[i] = isShared ? NODE_OUTPUT : NODE_RUN;
+	}
 
-		minHeight -= 0.001f;
-		maxHeight += 0.001f;
-		float rangeInv = 1.0f / (maxHeight-minHeight);
+	ExecutionState& shared = *AcquireState();
+	shared.Arena.Begin();
+	ExecuteStatus status = ExecuteStatus::OK;
+	for(int i=0; i<_numCommands; ++i)
+		if(sharedRoles[i] == NODE_OUTPUT)
+		{
+			shared.Results[i] = i == finalNode ? variants[0].Destination : shared.Arena.Allocate<float>(numPixels);
+			if(!shared.Results[i]) status = ExecuteStatus::OUT_OF_MEMORY;
+		}
+	ValueRange sharedRange;
+	try {
+		if(status == ExecuteStatus::OK)
+			status = RunPlan(shared, bufferInfo, sharedRoles, 0, 1.0f, &sharedRange);
+	} catch(...) {
+		shared.Arena.Release(0);
+		ReleaseState(&shared);
+		throw;
+	}
+
+	// Without the shared results no variant can run.
+	if(status == ExecuteStatus::OK && !_graph[finalNode].IsVariant)
+	{
+		// Nothing depends on the seed -> all variants are equal.
+		if(normalizeData)
+			Normalize(variants[0].Destination, resolutionX, resolutionY, sharedRange);
+		for(int v=1; v<numVariants; ++v)
+			memcpy(variants[v].Destination, variants[0].Destination, numPixels * sizeof(float));
+	} else if(status == ExecuteStatus::OK) {
+		// At most one worker per pool thread, each with its own state. The
+		// workers take the next variant until all are done, so the number
+		// of states does not grow with the number of variants.
+		ThreadPool& pool = ThreadPool::Get();
+		TaskGroup group;
+		std::mutex statusLock;
+		std::atomic<int> nextVariant(0);
+		int numWorkers = std::min(numVariants, pool.GetNumThreads());
+		for(int w=0; w<numWorkers; ++w)
+			pool.Submit(group, [&]()
+			{
+				ExecutionState& state = *AcquireState();
+				for(int v = nextVariant++; v < numVariants; v = nextVariant++)
+				{
+					state.Arena.Begin();
+					for(int i=0; i<_numCommands; ++i)
+						if(sharedRoles[i] == NODE_OUTPUT)
+							state.Results[i] = shared.Results[i];
+					state.Results[finalNode] = variants[v].Destination;
+					ValueRange range;
+					ExecuteStatus variantStatus;
+					try {
+						variantStatus = RunPlan(state, bufferInfo, variantRoles, variants[v].Seed, variants[v].HeightScale, normalizeData ? &range : nullptr);
+					} catch(...) {
+						// The pool passes the exception to the Wait below.
+						nextVariant = numVariants;
+						state.Arena.Release(0);
+						ReleaseState(&state);
+						throw;
+					}
+					state.Arena.Release(0);
+
+					if(variantStatus != ExecuteStatus::OK)
+					{
+						// The remaining variants would fail as well.
+						nextVariant = numVariants;
+						std::lock_guard<std::mutex> lock(statusLock);
+						status = variantStatus;
+					} else if(normalizeData)
+						Normalize(variants[v].Destination, resolutionX, resolutionY, range);
+				}
+				ReleaseState(&state);
+			});
+		try {
+			pool.Wait(group);
+		} catch(...) {
+			shared.Arena.Release(0);
+			ReleaseState(&shared);
+			throw;
+		}
+	}
 
-		GenerateLayer(CommandDesc(bufferInfo, nullptr, finalDestination,
-			[=](const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult){
-				return (currentResult[x+y*bufferInfo.ResolutionX] - minHeight)*rangeInv;},
-			finalDestination));
-		//Normalize(finalDestination, resolutionX, resolutionY, minHeight, maxHeight);
+	shared.Arena.Release(0);
+	ReleaseState(&shared);
+	return status;
+}
+
+// ************************************************************************* //
+ExecuteStatus GeneratorPipeline::RunPlan(ExecutionState& state, const MapBufferInfo& bufferInfo, const std::vector<char>& roles,
+	unsigned int seed, float heightScale, ValueRange* outputRange, TaskTrace* trace, ExecutionStats* stats,
+	ExecutionControl* control)
+{
+	// The plan assigns the results and scratch memory to physical buffers.
+	// It only changes with the resolution or roles. The arena keeps its
+	// memory from the last call.
+	if(state.Plan.ResolutionX != (int)bufferInfo.ResolutionX || state.Plan.ResolutionY != (int)bufferInfo.ResolutionY
+		|| state.Plan.SampleStride != bufferInfo.SampleStride || state.Plan.Roles != roles)
+		PlanBuffers(bufferInfo, roles, state.Plan);
+	const BufferPlan& plan = state.Plan;
+
+	ArenaScope scope(state.Arena);
+	char* workspace = (char*)state.Arena.Allocate(plan.Size);
+	// Fail before anything is computed. Scratch memory beyond the plan is
+	// small and only counted.
+	if(!workspace && plan.Size > 0)
+		return ExecuteStatus::OUT_OF_MEMORY;
+	// Value bounds per tile of each result. Results from another state
+	// (ExecuteBatch) have unknown bounds.
+	TileBounds tileGrid;
+	tileGrid.SetSize(bufferInfo);
+	size_t numTiles = tileGrid.GetNumTiles();
+	ValueRange* tileMemory = state.Arena.Allocate<ValueRange>(numTiles * _numCommands);
+	if(!tileMemory && numTiles > 0)
+		return ExecuteStatus::OUT_OF_MEMORY;
+	for(int i=0; i<_numCommands; ++i)
+	{
+		state.Bounds[i] = tileGrid;
+		int resultSlot = plan.ResultSlot[i];
+		int scratchSlot = plan.ScratchSlot[i];
+		if(roles[i] == NODE_RUN)
+			state.Results[i] = resultSlot >= 0 ? (float*)(workspace + plan.SlotOffsets[resultSlot]) : nullptr;
+		state.NodeArenas[i].SetWorkspace(scratchSlot >= 0 ? workspace + plan.SlotOffsets[scratchSlot] : nullptr, plan.ScratchSize[i]);
+		state.PendingInputs[i] = plan.NumDependencies[i];
 	}
+	if(stats)
+	{
+		// Each running command only writes its own entry.
+		stats->Commands.assign(_numCommands, CommandStats());
+		for(int i=0; i<_numCommands; ++i)
+		{
+			stats->Commands[i].Name = _commandNames[i];
+			stats->Commands[i].IsExecuted = roles[i] != NODE_SKIP;
+			stats->Commands[i].ResultBytes = roles[i] == NODE_SKIP ? 0 :
+				size_t(bufferInfo.GetSamplesX()) * bufferInfo.GetSamplesY() * plan.ResultStorage[i].ElementSize();
+			stats->Commands[i].PrecomputedBytes = _states->CommandMemory[i]->GetCurrent();
+		}
+	}
+	TaskControl* taskControl = control ? &control->_state->Tasks : nullptr;
+	if(control)
+	{
+		std::vector<int> numPasses(_numCommands, 0);
+		for(int i=0; i<_numCommands; ++i)
+			if(roles[i] != NODE_SKIP)
+				numPasses[i] = max(1, _commands[i]->GetNumPasses());
+		control->_state->Begin(numPasses);
+		ExecutionControl::State* progress = control->_state;
+		taskControl->OnBlockFinished = [progress](int tag, float fraction){ progress->AddWork(tag, fraction); };
+	}
+
+	// Each command is a task of the pool. When it is finished all commands
+	// which waited for it only are started.
+	ThreadPool& pool = ThreadPool::Get();
+	TaskGroup group;
+	std::mutex scheduleLock;
+	std::function<void(int)> executeNode = [&](int i)
+	{
+		const GraphNode& node = _graph[i];
+		ExecutionContext context;
+		context.OutputRange = i == _numCommands-1 ? outputRange : nullptr;
+		context.Arena = &state.NodeArenas[i];
+		for(int j=0; j<2; ++j)
+			if(node.Inputs[j] >= 0)
+				context.InputStorage[j] = plan.ResultStorage[node.Inputs[j]];
+		context.OutputStorage = plan.ResultStorage[i];
+		context.Seed = seed;
+		context.HeightScale = heightScale;
+		state.NodeArenas[i].Begin();
+		double begin = 0.0;
+		// Everything the command submits is attributed to it.
+		if(stats || control)
+			ThreadPool::SetTaskTag(i);
+		if(stats)
+			begin = trace->GetTime();
+		// After a cancellation the remaining commands are skipped. Their
+		// dependents are still scheduled to finish the group.
+		if(!taskControl || !taskControl->IsCancelled.load(std::memory_order_relaxed))
+		{
+			const float* inputs[2];
+			for(int j=0; j<2; ++j)
+			{
+				inputs[j] = node.Inputs[j] >= 0 ? state.Results[node.Inputs[j]] : nullptr;
+				if(node.Inputs[j] >= 0 && state.Bounds[node.Inputs[j]].Tiles)
+					context.InputBounds[j] = &state.Bounds[node.Inputs[j]];
+			}
+			// The inputs are finished, so their bounds are complete.
+			TileBounds& bounds = state.Bounds[i];
+			bounds.Tiles = tileMemory + numTiles * i;
+			if(_commands[i]->ComputeBounds(bufferInfo, inputs[0], inputs[1], context, bounds))
+			{
+				bounds.Quantize(plan.ResultStorage[i]);
+				context.OutputBounds = &bounds;
+			} else
+				bounds.Tiles = nullptr;
+			if(stats && bounds.Tiles)
+			{
+				stats->Commands[i].NumTiles = bounds.GetNumTiles();
+				for(int t=0; t<bounds.GetNumTiles(); ++t)
+					stats->Commands[i].ConstantTiles += bounds.Tiles[t].IsConstant() ? 1 : 0;
+			}
+
+			_commands[i]->Execute(bufferInfo, inputs[0], inputs[1], state.Results[i], context);
+			if(control)
+				control->_state->FinishCommand(i);
+		}
+		if(stats)
+		{
+			CommandStats& commandStats = stats->Commands[i];
+			commandStats.Thread = ThreadPool::GetThreadIndex();
+			commandStats.BeginMs = begin;
+			commandStats.EndMs = trace->GetTime();
+			commandStats.ScratchBytes = state.NodeArenas[i].GetPeakUsage();
+		}
+
+		std::lock_guard<std::mutex> lock(scheduleLock);
+		const std::vector<int>& dependents = plan.Dependents[i];
+		for(size_t d=0; d<dependents.size(); ++d)
+		{
+			int dependent = dependents[d];
+			if(--state.PendingInputs[dependent] == 0)
+				pool.Submit(group, [&executeNode, dependent](){ executeNode(dependent); });
+		}
+	};
+	// Tasks inherit the trace of the thread which submits them.
+	TaskTrace* outerTrace = trace ? ThreadPool::SetTrace(trace) : nullptr;
+	TaskControl* outerControl = control ? ThreadPool::SetControl(taskControl) : nullptr;
+	for(int i=0; i<_numCommands; ++i)
+		if(roles[i] != NODE_SKIP && plan.NumDependencies[i] == 0)
+			pool.Submit(group, [&executeNode, i](){ executeNode(i); });
+	pool.Wait(group);
+	if(control) ThreadPool::SetControl(outerControl);
+	if(trace) ThreadPool::SetTrace(outerTrace);
+
+	for(int i=0; i<_numCommands; ++i)
+		state.NodeArenas[i].Release(0);
+	if(taskControl && taskControl->IsCancelled.load())
+		return ExecuteStatus::CANCELLED;
+	return ExecuteStatus::OK;
+}
+
+// ************************************************************************* //
+void GeneratorPipeline::Normalize(float* data, int resolutionX, int resolutionY, ValueRange range) const
+{
+	// Commands which do not write each pixel through a kernel cannot report
+	// their range. Use a separate parallel reduction in that case.
+	if( range.IsEmpty() )
+	{
+		std::mutex rangeLock;
+		GenerateLines(resolutionY, [&](int y, int numLines){
+			ValueRange linesRange;
+			const float* lines = data + y * resolutionX;
+			for(int i=0; i<numLines*resolutionX; ++i)
+				linesRange.Add(lines[i]);
+			std::lock_guard<std::mutex> lock(rangeLock);
+			range.Merge(linesRange);
+		});
+	}
+
+	float minHeight = range.Min - 0.001f;
+	float maxHeight = range.Max + 0.001f;
+	float rangeInv = 1.0f / (maxHeight-minHeight);
+
+	// Single fused pass which scales all lines in place.
+	GenerateLines(resolutionY, [=](int y, int numLines){
+		float* lines = data + y * resolutionX;
+		for(int i=0; i<numLines*resolutionX; ++i)
+			lines[i] = (lines[i] - minHeight) * rangeInv;
+	});
 }
\ No newline at end of file
@@ -1,14 +1,16 @@
 #pragma once
 
 #include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "Storage.h"
 
 // Predeclartations
-namespace OrE {
-	namespace ADT {
-		class Mesh;
-	};
-};
 struct Vec3;
+class BufferArena;
+class PointSet;
+struct SpanningTree;
 
 enum struct CommandType
 {
@@ -26,6 +28,7 @@ enum struct CommandType
 
 	SMOOTH = 100,
 	NORMALIZE = 101,
+	EROSION = 102,
 
 	NONE = 9999
 };
@@ -48,6 +51,139 @@ struct MapBufferInfo
 
 	float HeightmapPixelPerWorldUnit;	///< Determines the resolution / sampling rate of the map section.
 	float PixelSize;	///< WorldSize../HeightmapPixelPerWorldUnit
+
+	/// The buffers only contain every SampleStride-th pixel of the map in
+	///	both directions: entry (x,y) is pixel (x,y)*SampleStride. Only
+	///	pointwise commands support a stride other than 1.
+	int SampleStride;
+	/// The destination of the final command already contains the samples
+	///	with even buffer coordinates (from a pass with twice the stride).
+	///	They are not computed again.
+	bool HasEvenSamples;
+
+	/// Size of the buffers in row and column direction.
+	unsigned int GetSamplesX() const	{ return (ResolutionX + SampleStride - 1) / SampleStride; }
+	unsigned int GetSamplesY() const	{ return (ResolutionY + SampleStride - 1) / SampleStride; }
+};
+
+/// \brief Minimum and maximum of a map.
+/// \details Default constructed ranges are empty (Min > Max).
+struct ValueRange
+{
+	float Min;
+	float Max;
+
+	ValueRange() : Min(std::numeric_limits<float>::max()), Max(std::numeric_limits<float>::lowest()) {}
+
+	bool IsEmpty() const				{ return Min > Max; }
+	bool IsConstant() const				{ return Min == Max; }
+	void Add( float value )				{ Min = value < Min ? value : Min; Max = value > Max ? value : Max; }
+	void Merge( const ValueRange& r )	{ Min = r.Min < Min ? r.Min : Min; Max = r.Max > Max ? r.Max : Max; }
+};
+
+/// Size of the tiles in samples for which value bounds are tracked. A
+/// multiple of the cells of GenerateLayerAdaptive.
+const int BOUNDS_TILE_SIZE = 32;
+
+/// \brief Conservative value range of each tile of a map.
+/// \details The tiles have BOUNDS_TILE_SIZE^2 samples, the last ones in
+///		each direction may be smaller. A tile with Min == Max is proven to
+///		be constant (up to the sign of zero) and is filled by GenerateLayer
+///		without calling the kernel.
+struct TileBounds
+{
+	int NumTilesX;
+	int NumTilesY;
+	ValueRange* Tiles;		///< Rowwise, nullptr if the bounds are unknown.
+
+	TileBounds() : NumTilesX(0), NumTilesY(0), Tiles(nullptr) {}
+
+	int GetNumTiles() const	{ return NumTilesX * NumTilesY; }
+	const ValueRange& Get( int tileX, int tileY ) const	{ return Tiles[tileY * NumTilesX + tileX]; }
+
+	/// \brief Use a tile grid which covers the samples of the buffer.
+	void SetSize( const MapBufferInfo& bufferInfo );
+
+	/// \brief World space coordinates of the first and the last sample of
+	///		a tile: [minX, minY, maxX, maxY].
+	static void GetWorldRect( const MapBufferInfo& bufferInfo, int tileX, int tileY, float* rect );
+
+	/// \brief Round the bounds like the values which are stored in a buffer
+	///		with this format.
+	void Quantize( const StorageDesc& storage );
+
+	/// \brief Range of all finite values.
+	static ValueRange Unbounded();
+
+	/// \brief Enlarge a range by a few ulps to cover rounding errors.
+	static void Widen( ValueRange& range );
+
+	/// \brief Bounds of f(a,b) for all a and b in the two ranges if f is
+	///		affine in each argument (e.g. +, * or lrp).
+	/// \details The extremes are at the corners. The result is widened, so
+	///		it is never constant.
+	template<typename Function>
+	static ValueRange Bilinear( const ValueRange& a, const ValueRange& b, Function f )
+	{
+		float corners[4] = { f(a.Min, b.Min), f(a.Min, b.Max), f(a.Max, b.Min), f(a.Max, b.Max) };
+		ValueRange range;
+		for( int i=0; i<4; ++i )
+		{
+			// 0 * inf
+			if( corners[i] != corners[i] ) return Unbounded();
+			range.Add( corners[i] );
+		}
+		Widen( range );
+		return range;
+	}
+};
+
+/// \brief Additional in- and outputs of a single Command::Execute call.
+struct ExecutionContext
+{
+	/// If not nullptr the command reports the value range of everything it
+	///	writes to the destination. The pipeline requests this for the last
+	///	command to normalize the results without another scan.
+	ValueRange* OutputRange;
+
+	/// Memory for temporary buffers of the command. Allocations must be
+	///	released before Execute returns (see ArenaScope).
+	BufferArena* Arena;
+
+	/// Formats of prevResult, currentResult and the destination. Other
+	///	formats than FLOAT are only used for pointwise commands (IsPointwise)
+	///	which access their buffers through GenerateLayer.
+	StorageDesc InputStorage[2];
+	StorageDesc OutputStorage;
+
+	/// Seed of all noise functions. Commands must not store anything which
+	///	depends on the execution in themselves - a pipeline may run several
+	///	executions concurrently.
+	unsigned int Seed;
+	/// Factor for the height of commands which use the seed. The result
+	///	must be the same as with a script where their height is scaled.
+	float HeightScale;
+
+	/// Bounds of prevResult and currentResult per tile or nullptr if they
+	///	are unknown.
+	const TileBounds* InputBounds[2];
+	/// The bounds from Command::ComputeBounds (rounded to the output
+	///	storage) or nullptr.
+	const TileBounds* OutputBounds;
+
+	ExecutionContext() : OutputRange(nullptr), Arena(nullptr), Seed(0), HeightScale(1.0f), OutputBounds(nullptr)
+	{
+		InputBounds[0] = InputBounds[1] = nullptr;
+	}
+};
+
+/// Bit flags for the results of former commands which a command reads.
+enum CommandInputs
+{
+	INPUT_NONE = 0,
+	INPUT_PREV = 1,			///< prevResult is used
+	INPUT_CURRENT = 2,		///< currentResult is used
+	INPUT_ALL = INPUT_PREV | INPUT_CURRENT
 };
 
 /// Base class for any generator command. The derivatives store all information
@@ -70,10 +206,72 @@ public:
 	/// \param [in] currentResult Read access to the result from the last command.
 	///		Depending on the command this must be defined or can be nullptr.
 	/// \param [out] output Buffer to write the new results into.
+	/// \param [inout] context Per call options and side outputs.
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) = 0;
+						  float* destination,
+						  const ExecutionContext& context ) = 0;
+
+	/// \brief Conservative bounds of the result per tile.
+	/// \details Called before Execute with the same inputs. The bounds of the
+	///		inputs are in context.InputBounds. Execute does not call the
+	///		kernel for tiles which are proven constant.
+	/// \param [inout] bounds Tile grid of the result to fill.
+	/// \return false if nothing is known about the result.
+	virtual bool ComputeBounds( const MapBufferInfo& bufferInfo,
+								const float* prevResult,
+								const float* currentResult,
+								const ExecutionContext& context,
+								TileBounds& bounds ) const	{ return false; }
+
+	/// \brief Number of bytes the command takes from context.Arena during
+	///		Execute. This is used to compute the workspace of a pipeline.
+	virtual size_t GetScratchSize( const MapBufferInfo& bufferInfo ) const	{ return 0; }
+
+	/// \brief Which of the former results are read (CommandInputs flags).
+	///		The pipeline passes nullptr for unused inputs and executes
+	///		commands without a dependency concurrently.
+	virtual int GetInputs() const	{ return INPUT_ALL; }
+
+	/// \brief True if each output pixel only depends on the same pixel of
+	///		the inputs and all buffers are accessed through GenerateLayer.
+	///		Then the destination may be one of the inputs and the buffers
+	///		may have a reduced precision.
+	virtual bool IsPointwise() const	{ return false; }
+
+	/// \brief True if the result depends on ExecutionContext::Seed.
+	///		Only these commands (and everything after them) are executed
+	///		per variant in GeneratorPipeline::ExecuteBatch.
+	virtual bool UsesSeed() const	{ return false; }
+
+	/// \brief Build data which does not depend on the resolution (e.g. a
+	///		MST). Called once before the first Execute.
+	virtual void Precompute()	{}
+
+	/// \brief Append the result of Precompute to a snapshot.
+	/// \return false if the command has no precomputed data.
+	virtual bool SavePrecomputed( std::vector<char>& data ) const	{ return false; }
+
+	/// \brief Use the data of SavePrecomputed from a snapshot instead of
+	///		calling Precompute.
+	/// \param [in] data 16 byte aligned memory which is valid as long as the
+	///		command exists (a mapped snapshot file).
+	/// \return false if the data is invalid. Then Precompute is called.
+	virtual bool LoadPrecomputed( const void* data, size_t size )	{ return false; }
+
+	/// \brief Bytes of heap memory the precomputed data occupies (data
+	///		which is used from a mapped snapshot does not count).
+	virtual size_t GetPrecomputedSize() const	{ return 0; }
+
+	/// \brief Upper estimate of the heap memory Precompute needs including
+	///		its temporary data. It is reserved against the memory limits
+	///		before Precompute is called.
+	virtual size_t GetPrecomputeEstimate() const	{ return 0; }
+
+	/// \brief Number of GenerateLines calls in one Execute. Only used to
+	///		estimate the progress of an execution.
+	virtual int GetNumPasses() const	{ return 1; }
 
 	virtual ~Command() {}
 };
@@ -88,11 +286,10 @@ class CmdValueNoise : public Command
 	float _heightDependency;		///< Frequence dependency to the previous height + height of smaller frequencies.
 	float _heightDependencyOffset;	///< A threshold [0,_heightScale] to control the height dependency.
 
-	float CalculateFrequenceAmplitude( const MapBufferInfo& bufferDesc, float _fCurrentHeight, float _fFrequence, float _fGradientX, float _fGradientY );
-	float NoiseKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
-
-	// Precomputed values
-	int _maxOctave;
+	float CalculateFrequenceAmplitude( const MapBufferInfo& bufferDesc, float _fCurrentHeight, float _fFrequence, float _fGradientX, float _fGradientY, float _fHeightScale );
+	/// \param [in] maxOctave Number of octaves (depends on the resolution).
+	/// \param [in] heightScale ExecutionContext::HeightScale
+	float NoiseKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult, int maxOctave, unsigned int seed, float heightScale );
 public:
 	CmdValueNoise( float heightScale,
 				   float gradientDependency,
@@ -110,15 +307,20 @@ public:
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual int GetInputs() const override	{ return INPUT_CURRENT; }
+	virtual bool IsPointwise() const override	{ return true; }
+	virtual bool UsesSeed() const override	{ return true; }
 };
 
 /// This commando adds the two prior results.
 ///
 class CmdBlendAdd : public Command
 {
-	float BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
-	float BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
+	float BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult );
+	float BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult );
 
 public:
 	CmdBlendAdd() : Command(CommandType::ADD) {}
@@ -129,15 +331,24 @@ public:
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual bool ComputeBounds( const MapBufferInfo& bufferInfo,
+								const float* prevResult,
+								const float* currentResult,
+								const ExecutionContext& context,
+								TileBounds& bounds ) const override;
+
+	virtual bool IsPointwise() const override	{ return true; }
 };
 
 /// This commando multiplies the two prior results.
 ///
 class CmdBlendMultiply : public Command
 {
-	float BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
-	float BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
+	float BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult );
+	float BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult );
 
 public:
 	CmdBlendMultiply() : Command(CommandType::MULTIPLY) {}
@@ -148,7 +359,16 @@ public:
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual bool ComputeBounds( const MapBufferInfo& bufferInfo,
+								const float* prevResult,
+								const float* currentResult,
+								const ExecutionContext& context,
+								TileBounds& bounds ) const override;
+
+	virtual bool IsPointwise() const override	{ return true; }
 };
 
 /// This commando multiplies overwrites the old result, rendering all previous results useless
@@ -164,15 +384,24 @@ public:
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual bool ComputeBounds( const MapBufferInfo& bufferInfo,
+								const float* prevResult,
+								const float* currentResult,
+								const ExecutionContext& context,
+								TileBounds& bounds ) const override;
+
+	virtual bool IsPointwise() const override	{ return true; }
 };
 
 /// The current result is interpreted as perfect refractive surface and the
 /// previous result is distroted.
 class CmdBlendRefract : public Command
 {
-	float BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
-	float BlendKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
+	float BlendKernelNeutral( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult );
+	ValueRange BlendLines( const MapBufferInfo& bufferInfo, int y, int numLines, const float* prevResult, const float* currentResult, float* destination );
 
 	float _refractionDistance;	///< Defines a distance between the two surfaces.
 public:
@@ -187,7 +416,8 @@ public:
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
 };
 
 
@@ -195,20 +425,39 @@ public:
 /// spanning tree.
 class CmdInvMSTDistance : public Command
 {
-	float GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
+	float GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult );
 
-	OrE::ADT::Mesh* _mst;
+	std::shared_ptr<const PointSet> _points;
+	SpanningTree* _mst;				///< The MST of _points after Precompute.
 	float _height;					///< Maximum height/distance of the ridges and summits.
 	float _quadraticSplineHeight;	///< Below this height a spline is used to make fade more smooth
+	float _tolerance;				///< Error of the adaptive sampling (GenerateLayerAdaptive). 0 computes every pixel.
 public:
-	CmdInvMSTDistance(const Vec3* pointList, int numPoints, float height, float quadraticSplineHeight);
+	CmdInvMSTDistance(std::shared_ptr<const PointSet> points, float height, float quadraticSplineHeight, float tolerance);
 
 	/// Compute a distance map as new layer.
 	/// \details The former results are ignored.
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual bool ComputeBounds( const MapBufferInfo& bufferInfo,
+								const float* prevResult,
+								const float* currentResult,
+								const ExecutionContext& context,
+								TileBounds& bounds ) const override;
+
+	virtual int GetInputs() const override	{ return INPUT_NONE; }
+	/// Adaptive sampling interpolates between neighbouring samples.
+	virtual bool IsPointwise() const override	{ return _tolerance == 0.0f; }
+
+	virtual void Precompute() override;
+	virtual bool SavePrecomputed( std::vector<char>& data ) const override;
+	virtual bool LoadPrecomputed( const void* data, size_t size ) override;
+	virtual size_t GetPrecomputedSize() const override;
+	virtual size_t GetPrecomputeEstimate() const override;
 
 	virtual ~CmdInvMSTDistance();
 };
@@ -217,20 +466,39 @@ public:
 ///
 class CmdMSTDistance : public Command
 {
-	float GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
+	float GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult );
 
-	OrE::ADT::Mesh* _mst;
+	std::shared_ptr<const PointSet> _points;
+	SpanningTree* _mst;				///< The MST of _points after Precompute.
 	float _height;					///< Maximum height/distance of the ridges and summits.
 	float _quadraticSplineHeight;	///< Below this height a spline is used to make fade more smooth
+	float _tolerance;				///< Error of the adaptive sampling (GenerateLayerAdaptive). 0 computes every pixel.
 public:
-	CmdMSTDistance(const Vec3* pointList, int numPoints, float height, float quadraticSplineHeight);
+	CmdMSTDistance(std::shared_ptr<const PointSet> points, float height, float quadraticSplineHeight, float tolerance);
 
 	/// Compute a distance map as new layer.
 	/// \details The former results are ignored.
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual bool ComputeBounds( const MapBufferInfo& bufferInfo,
+								const float* prevResult,
+								const float* currentResult,
+								const ExecutionContext& context,
+								TileBounds& bounds ) const override;
+
+	virtual int GetInputs() const override	{ return INPUT_NONE; }
+	/// Adaptive sampling interpolates between neighbouring samples.
+	virtual bool IsPointwise() const override	{ return _tolerance == 0.0f; }
+
+	virtual void Precompute() override;
+	virtual bool SavePrecomputed( std::vector<char>& data ) const override;
+	virtual bool LoadPrecomputed( const void* data, size_t size ) override;
+	virtual size_t GetPrecomputedSize() const override;
+	virtual size_t GetPrecomputeEstimate() const override;
 
 	virtual ~CmdMSTDistance();
 };
@@ -240,21 +508,24 @@ public:
 ///
 class CmdWorly : public Command
 {
-	float GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
+	float GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult );
 
-	Vec3* _points;			///< All points which show cells (copy). The height (z-coordinate) defines a distance offset.
+	std::shared_ptr<const PointSet> _points;	///< All points which show cells (shared). The height (z-coordinate scaled by _height) defines a distance offset.
 	float _height;			///< Maximum height/distance scaling factor.
-	int _numPoints;			///< Size of the given point set
 	int _nthNeighbor;		///< Only the distance to the nth-neighbor is used. The counting starts at 0 (closest point).
 public:
-	CmdWorly(const Vec3* pointList, int numPoints, int nthNeighbor, float height);
+	CmdWorly(std::shared_ptr<const PointSet> points, int nthNeighbor, float height);
 
 	/// Compute a distance map as new layer.
 	/// \details The former results are ignored.
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual int GetInputs() const override	{ return INPUT_NONE; }
+	virtual bool IsPointwise() const override	{ return true; }
 
 	virtual ~CmdWorly();
 };
@@ -264,20 +535,23 @@ public:
 ///
 class CmdVoronoi : public Command
 {
-	float GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
+	float GeneratorKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult );
 
-	Vec3* _points;			///< All points which show cells (copy). The height (z-coordinate) defines a distance offset.
+	std::shared_ptr<const PointSet> _points;	///< All points which show cells (shared). The height (z-coordinate scaled by _height) defines a distance offset.
 	float _height;			///< Maximum height/distance scaling factor.
-	int _numPoints;			///< Size of the given point set
 public:
-	CmdVoronoi(const Vec3* pointList, int numPoints, float height);
+	CmdVoronoi(std::shared_ptr<const PointSet> points, float height);
 
 	/// Compute a distance map as new layer.
 	/// \details The former results are ignored.
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual int GetInputs() const override	{ return INPUT_NONE; }
+	virtual bool IsPointwise() const override	{ return true; }
 
 	virtual ~CmdVoronoi();
 };
@@ -289,10 +563,9 @@ class CmdVoronoise : public Command
 	float _heightScale;				///< Amplitude of the noise (all heights in [0,_heightScale]).
 	int _minOctave;					///< Determines largest frequency
 	int _maxOctave;					///< Determines smallest frequency _maxOctave >= _minOctave
-	float _noiseScaleX;				///< Precomputed scale for the coordinates to frequency
-	float _noiseScaleY;				///< Precomputed scale for the coordinates to frequency
 
-	float NoiseKernel( const MapBufferInfo& bufferInfo, int x, int y, const float* prevResult, const float* currentResult );
+	/// \param [in] noiseScaleX Scale for the coordinates to frequency (depends on the resolution).
+	float NoiseKernel( const MapBufferInfo& bufferInfo, int x, int y, float prevResult, float currentResult, float noiseScaleX, float noiseScaleY, unsigned int seed );
 public:
 	CmdVoronoise( float heightScale,
 				  int minOctave,
@@ -308,42 +581,161 @@ public:
 	virtual void Execute( const MapBufferInfo& bufferInfo,
 						  const float* prevResult,
 						  const float* currentResult,
-						  float* destination ) override;
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual int GetInputs() const override	{ return INPUT_NONE; }
+	virtual bool IsPointwise() const override	{ return true; }
+	virtual bool UsesSeed() const override	{ return true; }
 };
 
+/// Smoothing filter which approximates a gaussian by iterated box filters.
+/// \details Each box filter is separated into a vertical pass and a
+///		transposed vertical pass, so the cost per pixel does not depend on
+///		the radius.
+class CmdSmooth : public Command
+{
+	float _radius;			///< Radius of one box filter in world units.
+	int _iterations;		///< Number of box filters. 3 is close to a gaussian.
+public:
+	CmdSmooth( float radius, int iterations ) :
+		Command(CommandType::SMOOTH),
+		_radius(radius),
+		_iterations(iterations)
+	{}
+
+	/// Filter the last result.
+	/// \details `prevResult` will be ignored.
+	virtual void Execute( const MapBufferInfo& bufferInfo,
+						  const float* prevResult,
+						  const float* currentResult,
+						  float* destination,
+						  const ExecutionContext& context ) override;
 
-typedef std::function<float(const MapBufferInfo&,int,int,const float*,const float*)> Kernel_t;
+	virtual int GetInputs() const override	{ return INPUT_CURRENT; }
+
+	virtual size_t GetScratchSize( const MapBufferInfo& bufferInfo ) const override;
+
+	/// Filters of both directions and two transpositions.
+	virtual int GetNumPasses() const override	{ return 2 * _iterations + 2; }
+};
+
+/// Hydraulic (virtual pipe model) and thermal erosion of the last result.
+/// \details The simulation is a cellular automaton on several planes
+///		(terrain, water, sediment, flux). Each iteration consists of three
+///		parallel steps which only read the neighborhood from the last step.
+class CmdErosion : public Command
+{
+public:
+	struct Parameters
+	{
+		int Iterations;			///< Number of simulation steps.
+		float Rain;				///< Water added to each cell per iteration.
+		float Evaporation;		///< Relative amount of water which evaporates per iteration [0,1].
+		float Capacity;			///< Sediment capacity scale of the flowing water.
+		float Dissolving;		///< Rate [0,1] with which terrain is dissolved if below the capacity.
+		float Deposition;		///< Rate [0,1] with which sediment is deposited if above the capacity.
+		float Talus;			///< Slope (height per world unit) from which on material slides down.
+		float ThermalRate;		///< Amount [0,1] of the material above the talus slope which slides per iteration.
+	};
+
+private:
+	Parameters _params;
+public:
+	CmdErosion( const Parameters& params ) :
+		Command(CommandType::EROSION),
+		_params(params)
+	{}
+
+	/// Erode the last result.
+	/// \details `prevResult` will be ignored.
+	virtual void Execute( const MapBufferInfo& bufferInfo,
+						  const float* prevResult,
+						  const float* currentResult,
+						  float* destination,
+						  const ExecutionContext& context ) override;
+
+	virtual int GetInputs() const override	{ return INPUT_CURRENT; }
+
+	virtual size_t GetScratchSize( const MapBufferInfo& bufferInfo ) const override;
+
+	/// Flux, water and thermal step per iteration.
+	virtual int GetNumPasses() const override	{ return 3 * _params.Iterations; }
+};
+
+
+/// Per pixel kernel: (buffer info, x, y, prevResult at x/y, currentResult at x/y).
+///	Unused inputs are 0.
+typedef std::function<float(const MapBufferInfo&,int,int,float,float)> Kernel_t;
 
 /// \brief The "closure" for the parallel executation.
 /// \details This struct is filled by Command.Execute and is used as input
-///		for GenerateLayer.
+///		for GenerateLayer. The buffers are in the formats of the execution
+///		context and are converted per line.
 struct CommandDesc
 {
 	const MapBufferInfo& BufferInfo;
-	const float* PrevResult;
-	const float* CurrentResult;
+	const void* PrevResult;
+	const void* CurrentResult;
 	Kernel_t Kernel;
-	float* Destination;
+	void* Destination;
+	ValueRange* Range;		///< Optional output: min/max of all written values.
+	StorageDesc PrevStorage;
+	StorageDesc CurrentStorage;
+	StorageDesc DestinationStorage;
+	const TileBounds* Bounds;	///< Optional: tiles which are proven constant are filled.
 
 	CommandDesc(const MapBufferInfo& bufferInfo, const float* prev, const float* current, 
-				Kernel_t kernel, float* destination) :
+				Kernel_t kernel, float* destination, const ExecutionContext& context) :
 		BufferInfo(bufferInfo),
 		PrevResult(prev),
 		CurrentResult(current),
 		Kernel(kernel),
-		Destination(destination)
+		Destination(destination),
+		Range(context.OutputRange),
+		PrevStorage(context.InputStorage[0]),
+		CurrentStorage(context.InputStorage[1]),
+		DestinationStorage(context.OutputStorage),
+		Bounds(context.OutputBounds)
 	{}
 };
 
 /// \brief Parallel computation of one layer.
 /// \details This method creates as many hardware threads as possible and
-///		calculates the new height per pixel.
+///		calculates the new height per pixel. If commandInfo.Range is given
+///		each thread tracks the min/max of its lines which are merged at the
+///		end.
 void GenerateLayer(const CommandDesc& commandInfo);
 
+/// \brief Parallel adaptive computation of a generator layer.
+/// \details The kernel is evaluated on a quadtree: each cell (starting with
+///		16x16 samples) is compared with a bicubic interpolation of its
+///		neighbourhood at nine test points. Cells with a larger error are
+///		split, the others are interpolated. Smooth parts cost a few samples
+///		per cell, creases (e.g. along MST ridges) are refined down to single
+///		samples. The error is only tested at these points, so features
+///		smaller than a cell may be missed.
+///
+///		Only for kernels without inputs. The result depends on the sampling
+///		grid, so such commands are not pointwise.
+/// \param [in] tolerance Maximum absolute error at the test points.
+void GenerateLayerAdaptive(const CommandDesc& commandInfo, float tolerance);
+
 /// \brief Seqential computation of one layer for testing purposes.
 /// \details This method calculates the new height per pixel.
 void GenerateLayerSeq(const CommandDesc& commandInfo);
 
+/// Kernel which processes a block of whole lines: (first line, number of lines).
+typedef std::function<void(int,int)> LineKernel_t;
+
+/// \brief Parallel execution of a line based kernel.
+/// \details Used by commands which cannot be expressed per pixel (e.g. if
+///		intermediate results per line are shared). The lines are split into
+///		several contiguous blocks per thread of the pool.
+/// \param [in] numLines Total number of lines. Usually ResolutionY.
+/// \param [in] kernel Called once per block.
+void GenerateLines(int numLines, const LineKernel_t& kernel);
+
 /// \brief Apply a list of loaded commandos to a map.
 /// \param [in] commands An array of different command objects
 /// \param [in] numCommands Number of object pointers in the array.
@@ -0,0 +1,226 @@
+#include "Stdafx.h"
+#include "CommandBuffer.hpp"
+#include "BufferArena.hpp"
+
+// ************************************************************************* //
+void GeneratorPipeline::CompileGraph()
+{
+	_graph.resize(_numCommands);
+	for(int i=0; i<_numCommands; ++i)
+	{
+		int inputs = _commands[i]->GetInputs();
+		_graph[i].Inputs[0] = ((inputs & INPUT_PREV) && i >= 2) ? i-2 : -1;
+		_graph[i].Inputs[1] = ((inputs & INPUT_CURRENT) && i >= 1) ? i-1 : -1;
+		_graph[i].IsRequired = false;
+		_graph[i].IsVariant = _commands[i]->UsesSeed();
+		for(int j=0; j<2; ++j)
+			if(_graph[i].Inputs[j] >= 0 && _graph[_graph[i].Inputs[j]].IsVariant)
+				_graph[i].IsVariant = true;
+	}
+
+	// Go backwards from the final result to find all commands which
+	// contribute to it. E.g. a layer without blending overwrites everything
+	// before.
+	if(_numCommands > 0)
+		_graph[_numCommands-1].IsRequired = true;
+	for(int i=_numCommands-1; i>=0; --i)
+		if(_graph[i].IsRequired)
+			for(int j=0; j<2; ++j)
+				if(_graph[i].Inputs[j] >= 0)
+					_graph[_graph[i].Inputs[j]].IsRequired = true;
+
+	for(int i=0; i<_numCommands; ++i)
+	{
+		if(!_graph[i].IsRequired) continue;
+		for(int j=0; j<2; ++j)
+		{
+			int input = _graph[i].Inputs[j];
+			// Both inputs might be the same buffer in future -> count once
+			if(input >= 0 && (j == 0 || input != _graph[i].Inputs[0]))
+				_graph[input].Readers.push_back(i);
+		}
+	}
+}
+
+// ************************************************************************* //
+/// State of one physical buffer during planning.
+struct PlanSlot
+{
+	bool IsFree;
+	std::vector<int> Users;		///< Nodes which access the current content.
+};
+
+// Reuse a free physical buffer (the smallest which is large enough, else
+// the largest which then grows) or create a new one.
+static int AcquireSlot( std::vector<PlanSlot>& slots, std::vector<size_t>& sizes, size_t size )
+{
+	int best = -1;
+	for(int s=0; s<(int)slots.size(); ++s)
+	{
+		if(!slots[s].IsFree) continue;
+		if(best == -1) { best = s; continue; }
+		bool fits = sizes[s] >= size;
+		bool bestFits = sizes[best] >= size;
+		if(fits != bestFits ? fits : (fits ? sizes[s] < sizes[best] : sizes[s] > sizes[best]))
+			best = s;
+	}
+	if(best == -1)
+	{
+		best = (int)slots.size();
+		PlanSlot slot;
+		slot.IsFree = true;
+		slots.push_back(slot);
+		sizes.push_back(0);
+	}
+	slots[best].IsFree = false;
+	sizes[best] = std::max(sizes[best], size);
+	return best;
+}
+
+typedef std::vector<std::vector<int> > Dependents_t;
+
+static void AddDependency( Dependents_t& dependents, std::vector<int>& numDependencies, int from, int to )
+{
+	dependents[from].push_back(to);
+	++numDependencies[to];
+}
+
+// The new content of a slot is written by node writer: it must wait for all
+// users of the old content.
+static void ReuseSlot( PlanSlot& slot, int writer, Dependents_t& dependents, std::vector<int>& numDependencies )
+{
+	for(size_t u=0; u<slot.Users.size(); ++u)
+		if(slot.Users[u] != writer)
+			AddDependency(dependents, numDependencies, slot.Users[u], writer);
+	slot.Users.clear();
+}
+
+void GeneratorPipeline::GetExecuteRoles(std::vector<char>& roles) const
+{
+	roles.resize(_numCommands);
+	for(int i=0; i<_numCommands; ++i)
+		roles[i] = _graph[i].IsRequired ? NODE_RUN : NODE_SKIP;
+	if(_numCommands > 0)
+		roles[_numCommands-1] = NODE_OUTPUT;
+}
+
+void GeneratorPipeline::PlanBuffers(const MapBufferInfo& bufferInfo, const std::vector<char>& roles, BufferPlan& plan) const
+{
+	plan.ResolutionX = bufferInfo.ResolutionX;
+	plan.ResolutionY = bufferInfo.ResolutionY;
+	plan.SampleStride = bufferInfo.SampleStride;
+	plan.Roles = roles;
+	plan.SlotSizes.clear();
+	plan.ResultSlot.assign(_numCommands, -1);
+	plan.ResultStorage.assign(_numCommands, StorageDesc());
+	plan.ScratchSlot.assign(_numCommands, -1);
+	plan.ScratchSize.assign(_numCommands, 0);
+	plan.Dependents.resize(_numCommands);
+	for(int i=0; i<_numCommands; ++i)
+		plan.Dependents[i].clear();
+	plan.NumDependencies.assign(_numCommands, 0);
+
+	// Data dependencies. Skipped nodes are finished before.
+	for(int i=0; i<_numCommands; ++i)
+		if(roles[i] != NODE_SKIP)
+			for(size_t r=0; r<_graph[i].Readers.size(); ++r)
+				if(roles[_graph[i].Readers[r]] != NODE_SKIP)
+					AddDependency(plan.Dependents, plan.NumDependencies, i, _graph[i].Readers[r]);
+
+	// Lifetime of a result: from its command to the last reader
+	std::vector<int> lastUse(_numCommands, -1);
+	for(int i=0; i<_numCommands; ++i)
+		for(size_t r=0; r<_graph[i].Readers.size(); ++r)
+			if(roles[_graph[i].Readers[r]] != NODE_SKIP)
+				lastUse[i] = std::max(lastUse[i], _graph[i].Readers[r]);
+
+	// Reduced precision is only possible if the result is written and read
+	// by pointwise commands which convert the buffers per line. Outputs
+	// are always float.
+	for(int i=0; i<_numCommands; ++i)
+	{
+		if(roles[i] != NODE_RUN || !_commands[i]->IsPointwise()) continue;
+		bool pointwiseReaders = true;
+		for(size_t r=0; r<_graph[i].Readers.size(); ++r)
+			pointwiseReaders &= _commands[_graph[i].Readers[r]]->IsPointwise();
+		if(pointwiseReaders)
+			plan.ResultStorage[i] = _storage[i];
+	}
+
+	size_t numPixels = size_t(bufferInfo.GetSamplesX()) * bufferInfo.GetSamplesY();
+	std::vector<PlanSlot> slots;
+	for(int i=0; i<_numCommands; ++i)
+	{
+		if(roles[i] == NODE_SKIP) continue;
+		const GraphNode& node = _graph[i];
+
+		// In place: a pointwise command overwrites an input which is not
+		// needed afterwards and has the same element size. Outputs are
+		// written to their external buffers.
+		int elementSize = plan.ResultStorage[i].ElementSize();
+		int inPlaceInput = -1;
+		if(roles[i] == NODE_RUN && _commands[i]->IsPointwise())
+			for(int j=1; j>=0; --j)
+				if(node.Inputs[j] >= 0 && plan.ResultSlot[node.Inputs[j]] >= 0 && lastUse[node.Inputs[j]] == i
+					&& plan.ResultStorage[node.Inputs[j]].ElementSize() == elementSize)
+					inPlaceInput = node.Inputs[j];
+
+		// Scratch memory is only alive during the command. It must not be
+		// one of the input buffers which are still occupied here.
+		plan.ScratchSize[i] = _commands[i]->GetScratchSize(bufferInfo);
+		if(plan.ScratchSize[i] > 0)
+		{
+			int s = AcquireSlot(slots, plan.SlotSizes, BufferArena::AlignedSize(plan.ScratchSize[i]));
+			ReuseSlot(slots[s], i, plan.Dependents, plan.NumDependencies);
+			slots[s].Users.push_back(i);
+			plan.ScratchSlot[i] = s;
+		}
+
+		if(inPlaceInput >= 0)
+		{
+			int s = plan.ResultSlot[inPlaceInput];
+			ReuseSlot(slots[s], i, plan.Dependents, plan.NumDependencies);
+			plan.ResultSlot[i] = s;
+		} else if(roles[i] == NODE_RUN) {
+			int s = AcquireSlot(slots, plan.SlotSizes, BufferArena::AlignedSize(numPixels * elementSize));
+			ReuseSlot(slots[s], i, plan.Dependents, plan.NumDependencies);
+			plan.ResultSlot[i] = s;
+		}
+		if(plan.ResultSlot[i] >= 0)
+		{
+			PlanSlot& slot = slots[plan.ResultSlot[i]];
+			slot.Users.push_back(i);
+			for(size_t r=0; r<node.Readers.size(); ++r)
+				if(roles[node.Readers[r]] != NODE_SKIP)
+					slot.Users.push_back(node.Readers[r]);
+		}
+
+		// Release everything which is dead after this command.
+		if(plan.ScratchSlot[i] >= 0)
+			slots[plan.ScratchSlot[i]].IsFree = true;
+		for(int j=0; j<2; ++j)
+			if(node.Inputs[j] >= 0 && node.Inputs[j] != inPlaceInput && plan.ResultSlot[node.Inputs[j]] >= 0
+				&& lastUse[node.Inputs[j]] == i)
+				slots[plan.ResultSlot[node.Inputs[j]]].IsFree = true;
+	}
+
+	plan.SlotOffsets.resize(plan.SlotSizes.size());
+	plan.Size = 0;
+	for(size_t s=0; s<plan.SlotSizes.size(); ++s)
+	{
+		plan.SlotOffsets[s] = plan.Size;
+		plan.Size += plan.SlotSizes[s];
+	}
+}
+
+// ************************************************************************* //
+size_t GeneratorPipeline::GetWorkspaceSize(int resolutionX, int resolutionY) const
+{
+	MapBufferInfo bufferInfo;
+	FillBufferInfo(bufferInfo, resolutionX, resolutionY);
+	std::vector<char> roles;
+	GetExecuteRoles(roles);
+	BufferPlan plan;
+	PlanBuffers(bufferInfo, roles, plan);
+	return plan.Size;
+}
@@ -0,0 +1,92 @@
+#include "Stdafx.h"
+#include "CommandBuffer.hpp"
+#include "ExecutionState.hpp"
+#include <vector>
+
+/// Distance of the samples of the first pass of ExecuteProgressive.
+const int PROGRESSIVE_FIRST_STRIDE = 8;
+
+// ************************************************************************* //
+// Copy the samples of the last pass to the even samples of the next one.
+static void SpreadSamples( const float* coarse, int coarseX, int coarseY, float* samples, int samplesX )
+{
+	GenerateLines( coarseY, [=](int y, int numLines){
+		for( int yi=y; yi<y+numLines; ++yi )
+		{
+			const float* src = coarse + size_t(yi) * coarseX;
+			float* dst = samples + size_t(yi) * 2 * samplesX;
+			for( int x=0; x<coarseX; ++x )
+				dst[2*x] = src[x];
+		}
+	});
+}
+
+// ************************************************************************* //
+ExecuteStatus GeneratorPipeline::ExecuteProgressive(int resolutionX, int resolutionY, float* finalDestination, bool normalizeData, unsigned int seed,
+	PassCallback callback, void* userData, ExecutionControl* control)
+{
+	if(_numCommands == 0) return ExecuteStatus::OK;
+	if(control && control->IsCancelled()) return ExecuteStatus::CANCELLED;
+	ExecuteStatus precomputeStatus = Precompute();
+	if(precomputeStatus != ExecuteStatus::OK)
+		return precomputeStatus;
+
+	MapBufferInfo bufferInfo;
+	FillBufferInfo(bufferInfo, resolutionX, resolutionY);
+	// Sparse samples are only possible if no command reads neighbors.
+	bool isPointwise = true;
+	for(int i=0; i<_numCommands; ++i)
+		isPointwise &= !_graph[i].IsRequired || _commands[i]->IsPointwise();
+
+	// The raw samples of the last and the current pass and a normalized copy
+	// for the callback. None is larger than 1/4 of the map.
+	size_t maxSamples = size_t((resolutionX + 1) / 2) * ((resolutionY + 1) / 2);
+	size_t temporaryBytes = maxSamples * sizeof(float) * (normalizeData ? 3 : 2);
+	if(!_states->Memory.TryCharge(temporaryBytes))
+		return ExecuteStatus::OUT_OF_MEMORY;
+	ChargeScope temporaryCharge(_states->Memory, temporaryBytes);
+	std::vector<float> coarse, samples, preview;
+	int coarseX = 0, coarseY = 0;
+
+	ExecuteStatus status = ExecuteStatus::OK;
+	for(int stride = PROGRESSIVE_FIRST_STRIDE; stride >= 1 && status == ExecuteStatus::OK; stride /= 2)
+	{
+		MapBufferInfo passInfo = bufferInfo;
+		if(isPointwise)
+		{
+			passInfo.SampleStride = stride;
+			passInfo.HasEvenSamples = coarseX > 0;
+		} else
+			FillBufferInfo(passInfo, (resolutionX + stride - 1) / stride, (resolutionY + stride - 1) / stride);
+		int samplesX = passInfo.GetSamplesX();
+		int samplesY = passInfo.GetSamplesY();
+		float* map = finalDestination;
+		if(stride > 1)
+		{
+			samples.resize(size_t(samplesX) * samplesY);
+			map = samples.data();
+		}
+		if(passInfo.HasEvenSamples)
+			SpreadSamples(coarse.data(), coarseX, coarseY, map, samplesX);
+
+		ValueRange range;
+		status = ExecuteMap(passInfo, map, normalizeData ? &range : nullptr, seed, nullptr, nullptr, control);
+		if(status != ExecuteStatus::OK) break;
+
+		// The raw samples are kept for the next pass.
+		const float* result = map;
+		if(normalizeData && stride > 1)
+		{
+			preview.assign(map, map + samples.size());
+			Normalize(preview.data(), samplesX, samplesY, range);
+			result = preview.data();
+		} else if(normalizeData)
+			Normalize(map, samplesX, samplesY, range);
+		if(callback)
+			callback(result, samplesX, samplesY, stride, userData);
+		coarse.swap(samples);
+		coarseX = samplesX;
+		coarseY = samplesY;
+	}
+	return status;
+}
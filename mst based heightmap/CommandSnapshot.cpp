@@ -0,0 +1,185 @@
+#include "Stdafx.h"
+#include "CommandBuffer.hpp"
+#include "ExecutionState.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <cstdio>
+
+/// Magic number at the begin of a snapshot file ("MSTS").
+const uint32_t SNAPSHOT_MAGIC = 0x5354534d;
+/// Current version of the snapshot format. Increase it if any command
+/// changes the layout of its precomputed data.
+const uint32_t SNAPSHOT_VERSION = 1;
+/// Alignment of the sections inside the file.
+const size_t SNAPSHOT_ALIGNMENT = 16;
+
+namespace {
+
+/// \brief Header of a snapshot file.
+/// \details The header is followed by one SnapshotSection per command and
+///		the data of the sections.
+struct SnapshotHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t ContentHash;		///< Hash of the script and its point set files.
+	uint32_t NumSections;		///< Must be equal to the number of commands.
+	uint32_t Reserved;
+	uint64_t FileSize;			///< Detects truncated files.
+};
+
+struct SnapshotSection
+{
+	uint64_t Offset;			///< Offset from the begin of the file (aligned).
+	uint64_t Size;				///< 0 if the command has no precomputed data.
+};
+
+} // namespace
+
+// ************************************************************************* //
+void GeneratorPipeline::LoadSnapshot(const std::string& snapshotFile)
+{
+	_snapshotFile = snapshotFile;
+
+	// Check if the snapshot belongs to this script.
+	bool isValid = false;
+	if( !snapshotFile.empty() && _snapshot.Open( snapshotFile ) )
+	{
+		const SnapshotHeader* header = (const SnapshotHeader*)_snapshot.GetData();
+		size_t tableEnd = sizeof(SnapshotHeader) + _numCommands * sizeof(SnapshotSection);
+		isValid = _snapshot.GetSize() >= tableEnd
+			&& header->Magic == SNAPSHOT_MAGIC
+			&& header->Version == SNAPSHOT_VERSION
+			&& header->ContentHash == _contentHash
+			&& header->NumSections == uint32_t(_numCommands)
+			&& header->FileSize == _snapshot.GetSize();
+		const SnapshotSection* sections = (const SnapshotSection*)(header + 1);
+		for( int i=0; isValid && i<_numCommands; ++i )
+			isValid = sections[i].Offset % SNAPSHOT_ALIGNMENT == 0
+				&& sections[i].Offset <= _snapshot.GetSize()
+				&& sections[i].Size <= _snapshot.GetSize() - sections[i].Offset;
+	}
+
+	if( isValid )
+	{
+		// The commands use the mapped memory directly. Sections which
+		// cannot be read are computed later.
+		const char* data = (const char*)_snapshot.GetData();
+		const SnapshotSection* sections = (const SnapshotSection*)(data + sizeof(SnapshotHeader));
+		for( int i=0; i<_numCommands; ++i )
+		{
+			if( sections[i].Size == 0
+				|| !_commands[i]->LoadPrecomputed( data + sections[i].Offset, size_t(sections[i].Size) ) )
+				_pendingPrecompute.push_back( i );
+		}
+		return;
+	}
+
+	_snapshot.Close();
+	for( int i=0; i<_numCommands; ++i )
+		_pendingPrecompute.push_back( i );
+}
+
+// ************************************************************************* //
+ExecuteStatus GeneratorPipeline::Precompute(double* milliseconds)
+{
+	std::lock_guard<std::mutex> lock( _states->PrecomputeLock );
+	if( milliseconds ) *milliseconds = 0.0;
+	if( _states->PendingPointSetBytes > 0 )
+	{
+		if( !_states->Memory.TryCharge( _states->PendingPointSetBytes ) )
+			return ExecuteStatus::OUT_OF_MEMORY;
+		_states->PendingPointSetBytes = 0;
+	}
+	if( _pendingPrecompute.empty() ) return ExecuteStatus::OK;
+	auto start = std::chrono::steady_clock::now();
+
+	// The layers run concurrently, so the memory of all of them is
+	// reserved before anything is built.
+	std::vector<size_t> estimates( _pendingPrecompute.size() );
+	for( size_t i=0; i<_pendingPrecompute.size(); ++i )
+	{
+		int command = _pendingPrecompute[i];
+		estimates[i] = _commands[command]->GetPrecomputeEstimate();
+		if( !_states->CommandMemory[command]->TryCharge( estimates[i] ) )
+		{
+			for( size_t j=0; j<i; ++j )
+				_states->CommandMemory[_pendingPrecompute[j]]->Refund( estimates[j] );
+			return ExecuteStatus::OUT_OF_MEMORY;
+		}
+	}
+
+	// The layers are independent -> one task per command. The total time is
+	// the one of the slowest layer.
+	ThreadPool& pool = ThreadPool::Get();
+	TaskGroup group;
+	for( size_t i=0; i<_pendingPrecompute.size(); ++i )
+	{
+		Command* command = _commands[_pendingPrecompute[i]];
+		pool.Submit( group, [command](){ command->Precompute(); } );
+	}
+	try {
+		pool.Wait( group );
+	} catch( ... ) {
+		// E.g. std::bad_alloc. All commands stay pending.
+		for( size_t i=0; i<_pendingPrecompute.size(); ++i )
+			_states->CommandMemory[_pendingPrecompute[i]]->Refund( estimates[i] );
+		throw;
+	}
+	// The reservation is replaced by the size of the result. It is smaller
+	// than the estimate and cannot be dropped again, so it is only counted.
+	for( size_t i=0; i<_pendingPrecompute.size(); ++i )
+	{
+		int command = _pendingPrecompute[i];
+		_states->CommandMemory[command]->Charge( _commands[command]->GetPrecomputedSize() );
+		_states->CommandMemory[command]->Refund( estimates[i] );
+	}
+	_pendingPrecompute.clear();
+
+	// A mapped snapshot was valid and cannot be overwritten.
+	if( !_snapshotFile.empty() && !_snapshot.IsOpen() )
+		WriteSnapshot( _snapshotFile );
+	if( milliseconds )
+		*milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return ExecuteStatus::OK;
+}
+
+// ************************************************************************* //
+bool GeneratorPipeline::SaveSnapshot(const std::string& fileName)
+{
+	if( Precompute() != ExecuteStatus::OK ) return false;
+	return WriteSnapshot( fileName );
+}
+
+bool GeneratorPipeline::WriteSnapshot(const std::string& fileName) const
+{
+	// Collect all sections first to know the offsets.
+	std::vector<char> data;
+	std::vector<SnapshotSection> sections(_numCommands);
+	size_t offset = sizeof(SnapshotHeader) + _numCommands * sizeof(SnapshotSection);
+	for( int i=0; i<_numCommands; ++i )
+	{
+		data.resize( (data.size() + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1) );
+		size_t begin = data.size();
+		if( !_commands[i]->SavePrecomputed( data ) )
+			data.resize( begin );
+		sections[i].Offset = begin == data.size() ? 0 : offset + begin;
+		sections[i].Size = data.size() - begin;
+	}
+
+	SnapshotHeader header = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, _contentHash, uint32_t(_numCommands), 0, offset + data.size() };
+	// Never truncate the target: other processes might have mapped it.
+	std::string tempName = GetTemporaryFileName( fileName );
+	FILE* file = fopen( tempName.c_str(), "wb" );
+	if( !file ) return false;
+	bool success = fwrite( &header, sizeof(header), 1, file ) == 1;
+	if( _numCommands > 0 )
+		success &= fwrite( sections.data(), sizeof(SnapshotSection), _numCommands, file ) == size_t(_numCommands);
+	if( !data.empty() )
+		success &= fwrite( data.data(), 1, data.size(), file ) == data.size();
+	success &= fclose( file ) == 0;
+	success = success && ReplaceFileWith( fileName, tempName );
+	if( !success )
+		remove( tempName.c_str() );
+	return success;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "CommandBuffer.hpp"
+#include "BufferArena.hpp"
+#include "MemoryAccount.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/// \brief Everything which is written during one Execute.
+struct GeneratorPipeline::ExecutionState
+{
+	MemoryAccount Memory;			///< All arenas of the state (destroyed after them).
+	BufferPlan Plan;				///< Plan for the resolution of the last execution.
+	BufferArena Arena;				///< Map buffers and scratch memory of all commands.
+	std::vector<float*> Results;	///< The buffer of each node.
+	std::vector<int> PendingInputs;	///< Unfinished dependencies per node.
+	std::vector<TileBounds> Bounds;	///< Value bounds of each result, Tiles is nullptr if unknown.
+	std::unique_ptr<BufferArena[]> NodeArenas;	///< Scratch memory for each (concurrently running) command.
+
+	/// \param [in] memory Account of the pipeline.
+	ExecutionState(int numCommands, MemoryAccount* memory) :
+		Memory(memory),
+		Results(numCommands),
+		PendingInputs(numCommands),
+		Bounds(numCommands),
+		NodeArenas(new BufferArena[numCommands])
+	{
+		// Only the workspace is planned. Scratch memory beyond the plan is
+		// counted but must not fail inside a command.
+		Arena.SetAccount(&Memory, true);
+		for(int i=0; i<numCommands; ++i)
+			NodeArenas[i].SetAccount(&Memory, false);
+	}
+};
+
+/// \brief Lock-free progress counters of the execution which uses a control.
+/// \details Only the callback is serialized.
+struct ExecutionControl::State
+{
+	/// Fixed point unit of the work of one command.
+	static const uint32_t COMMAND_WORK = 1 << 24;
+
+	TaskControl Tasks;				///< Inherited by all tasks of the execution.
+	ProgressCallback Callback;
+	void* UserData;
+
+	int NumRunning;					///< Number of executed commands.
+	std::vector<int> NumPasses;		///< Estimated GenerateLines calls per command, 0 if skipped.
+	std::unique_ptr<std::atomic<uint32_t>[]> Work;	///< Finished work per command in COMMAND_WORK units.
+	std::atomic<uint32_t> Progress;	///< Maximum reported progress in COMMAND_WORK units.
+	std::mutex CallbackLock;		///< Calls of the callback are never concurrent.
+	uint32_t Delivered;				///< Last progress passed to the callback.
+
+	State() : Callback(nullptr), UserData(nullptr), NumRunning(0), Progress(0), Delivered(0)	{}
+
+	/// Prepare the counters for the commands with the given passes.
+	void Begin(const std::vector<int>& numPasses)
+	{
+		NumPasses = numPasses;
+		NumRunning = 0;
+		Work.reset(new std::atomic<uint32_t>[numPasses.size()]);
+		for(size_t i=0; i<numPasses.size(); ++i)
+		{
+			Work[i].store(0);
+			NumRunning += numPasses[i] > 0 ? 1 : 0;
+		}
+		Progress.store(0);
+		Delivered = 0;
+	}
+
+	/// A block of a pass of a command is finished.
+	void AddWork(int command, float fraction)
+	{
+		if(command < 0 || command >= (int)NumPasses.size() || NumPasses[command] <= 0) return;
+		Work[command].fetch_add(uint32_t(fraction * COMMAND_WORK / NumPasses[command]), std::memory_order_relaxed);
+		Report();
+	}
+
+	void FinishCommand(int command)
+	{
+		Work[command].store(COMMAND_WORK, std::memory_order_relaxed);
+		Report();
+	}
+
+	/// Sum up the commands and call the callback if the progress grew.
+	void Report()
+	{
+		uint64_t sum = 0;
+		for(size_t i=0; i<NumPasses.size(); ++i)
+		{
+			// More passes than estimated must not exceed the command.
+			uint32_t work = Work[i].load(std::memory_order_relaxed);
+			sum += work < COMMAND_WORK ? work : COMMAND_WORK;
+		}
+		uint32_t progress = NumRunning > 0 ? uint32_t(sum / NumRunning) : COMMAND_WORK;
+		uint32_t reported = Progress.load(std::memory_order_relaxed);
+		while(progress > reported)
+			if(Progress.compare_exchange_weak(reported, progress))
+			{
+				if(!Callback) return;
+				// Another thread may have raised the progress since the
+				// exchange and called the callback already. Only the
+				// newest value is delivered, so it never goes backwards.
+				std::lock_guard<std::mutex> lock(CallbackLock);
+				uint32_t newest = Progress.load();
+				if(newest > Delivered)
+				{
+					Delivered = newest;
+					Callback(float(newest) / COMMAND_WORK, UserData);
+				}
+				return;
+			}
+	}
+};
+
+/// \brief Double buffer and completion of asynchronous executions.
+struct AsyncExecution::State
+{
+	float* Buffers[2];
+	std::atomic<int> Front;			///< Index of the front buffer or -1.
+	std::atomic<bool> IsRunning;
+	ExecuteStatus Status;			///< Of the last execution, written before IsRunning is reset.
+	CompletionCallback Callback;
+	void* UserData;
+
+	/// The executions run on an own thread and not as a pool task: without
+	///	pool workers a task would not start before someone waits for it.
+	std::thread Thread;
+	std::mutex Lock;
+	std::condition_variable Changed;	///< Signaled if Job or IsBusy changed.
+	std::function<void()> Job;			///< The next execution or empty.
+	bool IsBusy;						///< Job is set or runs (including the callback).
+	bool IsShutdown;
+	std::exception_ptr Exception;		///< Of the last execution, rethrown by Wait.
+
+	State() : Front(-1), IsRunning(false), Status(ExecuteStatus::OK), Callback(nullptr), UserData(nullptr),
+		IsBusy(false), IsShutdown(false)	{}
+
+	/// Loop of Thread: run the jobs until IsShutdown is set.
+	void Run();
+};
+
+/// \brief Execution states which are not in use.
+/// \details The first state owns the user workspace (SetWorkspace), so
+///		it is preferred by AcquireState.
+struct GeneratorPipeline::StatePool
+{
+	/// Everything of the pipeline, the parent of all other accounts.
+	MemoryAccount Memory;
+	/// Precomputed data and point sets of each command.
+	std::vector<std::unique_ptr<MemoryAccount> > CommandMemory;
+	/// Decoded point sets which did not fit into the memory limits yet.
+	size_t PendingPointSetBytes;
+
+	std::mutex Lock;
+	std::vector<ExecutionState*> States;	///< All states, States[0] is the primary one.
+	std::vector<ExecutionState*> Idle;		///< States which can be acquired.
+	bool UseHugePages;
+
+	std::mutex PrecomputeLock;				///< Serializes Precompute.
+
+	StatePool(int numCommands) : Memory(&MemoryAccount::GetProcess()), PendingPointSetBytes(0), UseHugePages(false)
+	{
+		for(int i=0; i<numCommands; ++i)
+			CommandMemory.push_back(std::unique_ptr<MemoryAccount>(new MemoryAccount(&Memory)));
+	}
+};
@@ -0,0 +1,66 @@
+#include "Stdafx.h"
+#include "ExecutionStats.hpp"
+#include <cstdio>
+
+// Names are taken from the script -> escape them for the json output.
+static std::string EscapeJson( const std::string& text )
+{
+	std::string result;
+	for( size_t i=0; i<text.size(); ++i )
+	{
+		if( text[i] == '"' || text[i] == '\\' ) result += '\\';
+		if( (unsigned char)text[i] >= 0x20 ) result += text[i];
+	}
+	return result;
+}
+
+// One complete event ("X") with the times in microseconds. The counters are
+// shown as arguments of the event.
+static void WriteEvent( FILE* file, bool& isFirst, const char* category, const std::string& name,
+	int thread, double beginMs, double endMs, const CounterValues* counters = nullptr )
+{
+	fprintf( file, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+		isFirst ? "" : ",", EscapeJson(name).c_str(), category, thread, beginMs * 1000.0, (endMs - beginMs) * 1000.0 );
+	if( counters )
+		fprintf( file, ",\"args\":{\"cycles\":%llu,\"instructions\":%llu,\"ipc\":%.3f,\"cache_misses\":%llu,\"branch_misses\":%llu}",
+			(unsigned long long)counters->Cycles, (unsigned long long)counters->Instructions, counters->GetIPC(),
+			(unsigned long long)counters->CacheMisses, (unsigned long long)counters->BranchMisses );
+	fprintf( file, "}" );
+	isFirst = false;
+}
+
+// ************************************************************************* //
+bool ExecutionStats::WriteChromeTrace(const std::string& fileName) const
+{
+	FILE* file = fopen( fileName.c_str(), "w" );
+	if( !file ) return false;
+
+	bool isFirst = true;
+	fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+	for( size_t t=0; t<Threads.size(); ++t )
+	{
+		fprintf( file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+			isFirst ? "" : ",", int(t), t == 0 ? "Caller" : "Worker", int(t) );
+		isFirst = false;
+	}
+
+	WriteEvent( file, isFirst, "pipeline", "Execute", 0, 0.0, TotalMs );
+	if( PrecomputeMs > 0.0 )
+		WriteEvent( file, isFirst, "pipeline", "Precompute", 0, 0.0, PrecomputeMs );
+	if( NormalizeMs > 0.0 )
+		WriteEvent( file, isFirst, "pipeline", "Normalize", 0, ExecuteEndMs, ExecuteEndMs + NormalizeMs );
+	// Counter track of the buffer memory at the end of the execution.
+	fprintf( file, ",\n{\"name\":\"Memory\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"peak_bytes\":%llu,\"current_bytes\":%llu}}",
+		ExecuteEndMs * 1000.0, (unsigned long long)PeakBytes, (unsigned long long)CurrentBytes );
+	for( size_t i=0; i<Commands.size(); ++i )
+		if( Commands[i].IsExecuted )
+			WriteEvent( file, isFirst, "command", Commands[i].Name, Commands[i].Thread, Commands[i].BeginMs, Commands[i].EndMs,
+				HasHardwareCounters ? &Commands[i].Counters : nullptr );
+	// Each command runs in a task, the nested tasks are its blocks.
+	for( size_t i=0; i<Tasks.size(); ++i )
+		WriteEvent( file, isFirst, "task", Tasks[i].Command >= 0 ? Commands[Tasks[i].Command].Name : "Task",
+			Tasks[i].Thread, Tasks[i].BeginMs, Tasks[i].EndMs, HasHardwareCounters ? &Tasks[i].Counters : nullptr );
+
+	fprintf( file, "\n]}\n" );
+	return fclose( file ) == 0;
+}
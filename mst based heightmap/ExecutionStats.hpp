@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "PerfCounters.hpp"
+
+/// \brief Timing of one command in GeneratorPipeline::Execute.
+struct CommandStats
+{
+	std::string Name;		///< Layer index and type from the script, e.g. "Layer 2: Voronoi".
+	bool IsExecuted;		///< False if the command does not contribute to the result.
+	int Thread;				///< Pool thread which started the command (0 = not a worker).
+	double BeginMs;			///< Start relative to the begin of Execute.
+	double EndMs;
+	size_t ResultBytes;		///< Size of the result (the buffer might be shared with an input).
+	size_t ScratchBytes;	///< Temporary memory the command used.
+	size_t PrecomputedBytes;	///< Memory of the precomputed data (e.g. the MST).
+	int NumTiles;			///< Tiles with value bounds (see TileBounds), 0 if the bounds are unknown.
+	int ConstantTiles;		///< Tiles which were filled without the kernel.
+	/// Hardware counters of all threads which worked on the command (see
+	///	ExecutionStats::UseHardwareCounters).
+	CounterValues Counters;
+};
+
+/// \brief Utilization of one pool thread during the command execution.
+struct ThreadStats
+{
+	double BusyMs;			///< Time spent in tasks of this execution.
+	double IdleMs;			///< Remaining time of the command execution.
+};
+
+/// \brief One task of the pool (a command or a part of it).
+struct TaskStats
+{
+	int Thread;
+	int Depth;				///< Number of tasks this one is nested in on the same thread.
+	int Command;			///< Index of the command the task belongs to or -1.
+	double BeginMs;
+	double EndMs;
+	CounterValues Counters;	///< Without the nested tasks.
+};
+
+/// \brief Optional measurements of GeneratorPipeline::Execute.
+/// \details All times are in milliseconds relative to the begin of Execute.
+struct ExecutionStats
+{
+	/// [in] Capture cycles, instructions, cache and branch misses around
+	///	each task (Linux only). Costs two system calls per task.
+	bool UseHardwareCounters;
+	/// [out] The counters could be read. Otherwise they are 0.
+	bool HasHardwareCounters;
+
+	double TotalMs;			///< Duration of the whole Execute call.
+	double PrecomputeMs;	///< Deferred precomputation (e.g. MSTs), 0 after the first call.
+	double ExecuteBeginMs;	///< Begin of the command execution.
+	double ExecuteEndMs;
+	double NormalizeMs;		///< Scaling of the result to [0,1].
+	size_t WorkspaceBytes;	///< Peak memory of all temporary buffers.
+	size_t AllocatedBytes;	///< Memory which this call newly allocated for its buffers.
+	size_t PeakBytes;		///< Peak memory of the buffers of this call (allocated or reused).
+	size_t CurrentBytes;	///< Buffer memory which is kept for the next call.
+
+	std::vector<CommandStats> Commands;		///< One entry per command.
+	std::vector<ThreadStats> Threads;		///< One entry per pool thread.
+	std::vector<TaskStats> Tasks;			///< All tasks in the order they finished.
+
+	ExecutionStats() : UseHardwareCounters(false), HasHardwareCounters(false), TotalMs(0.0), PrecomputeMs(0.0), ExecuteBeginMs(0.0), ExecuteEndMs(0.0),
+		NormalizeMs(0.0), WorkspaceBytes(0), AllocatedBytes(0), PeakBytes(0), CurrentBytes(0)	{}
+
+	/// \brief Write the commands and tasks in the Chrome trace event format
+	///		(chrome://tracing, Perfetto) with one track per thread.
+	/// \return false if the file cannot be written.
+	CPP_DLL bool WriteChromeTrace(const std::string& fileName) const;
+};
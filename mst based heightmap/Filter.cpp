@@ -0,0 +1,74 @@
+#include <memory>
+#include "CommandInfo.h"
+#include "Filter.h"
+#include "math.hpp"
+
+/// Number of columns processed together by one running sum block.
+const int FILTER_STRIP_WIDTH = 64;
+/// Edge length of the tiles during transposition.
+const int TRANSPOSE_BLOCK_SIZE = 32;
+
+// ************************************************************************* //
+static void BoxFilterStrip( const float* source, float* destination, int width, int height, int radius, int x0, int numColumns )
+{
+	// Double precision avoids a drift of the running sums on large maps.
+	double sums[FILTER_STRIP_WIDTH];
+	const double norm = 1.0 / (2 * radius + 1);
+	source += x0;
+	destination += x0;
+
+	// Initial window around line 0 with clamped border
+	for( int x=0; x<numColumns; ++x )
+		sums[x] = 0.0;
+	for( int k=-radius; k<=radius; ++k )
+	{
+		const float* line = source + min(height-1, max(0, k)) * width;
+		for( int x=0; x<numColumns; ++x )
+			sums[x] += line[x];
+	}
+
+	// Slide the window: remove the top line and add the next one.
+	for( int y=0; y<height; ++y )
+	{
+		const float* lineOut = source + max(0, y-radius) * width;
+		const float* lineIn = source + min(height-1, y+radius+1) * width;
+		float* dst = destination + y * width;
+		for( int x=0; x<numColumns; ++x )
+		{
+			dst[x] = float(sums[x] * norm);
+			sums[x] += double(lineIn[x]) - double(lineOut[x]);
+		}
+	}
+}
+
+void BoxFilterColumns( const float* source, float* destination, int width, int height, int radius )
+{
+	int numStrips = (width + FILTER_STRIP_WIDTH - 1) / FILTER_STRIP_WIDTH;
+	GenerateLines( numStrips, [=](int strip, int num){
+		for( int s=strip; s<strip+num; ++s )
+		{
+			int x0 = s * FILTER_STRIP_WIDTH;
+			BoxFilterStrip( source, destination, width, height, radius, x0, min(FILTER_STRIP_WIDTH, width-x0) );
+		}
+	});
+}
+
+// ************************************************************************* //
+void Transpose( const float* source, float* destination, int width, int height )
+{
+	int numBlockLines = (height + TRANSPOSE_BLOCK_SIZE - 1) / TRANSPOSE_BLOCK_SIZE;
+	GenerateLines( numBlockLines, [=](int blockLine, int num){
+		for( int y0=blockLine*TRANSPOSE_BLOCK_SIZE; y0<min(height, (blockLine+num)*TRANSPOSE_BLOCK_SIZE); y0+=TRANSPOSE_BLOCK_SIZE )
+		{
+			int y1 = min(height, y0 + TRANSPOSE_BLOCK_SIZE);
+			for( int x0=0; x0<width; x0+=TRANSPOSE_BLOCK_SIZE )
+			{
+				int x1 = min(width, x0 + TRANSPOSE_BLOCK_SIZE);
+				// Both, the read and the written block fit into the L1 cache.
+				for( int x=x0; x<x1; ++x )
+					for( int y=y0; y<y1; ++y )
+						destination[x * height + y] = source[y * width + x];
+			}
+		}
+	});
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+/// \brief Box filter in vertical direction (along the columns) of a map.
+/// \details The cost per pixel is constant and independent of the radius
+///		(running sums). The border is clamped to the edge. The columns are
+///		processed in parallel strips which are small enough that the running
+///		sums stay in the L1 cache and the inner loop can be vectorized.
+/// \param [in] source Input map with width x height floats (rowwise).
+/// \param [out] destination Output map with the same size. Must not be the
+///		same as source.
+/// \param [in] radius The filter window is 2*radius+1 pixels.
+void BoxFilterColumns( const float* source, float* destination, int width, int height, int radius );
+
+/// \brief Cache blocked transposition of a map.
+/// \details The result has the size height x width. This is used to apply
+///		column filters in the other direction.
+/// \param [in] source Input map with width x height floats (rowwise).
+/// \param [out] destination Output map with height x width floats. Must not
+///		be the same as source.
+void Transpose( const float* source, float* destination, int width, int height );
\ No newline at end of file
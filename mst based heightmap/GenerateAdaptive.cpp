@@ -0,0 +1,191 @@
+#include <cassert>
+#include <mutex>
+#include "CommandInfo.h"
+#include "math.hpp"
+#include "WorkCounters.hpp"
+
+/// Size of the root cells of the quadtree in samples. Must be a power of two.
+const int ADAPTIVE_CELL_SIZE = 16;
+/// The bicubic support of a cell reaches one cell size before and two cell
+/// sizes after its origin. The root cell needs the largest support.
+const int ADAPTIVE_CACHE_SIZE = 3 * ADAPTIVE_CELL_SIZE + 1;
+
+// Catmull-Rom weights of the four samples at -1, 0, 1 and 2 for t in [0,1].
+static void CubicWeights( float t, float* w )
+{
+	float t2 = t*t;
+	float t3 = t2*t;
+	w[0] = 0.5f * (-t3 + 2.0f*t2 - t);
+	w[1] = 0.5f * (3.0f*t3 - 5.0f*t2 + 2.0f);
+	w[2] = 0.5f * (-3.0f*t3 + 4.0f*t2 + t);
+	w[3] = 0.5f * (t3 - t2);
+}
+
+// Bicubic interpolation in a 4x4 support (rowwise) at u,v in [0,1]^2.
+static float Bicubic( const float* support, float u, float v )
+{
+	float wu[4], wv[4];
+	CubicWeights( u, wu );
+	CubicWeights( v, wv );
+	float result = 0.0f;
+	for( int b=0; b<4; ++b )
+		result += wv[b] * (wu[0]*support[b*4] + wu[1]*support[b*4+1] + wu[2]*support[b*4+2] + wu[3]*support[b*4+3]);
+	return result;
+}
+
+/// \brief Quadtree of one root cell.
+/// \details Exact samples are cached in a grid around the root cell, so
+///		samples which are shared by neighbouring cells or by the levels are
+///		evaluated once. Samples outside the map are evaluated too: the
+///		generator kernels are defined everywhere and so the cells at the
+///		border have a complete support.
+class AdaptiveCell
+{
+	const CommandDesc& _desc;
+	const float _tolerance;
+	const int _x0, _y0;		///< First sample of the root cell.
+	float _samples[ADAPTIVE_CACHE_SIZE * ADAPTIVE_CACHE_SIZE];
+	bool _isKnown[ADAPTIVE_CACHE_SIZE * ADAPTIVE_CACHE_SIZE];
+
+	int CacheIndex( int x, int y ) const	{ return (y - _y0 + ADAPTIVE_CELL_SIZE) * ADAPTIVE_CACHE_SIZE + x - _x0 + ADAPTIVE_CELL_SIZE; }
+
+	float Sample( int x, int y )
+	{
+		int index = CacheIndex( x, y );
+		if( !_isKnown[index] )
+		{
+			int stride = _desc.BufferInfo.SampleStride;
+			_samples[index] = _desc.Kernel( _desc.BufferInfo, x * stride, y * stride, 0.0f, 0.0f );
+			WORK_END_PIXEL();
+			_isKnown[index] = true;
+		}
+		return _samples[index];
+	}
+
+	// Write the cell into Result: known samples exactly, the others
+	// interpolated.
+	void Fill( int x, int y, int size, const float* support )
+	{
+		for( int j=0; j<size; ++j )
+			for( int i=0; i<size; ++i )
+			{
+				int index = CacheIndex( x+i, y+j );
+				Result[(y+j-_y0) * ADAPTIVE_CELL_SIZE + x+i-_x0] = _isKnown[index] ? _samples[index]
+					: Bicubic( support, i / float(size), j / float(size) );
+			}
+	}
+
+public:
+	/// The values of the root cell (rowwise). Parts outside the map are
+	///	undefined.
+	float Result[ADAPTIVE_CELL_SIZE * ADAPTIVE_CELL_SIZE];
+
+	AdaptiveCell( const CommandDesc& desc, float tolerance, int x0, int y0 ) :
+		_desc(desc),
+		_tolerance(tolerance),
+		_x0(x0),
+		_y0(y0)
+	{
+		memset( _isKnown, 0, sizeof(_isKnown) );
+	}
+
+	/// \brief Interpolate the cell if the error at the test points is small
+	///		enough. Otherwise split it into four.
+	/// \details The test points are corners of the children and their
+	///		children, so they are not evaluated again if the cell is split.
+	void Refine( int x, int y, int size )
+	{
+		const MapBufferInfo& bufferInfo = _desc.BufferInfo;
+		if( x >= int(bufferInfo.GetSamplesX()) || y >= int(bufferInfo.GetSamplesY()) )
+			return;
+		// All pixels of a 2x2 cell are corners or test points: no
+		// interpolation and no support outside the cell.
+		if( size <= 2 )
+		{
+			for( int j=0; j<size; ++j )
+				for( int i=0; i<size; ++i )
+					Result[(y+j-_y0) * ADAPTIVE_CELL_SIZE + x+i-_x0] = Sample( x+i, y+j );
+			return;
+		}
+
+		float support[16];
+		for( int b=0; b<4; ++b )
+			for( int a=0; a<4; ++a )
+				support[b*4+a] = Sample( x + (a-1) * size, y + (b-1) * size );
+
+		// In quarters of the cell: edge midpoints, center and the centers
+		// of the children.
+		static const int TEST_POINTS[9][2] = { {2,0}, {0,2}, {2,2}, {4,2}, {2,4}, {1,1}, {3,1}, {1,3}, {3,3} };
+		int half = size / 2;
+		int quarter = size / 4;
+		float error = 0.0f;
+		for( int t=0; t<9 && error <= _tolerance; ++t )
+		{
+			float exact = Sample( x + TEST_POINTS[t][0] * quarter, y + TEST_POINTS[t][1] * quarter );
+			error = max( error, fabsf(exact - Bicubic( support, TEST_POINTS[t][0] * 0.25f, TEST_POINTS[t][1] * 0.25f )) );
+		}
+
+		if( error <= _tolerance )
+			Fill( x, y, size, support );
+		else {
+			Refine( x, y, half );
+			Refine( x + half, y, half );
+			Refine( x, y + half, half );
+			Refine( x + half, y + half, half );
+		}
+	}
+};
+
+// All root cells in a block of cell rows.
+static ValueRange Cells_Kernel( const CommandDesc& commandInfo, float tolerance, int cellY, int numCellRows, bool trackRange )
+{
+	const MapBufferInfo& bufferInfo = commandInfo.BufferInfo;
+	const int width = bufferInfo.GetSamplesX();
+	const int height = bufferInfo.GetSamplesY();
+	ValueRange range;
+	for( int y0=cellY*ADAPTIVE_CELL_SIZE; y0<(cellY+numCellRows)*ADAPTIVE_CELL_SIZE; y0+=ADAPTIVE_CELL_SIZE )
+		for( int x0=0; x0<width; x0+=ADAPTIVE_CELL_SIZE )
+		{
+			AdaptiveCell cell( commandInfo, tolerance, x0, y0 );
+			// The interpolation of cells in a constant tile could use
+			// samples outside of it.
+			const ValueRange* tile = commandInfo.Bounds ? &commandInfo.Bounds->Get( x0 / BOUNDS_TILE_SIZE, y0 / BOUNDS_TILE_SIZE ) : nullptr;
+			if( tile && tile->IsConstant() )
+				for( int i=0; i<ADAPTIVE_CELL_SIZE * ADAPTIVE_CELL_SIZE; ++i )
+					cell.Result[i] = tile->Min;
+			else
+				cell.Refine( x0, y0, ADAPTIVE_CELL_SIZE );
+
+			int count = min(ADAPTIVE_CELL_SIZE, width-x0);
+			for( int j=0; j<min(ADAPTIVE_CELL_SIZE, height-y0); ++j )
+			{
+				const float* line = cell.Result + j * ADAPTIVE_CELL_SIZE;
+				if( trackRange )
+					for( int i=0; i<count; ++i )
+						range.Add(line[i]);
+				EncodeLine( commandInfo.Destination, commandInfo.DestinationStorage, size_t(y0+j) * width + x0, count, line );
+			}
+		}
+	return range;
+}
+
+// ************************************************************************* //
+/// \brief Parallel adaptive computation of a generator layer.
+/// \details The blocks of GenerateLines are rows of root cells.
+void GenerateLayerAdaptive(const CommandDesc& commandInfo, float tolerance)
+{
+	assert( !commandInfo.PrevResult && !commandInfo.CurrentResult );
+	int numCellRows = (commandInfo.BufferInfo.GetSamplesY() + ADAPTIVE_CELL_SIZE - 1) / ADAPTIVE_CELL_SIZE;
+	if( commandInfo.Range )
+	{
+		std::mutex rangeLock;
+		GenerateLines( numCellRows,
+			[&commandInfo, tolerance, &rangeLock](int y, int numLines){
+				ValueRange range = Cells_Kernel( commandInfo, tolerance, y, numLines, true );
+				std::lock_guard<std::mutex> lock(rangeLock);
+				commandInfo.Range->Merge(range);
+			} );
+	} else
+		GenerateLines( numCellRows,
+			[&commandInfo, tolerance](int y, int numLines){ Cells_Kernel( commandInfo, tolerance, y, numLines, false ); } );
+}
@@ -1,45 +1,155 @@
-#include <thread>
+#include <mutex>
 #include "CommandInfo.h"
+#include "ThreadPool.hpp"
 #include "math.hpp"
+#include "WorkCounters.hpp"
+
+/// Number of blocks per pool thread GenerateLines splits the work into.
+const int GENERATE_BLOCKS_PER_THREAD = 4;
+/// Number of pixels which are converted and processed together.
+const int LAYER_CHUNK_SIZE = 256;
 
 // Uses several blending methods to add noise to the terrain.
-static void Line_Kernel( const CommandDesc& commandInfo, int y, int numLines )
+// The lines are processed in chunks: the inputs are converted to float, the
+// kernel is applied and the results are converted to the destination format.
+// Converting a whole chunk before writing it also allows in place execution.
+// Tiles which are proven constant are filled without the kernel.
+static ValueRange Line_Kernel( const CommandDesc& commandInfo, int y, int numLines, bool trackRange )
 {
-	for( int i=0; i<numLines; ++i )
+	float prev[LAYER_CHUNK_SIZE];
+	float current[LAYER_CHUNK_SIZE];
+	float result[LAYER_CHUNK_SIZE];
+	const MapBufferInfo& bufferInfo = commandInfo.BufferInfo;
+	const int width = bufferInfo.GetSamplesX();
+	const int stride = bufferInfo.SampleStride;
+	const TileBounds* bounds = commandInfo.Bounds;
+	ValueRange range;
+	for( int yi=y; yi<y+numLines; ++yi )
 	{
-		int yw = (y+i) * commandInfo.BufferInfo.ResolutionX;
-		for( unsigned int x=0; x<commandInfo.BufferInfo.ResolutionX; ++x )
+		// Even samples of even lines are known from the last pass. They
+		// are kept by writing back what the destination contains.
+		bool keepEven = bufferInfo.HasEvenSamples && (yi & 1) == 0;
+		for( int x0=0; x0<width; x0+=LAYER_CHUNK_SIZE )
 		{
-			commandInfo.Destination[yw+x] = commandInfo.Kernel(commandInfo.BufferInfo, x, y+i, commandInfo.PrevResult, commandInfo.CurrentResult);
+			int count = min(LAYER_CHUNK_SIZE, width-x0);
+			size_t offset = size_t(yi) * width + x0;
+			DecodeLine( commandInfo.PrevResult, commandInfo.PrevStorage, offset, count, prev );
+			DecodeLine( commandInfo.CurrentResult, commandInfo.CurrentStorage, offset, count, current );
+			if( keepEven )
+				DecodeLine( commandInfo.Destination, commandInfo.DestinationStorage, offset, count, result );
+			// Spans of the chunk within one tile. Without bounds the whole
+			// chunk is one span.
+			for( int i0=0; i0<count; )
+			{
+				int i1 = count;
+				if( bounds )
+				{
+					// LAYER_CHUNK_SIZE is a multiple of the tile size.
+					int tileX = (x0+i0) / BOUNDS_TILE_SIZE;
+					i1 = min(count, (tileX+1) * BOUNDS_TILE_SIZE - x0);
+					const ValueRange& tile = bounds->Get( tileX, yi / BOUNDS_TILE_SIZE );
+					if( tile.IsConstant() )
+					{
+						for( int i=i0; i<i1; ++i )
+							result[i] = tile.Min;
+						i0 = i1;
+						continue;
+					}
+				}
+				if( stride == 1 && !keepEven )
+				{
+					for( int i=i0; i<i1; ++i )
+					{
+						result[i] = commandInfo.Kernel(bufferInfo, x0+i, yi, prev[i], current[i]);
+						WORK_END_PIXEL();
+					}
+				} else {
+					// Spans and chunks start at even positions.
+					for( int i=keepEven ? i0+1 : i0; i<i1; i+=keepEven ? 2 : 1 )
+					{
+						result[i] = commandInfo.Kernel(bufferInfo, (x0+i) * stride, yi * stride, prev[i], current[i]);
+						WORK_END_PIXEL();
+					}
+				}
+				i0 = i1;
+			}
+			if( trackRange )
+				for( int i=0; i<count; ++i )
+					range.Add(result[i]);
+			EncodeLine( commandInfo.Destination, commandInfo.DestinationStorage, offset, count, result );
 		}
 	}
+	return range;
 }
 
 
 /// \brief Parallel computation of one layer.
-/// \details This method creates as many hardware threads as possible and
+/// \details This method distributes blocks of lines to the thread pool and
 ///		calculates the new height per pixel.
 void GenerateLayer(const CommandDesc& commandInfo)
 {
-	int n = std::thread::hardware_concurrency();
-	// Execution in n threads (one of them is the current one)
-	int numLinesPerThread = commandInfo.BufferInfo.ResolutionY / n  +  ( ((commandInfo.BufferInfo.ResolutionY % n)==0) ? 0 : 1 );
-	std::thread** threads = new std::thread*[n-1]();	// TODO: Evaluate use of OpenMP http://msdn.microsoft.com/en-us/library/68ah4xc7.aspx
-	for( int t=0; t<n-1; ++t )
-		threads[t] = new std::thread( Line_Kernel, commandInfo, t*numLinesPerThread, numLinesPerThread );
-	int numLines = min(numLinesPerThread, commandInfo.BufferInfo.ResolutionY-(n-1)*numLinesPerThread);
-	Line_Kernel( commandInfo, (n-1)*numLinesPerThread, numLines );
-	for( int t=0; t<(n-1); ++t )
+	if( commandInfo.Range )
 	{
-		threads[t]->join();
-		delete threads[t];
-	}
-	
-	delete[] threads;
+		// Each thread has its own range, the lock is only used once per
+		// thread to merge them.
+		std::mutex rangeLock;
+		GenerateLines( commandInfo.BufferInfo.GetSamplesY(),
+			[&commandInfo, &rangeLock](int y, int numLines){
+				ValueRange range = Line_Kernel( commandInfo, y, numLines, true );
+				std::lock_guard<std::mutex> lock(rangeLock);
+				commandInfo.Range->Merge(range);
+			} );
+	} else
+		GenerateLines( commandInfo.BufferInfo.GetSamplesY(),
+			[&commandInfo](int y, int numLines){ Line_Kernel( commandInfo, y, numLines, false ); } );
 }
 
 // Seqential computation of one layer for testing purposes.
 void GenerateLayerSeq(const CommandDesc& commandInfo)
 {
-	Line_Kernel( commandInfo, 0, commandInfo.BufferInfo.ResolutionY );
-}
\ No newline at end of file
+	if( commandInfo.Range )
+		commandInfo.Range->Merge( Line_Kernel( commandInfo, 0, commandInfo.BufferInfo.GetSamplesY(), true ) );
+	else
+		Line_Kernel( commandInfo, 0, commandInfo.BufferInfo.GetSamplesY(), false );
+}
+
+// One block of GenerateLines. A cancelled block is skipped, a finished one
+// is reported to the control.
+static void RunBlock(const LineKernel_t& kernel, int y, int numLines, int totalLines)
+{
+	TaskControl* control = ThreadPool::GetControl();
+	if( !control )
+	{
+		kernel( y, numLines );
+		return;
+	}
+	if( control->IsCancelled.load(std::memory_order_relaxed) ) return;
+	kernel( y, numLines );
+	if( control->OnBlockFinished )
+		control->OnBlockFinished( ThreadPool::GetTaskTag(), float(numLines) / totalLines );
+}
+
+// Parallel execution of a kernel which processes blocks of lines.
+void GenerateLines(int numLines, const LineKernel_t& kernel)
+{
+	ThreadPool& pool = ThreadPool::Get();
+	// More blocks than threads balance lines with different costs and
+	// concurrently running commands.
+	int numBlocks = min(numLines, pool.GetNumThreads() * GENERATE_BLOCKS_PER_THREAD);
+	if( numBlocks <= 1 )
+	{
+		if( numLines > 0 ) RunBlock( kernel, 0, numLines, numLines );
+		return;
+	}
+
+	TaskGroup group;
+	for( int b=1; b<numBlocks; ++b )
+	{
+		int y0 = int((long long)b * numLines / numBlocks);
+		int y1 = int((long long)(b+1) * numLines / numBlocks);
+		pool.Submit( group, [&kernel, y0, y1, numLines](){ RunBlock( kernel, y0, y1-y0, numLines ); } );
+	}
+	// The first block is done by the current thread.
+	RunBlock( kernel, 0, int(numLines / numBlocks), numLines );
+	pool.Wait( group );
+}
@@ -0,0 +1,292 @@
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include "JsonStream.hpp"
+
+/// Deeper nesting is rejected (protects the stack of the recursive parser).
+const int JSON_MAX_DEPTH = 256;
+/// Numbers with at most this many significant digits are converted without strtod.
+const int JSON_FAST_DIGITS = 19;
+
+namespace {
+
+/// Exactly representable powers of ten.
+const double POWERS_OF_TEN[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+struct JsonParser
+{
+	const char* Current;
+	const char* End;
+	JsonHandler& Handler;
+	std::string StringBuffer;		///< Decoded strings with escape sequences.
+
+	JsonParser( const char* begin, const char* end, JsonHandler& handler ) :
+		Current(begin), End(end), Handler(handler)	{}
+
+	void SkipWhitespace();
+	bool ParseValue( int depth );
+	bool ParseString( const char*& string, size_t& length );
+	bool ParseNumber();
+	bool ParseLiteral( const char* literal );
+};
+
+// ************************************************************************* //
+void JsonParser::SkipWhitespace()
+{
+	while( Current < End )
+	{
+		char c = *Current;
+		if( c == ' ' || c == '\t' || c == '\n' || c == '\r' )
+			++Current;
+		else if( c == '/' && Current+1 < End && Current[1] == '/' )
+		{
+			while( Current < End && *Current != '\n' ) ++Current;
+		} else if( c == '/' && Current+1 < End && Current[1] == '*' )
+		{
+			Current += 2;
+			while( Current+1 < End && !(Current[0] == '*' && Current[1] == '/') ) ++Current;
+			Current = Current+2 < End ? Current+2 : End;
+		} else return;
+	}
+}
+
+// ************************************************************************* //
+static void AppendUtf8( std::string& out, uint32_t codepoint )
+{
+	if( codepoint < 0x80 )
+		out += char(codepoint);
+	else if( codepoint < 0x800 )
+	{
+		out += char(0xc0 | (codepoint >> 6));
+		out += char(0x80 | (codepoint & 0x3f));
+	} else if( codepoint < 0x10000 )
+	{
+		out += char(0xe0 | (codepoint >> 12));
+		out += char(0x80 | ((codepoint >> 6) & 0x3f));
+		out += char(0x80 | (codepoint & 0x3f));
+	} else {
+		out += char(0xf0 | (codepoint >> 18));
+		out += char(0x80 | ((codepoint >> 12) & 0x3f));
+		out += char(0x80 | ((codepoint >> 6) & 0x3f));
+		out += char(0x80 | (codepoint & 0x3f));
+	}
+}
+
+static bool ParseHex4( const char* text, uint32_t& value )
+{
+	value = 0;
+	for( int i=0; i<4; ++i )
+	{
+		char c = text[i];
+		value <<= 4;
+		if( c >= '0' && c <= '9' ) value |= c - '0';
+		else if( c >= 'a' && c <= 'f' ) value |= c - 'a' + 10;
+		else if( c >= 'A' && c <= 'F' ) value |= c - 'A' + 10;
+		else return false;
+	}
+	return true;
+}
+
+bool JsonParser::ParseString( const char*& string, size_t& length )
+{
+	++Current;	// "
+	const char* start = Current;
+	// Fast path: strings without escape sequences are passed in place.
+	while( Current < End && *Current != '"' && *Current != '\\' ) ++Current;
+	if( Current >= End ) return false;
+	if( *Current == '"' )
+	{
+		string = start;
+		length = size_t(Current - start);
+		++Current;
+		return true;
+	}
+
+	StringBuffer.assign( start, Current );
+	while( Current < End && *Current != '"' )
+	{
+		if( *Current != '\\' )
+		{
+			StringBuffer += *Current++;
+			continue;
+		}
+		if( ++Current >= End ) return false;
+		switch( *Current++ )
+		{
+		case '"': StringBuffer += '"'; break;
+		case '\\': StringBuffer += '\\'; break;
+		case '/': StringBuffer += '/'; break;
+		case 'b': StringBuffer += '\b'; break;
+		case 'f': StringBuffer += '\f'; break;
+		case 'n': StringBuffer += '\n'; break;
+		case 'r': StringBuffer += '\r'; break;
+		case 't': StringBuffer += '\t'; break;
+		case 'u': {
+			uint32_t codepoint;
+			if( End - Current < 4 || !ParseHex4( Current, codepoint ) ) return false;
+			Current += 4;
+			// Surrogate pair
+			if( codepoint >= 0xd800 && codepoint < 0xdc00 )
+			{
+				uint32_t low;
+				if( End - Current < 6 || Current[0] != '\\' || Current[1] != 'u'
+					|| !ParseHex4( Current+2, low ) || low < 0xdc00 || low > 0xdfff )
+					return false;
+				Current += 6;
+				codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+			}
+			AppendUtf8( StringBuffer, codepoint );
+			break; }
+		default: return false;
+		}
+	}
+	if( Current >= End ) return false;
+	++Current;
+	string = StringBuffer.data();
+	length = StringBuffer.size();
+	return true;
+}
+
+// ************************************************************************* //
+bool JsonParser::ParseNumber()
+{
+	const char* start = Current;
+	bool negative = false;
+	if( *Current == '-' ) { negative = true; ++Current; }
+
+	// Collect the significant digits in an integer and count the decimal
+	// exponent separately.
+	uint64_t mantissa = 0;
+	int numDigits = 0;
+	int exponent = 0;
+	bool isInteger = true;
+	const char* digitsStart = Current;
+	while( Current < End && *Current >= '0' && *Current <= '9' )
+	{
+		if( numDigits < JSON_FAST_DIGITS ) { mantissa = mantissa * 10 + (*Current - '0'); if( mantissa ) ++numDigits; }
+		else { ++exponent; ++numDigits; }
+		++Current;
+	}
+	if( Current == digitsStart ) return false;
+	if( Current < End && *Current == '.' )
+	{
+		isInteger = false;
+		const char* fractionStart = ++Current;
+		while( Current < End && *Current >= '0' && *Current <= '9' )
+		{
+			if( numDigits < JSON_FAST_DIGITS ) { mantissa = mantissa * 10 + (*Current - '0'); --exponent; if( mantissa ) ++numDigits; }
+			else ++numDigits;
+			++Current;
+		}
+		if( Current == fractionStart ) return false;
+	}
+	if( Current < End && (*Current == 'e' || *Current == 'E') )
+	{
+		isInteger = false;
+		++Current;
+		bool negativeExponent = false;
+		if( Current < End && (*Current == '+' || *Current == '-') )
+			negativeExponent = *Current++ == '-';
+		const char* exponentStart = Current;
+		int explicitExponent = 0;
+		while( Current < End && *Current >= '0' && *Current <= '9' )
+		{
+			if( explicitExponent < 100000 ) explicitExponent = explicitExponent * 10 + (*Current - '0');
+			++Current;
+		}
+		if( Current == exponentStart ) return false;
+		exponent += negativeExponent ? -explicitExponent : explicitExponent;
+	}
+
+	// Both, mantissa and power of ten are exact doubles -> one correctly
+	// rounded operation. Everything else goes through strtod.
+	double value;
+	if( numDigits <= JSON_FAST_DIGITS && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22 )
+	{
+		value = double(mantissa);
+		value = exponent < 0 ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+		if( negative ) value = -value;
+	} else {
+		std::string number( start, Current );
+		value = strtod( number.c_str(), nullptr );
+	}
+	return Handler.Number( value, isInteger );
+}
+
+// ************************************************************************* //
+bool JsonParser::ParseLiteral( const char* literal )
+{
+	for( ; *literal; ++literal, ++Current )
+		if( Current >= End || *Current != *literal )
+			return false;
+	return true;
+}
+
+// ************************************************************************* //
+bool JsonParser::ParseValue( int depth )
+{
+	if( depth > JSON_MAX_DEPTH ) return false;
+	SkipWhitespace();
+	if( Current >= End ) return false;
+
+	switch( *Current )
+	{
+	case '{': {
+		++Current;
+		if( !Handler.BeginObject() ) return false;
+		SkipWhitespace();
+		if( Current < End && *Current == '}' ) { ++Current; return Handler.EndObject(); }
+		while( true )
+		{
+			SkipWhitespace();
+			if( Current >= End || *Current != '"' ) return false;
+			const char* key; size_t length;
+			if( !ParseString( key, length ) || !Handler.Key( key, length ) ) return false;
+			SkipWhitespace();
+			if( Current >= End || *Current++ != ':' ) return false;
+			if( !ParseValue( depth+1 ) ) return false;
+			SkipWhitespace();
+			if( Current >= End ) return false;
+			if( *Current == ',' ) { ++Current; continue; }
+			if( *Current++ != '}' ) return false;
+			return Handler.EndObject();
+		} }
+	case '[': {
+		++Current;
+		if( !Handler.BeginArray() ) return false;
+		SkipWhitespace();
+		if( Current < End && *Current == ']' ) { ++Current; return Handler.EndArray(); }
+		while( true )
+		{
+			if( !ParseValue( depth+1 ) ) return false;
+			SkipWhitespace();
+			if( Current >= End ) return false;
+			if( *Current == ',' ) { ++Current; continue; }
+			if( *Current++ != ']' ) return false;
+			return Handler.EndArray();
+		} }
+	case '"': {
+		const char* string; size_t length;
+		return ParseString( string, length ) && Handler.String( string, length ); }
+	case 't': return ParseLiteral( "true" ) && Handler.Bool( true );
+	case 'f': return ParseLiteral( "false" ) && Handler.Bool( false );
+	case 'n': return ParseLiteral( "null" ) && Handler.Null();
+	default:
+		return ParseNumber();
+	}
+}
+
+} // namespace
+
+// ************************************************************************* //
+bool ParseJsonStream( const char* begin, const char* end, JsonHandler& handler )
+{
+	JsonParser parser( begin, end, handler );
+	if( !parser.ParseValue( 0 ) ) return false;
+	// Only whitespace may follow the root value.
+	parser.SkipWhitespace();
+	return parser.Current == end;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+/// \brief Receiver of the events of ParseJsonStream.
+/// \details Each callback can stop the parsing by returning false. Strings
+///		are not null terminated and only valid during the call. Escape
+///		sequences are already decoded.
+class JsonHandler
+{
+public:
+	virtual bool BeginObject() = 0;
+	virtual bool Key( const char* string, size_t length ) = 0;
+	virtual bool EndObject() = 0;
+	virtual bool BeginArray() = 0;
+	virtual bool EndArray() = 0;
+	virtual bool String( const char* string, size_t length ) = 0;
+	/// \param [in] isInteger The number has no fraction or exponent.
+	virtual bool Number( double value, bool isInteger ) = 0;
+	virtual bool Bool( bool value ) = 0;
+	virtual bool Null() = 0;
+
+	virtual ~JsonHandler()	{}
+};
+
+/// \brief SAX style json parser.
+/// \details Reads a json text in one pass without building any tree. The
+///		handler decides what to keep - e.g. large number arrays can be
+///		decoded directly into their final storage. Comments (// and / * * /)
+///		are skipped like in jsoncpp.
+/// \return false if the text is not valid json or the handler stopped.
+bool ParseJsonStream( const char* begin, const char* end, JsonHandler& handler );
@@ -0,0 +1,111 @@
+#include "MappedFile.hpp"
+#include <atomic>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ************************************************************************* //
+MappedFile::MappedFile() :
+	_data(nullptr),
+	_size(0)
+#ifdef _WIN32
+	, _fileMapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+// ************************************************************************* //
+bool MappedFile::Open( const std::string& fileName )
+{
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA( fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if( file == INVALID_HANDLE_VALUE ) return false;
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = nullptr;
+	if( GetFileSizeEx( file, &fileSize ) && fileSize.QuadPart > 0 )
+		mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	// The mapping keeps the file open.
+	CloseHandle( file );
+	if( !mapping ) return false;
+	_data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if( !_data )
+	{
+		CloseHandle( mapping );
+		return false;
+	}
+	_fileMapping = mapping;
+	_size = size_t(fileSize.QuadPart);
+#else
+	int file = open( fileName.c_str(), O_RDONLY );
+	if( file < 0 ) return false;
+	struct stat fileInfo;
+	if( fstat( file, &fileInfo ) != 0 || fileInfo.st_size <= 0 )
+	{
+		close( file );
+		return false;
+	}
+	void* memory = mmap( nullptr, size_t(fileInfo.st_size), PROT_READ, MAP_PRIVATE, file, 0 );
+	close( file );
+	if( memory == MAP_FAILED ) return false;
+	_data = memory;
+	_size = size_t(fileInfo.st_size);
+#endif
+	return true;
+}
+
+// ************************************************************************* //
+void MappedFile::Close()
+{
+	if( !_data ) return;
+#ifdef _WIN32
+	UnmapViewOfFile( _data );
+	CloseHandle( (HANDLE)_fileMapping );
+	_fileMapping = nullptr;
+#else
+	munmap( const_cast<void*>(_data), _size );
+#endif
+	_data = nullptr;
+	_size = 0;
+}
+
+// ************************************************************************* //
+std::string GetTemporaryFileName( const std::string& fileName )
+{
+	static std::atomic<unsigned> s_counter(0);
+#ifdef _WIN32
+	unsigned processId = unsigned(_getpid());
+#else
+	unsigned processId = unsigned(getpid());
+#endif
+	char suffix[48];
+	snprintf( suffix, sizeof(suffix), ".%u.%u.tmp", processId, s_counter++ );
+	return fileName + suffix;
+}
+
+bool ReplaceFileWith( const std::string& target, const std::string& source )
+{
+#ifdef _WIN32
+	return MoveFileExA( source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+	return rename( source.c_str(), target.c_str() ) == 0;
+#endif
+}
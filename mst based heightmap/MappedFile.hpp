@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/// \brief Read only memory mapping of a whole file.
+/// \details The pages are loaded by the OS on first access. The mapping is
+///		page aligned.
+class MappedFile
+{
+	const void* _data;
+	size_t _size;
+#ifdef _WIN32
+	void* _fileMapping;			///< Handle of the file mapping object.
+#endif
+
+	// Prevent copy constructor and operator = being generated.
+	MappedFile(const MappedFile&);
+	MappedFile& operator = (const MappedFile&);
+public:
+	MappedFile();
+	~MappedFile();
+
+	/// \brief Map a file. A previous mapping is closed.
+	/// \return false if the file does not exist or is empty.
+	bool Open( const std::string& fileName );
+	void Close();
+
+	bool IsOpen() const				{ return _data != nullptr; }
+	const void* GetData() const		{ return _data; }
+	size_t GetSize() const			{ return _size; }
+};
+
+/// \brief Unique name for a new file in the directory of fileName.
+/// \details Unique among all processes and threads. The file can be renamed
+///		to fileName, because it is on the same file system.
+std::string GetTemporaryFileName( const std::string& fileName );
+
+/// \brief Rename source to target and replace an existing target atomically.
+/// \details Readers never see a partial target. Processes which mapped the
+///		old target keep its content. On Windows a mapped target can not be
+///		replaced: the call fails then.
+bool ReplaceFileWith( const std::string& target, const std::string& source );
@@ -0,0 +1,63 @@
+#include "MemoryAccount.hpp"
+
+// ************************************************************************* //
+MemoryAccount::MemoryAccount( MemoryAccount* parent ) :
+	_parent(parent),
+	_current(0),
+	_peak(0),
+	_limit(0)
+{
+}
+
+MemoryAccount::~MemoryAccount()
+{
+	if( _parent )
+		_parent->Refund( _current.load() );
+}
+
+MemoryAccount& MemoryAccount::GetProcess()
+{
+	// Never destroyed: pipelines might be deleted during the static destruction.
+	static MemoryAccount* process = new MemoryAccount;
+	return *process;
+}
+
+void MemoryAccount::UpdatePeak( size_t current )
+{
+	size_t peak = _peak.load();
+	while( current > peak && !_peak.compare_exchange_weak( peak, current ) ) {}
+}
+
+// ************************************************************************* //
+bool MemoryAccount::TryCharge( size_t size )
+{
+	// Charge level by level. If one limit is exceeded the levels below are
+	// refunded again. Concurrent charges may fail early, never too late.
+	for( MemoryAccount* account = this; account; account = account->_parent )
+	{
+		size_t current = account->_current.fetch_add( size ) + size;
+		size_t limit = account->_limit.load();
+		if( limit != 0 && current > limit )
+		{
+			account->_current.fetch_sub( size );
+			for( MemoryAccount* charged = this; charged != account; charged = charged->_parent )
+				charged->_current.fetch_sub( size );
+			return false;
+		}
+	}
+	for( MemoryAccount* account = this; account; account = account->_parent )
+		account->UpdatePeak( account->_current.load() );
+	return true;
+}
+
+void MemoryAccount::Charge( size_t size )
+{
+	for( MemoryAccount* account = this; account; account = account->_parent )
+		account->UpdatePeak( account->_current.fetch_add( size ) + size );
+}
+
+void MemoryAccount::Refund( size_t size )
+{
+	for( MemoryAccount* account = this; account; account = account->_parent )
+		account->_current.fetch_sub( size );
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/// \brief Thread safe bookkeeping of the memory which belongs to one owner.
+/// \details Accounts form a tree: the process, the pipelines, their commands
+///		and execution states. Each charge is also charged to all parents, so
+///		a pipeline account contains everything of its commands and states.
+///		A limit on any level makes allocations below it fail instead of
+///		letting the machine swap.
+class MemoryAccount
+{
+	MemoryAccount* _parent;
+	std::atomic<size_t> _current;
+	std::atomic<size_t> _peak;
+	std::atomic<size_t> _limit;		///< 0 means unlimited.
+
+	void UpdatePeak( size_t current );
+
+	// Prevent copy constructor and operator = being generated.
+	MemoryAccount(const MemoryAccount&);
+	MemoryAccount& operator = (const MemoryAccount&);
+public:
+	/// \param [in] parent Account which is charged too or nullptr. It must
+	///		live longer than this one.
+	explicit MemoryAccount( MemoryAccount* parent = nullptr );
+	/// Refunds everything which is still charged from the parents.
+	~MemoryAccount();
+
+	/// \brief Root of all pipeline accounts.
+	static MemoryAccount& GetProcess();
+
+	/// \brief Charge the bytes if neither this account nor a parent would
+	///		exceed its limit.
+	/// \return false if a limit would be exceeded. Nothing is charged then.
+	bool TryCharge( size_t size );
+	/// \brief Charge the bytes regardless of the limits (memory which is
+	///		already allocated or must not fail).
+	void Charge( size_t size );
+	void Refund( size_t size );
+
+	size_t GetCurrent() const	{ return _current.load(); }
+	size_t GetPeak() const		{ return _peak.load(); }
+	/// Start a new peak measurement at the current usage.
+	void ResetPeak()			{ _peak.store( _current.load() ); }
+
+	/// \param [in] limit Maximum of the current bytes, 0 for no limit.
+	void SetLimit( size_t limit )	{ _limit.store( limit ); }
+	size_t GetLimit() const			{ return _limit.load(); }
+};
+
+/// \brief Refunds a successful charge when the scope is left (also by an
+///		exception).
+class ChargeScope
+{
+	MemoryAccount& _account;
+	size_t _size;
+
+	ChargeScope(const ChargeScope&);
+	ChargeScope& operator = (const ChargeScope&);
+public:
+	ChargeScope( MemoryAccount& account, size_t size ) : _account(account), _size(size)	{}
+	~ChargeScope()	{ _account.Refund(_size); }
+};
@@ -1,29 +1,20 @@
 #include <cassert>
 #include "math.hpp"
 #include "Noise.h"
-
-static unsigned int g_uiSeed;
-
-// ************************************************************************* //
-/// \brief Sets a global value for the current noise function.
-///
-void SetSeed( unsigned int _uiSeed )
-{
-	g_uiSeed = _uiSeed;
-}
-
+#include "WorkCounters.hpp"
 
 // ************************************************************************* //
-double Sample1D(int64_t _i)
+double Sample1D(int64_t _i, unsigned int _uiSeed)
 {
-	_i += g_uiSeed;
+	_i += _uiSeed;
 	_i ^= (_i<<13);
 	return (((_i * (_i * _i * 15731 + 789221) + 1376312589) & 0x7fffffff) / 2147483647.0);
 }
 
-double Sample2D(int64_t _x, int64_t _y)
+double Sample2D(int64_t _x, int64_t _y, unsigned int _uiSeed)
 {
-	return Sample1D((_x*57) ^ (_y*101) ^ (_x*_y*17));
+	WORK_COUNT(WORK_LATTICE_HASHES, 1);
+	return Sample1D((_x*57) ^ (_y*101) ^ (_x*_y*17), _uiSeed);
 }
 
 // ************************************************************************* //
@@ -49,7 +40,7 @@ inline void IntFrac(float _f, int& _iInt, float& _fFrac)	{_iInt = Floor(_f); _fF
 
 
 // ************************************************************************* //
-float Rand2D(float _fX, float _fY, float _fFrequence, float& _fOutGradX, float& _fOutGradY)
+float Rand2D(float _fX, float _fY, float _fFrequence, unsigned int _uiSeed, float& _fOutGradX, float& _fOutGradY)
 {
 	// We need 2 samples per dimension -> 4 samples total
 	float fFracX, fFracY;
@@ -57,10 +48,10 @@ float Rand2D(float _fX, float _fY, float _fFrequence, float& _fOutGradX, float&
 	IntFrac(_fX*_fFrequence, iX0, fFracX);
 	IntFrac(_fY*_fFrequence, iY0, fFracY);
 
-	float s00 = (float)Sample2D(iX0  , iY0  );
-	float s10 = (float)Sample2D(iX0+1, iY0  );
-	float s01 = (float)Sample2D(iX0  , iY0+1);
-	float s11 = (float)Sample2D(iX0+1, iY0+1);
+	float s00 = (float)Sample2D(iX0  , iY0  , _uiSeed);
+	float s10 = (float)Sample2D(iX0+1, iY0  , _uiSeed);
+	float s01 = (float)Sample2D(iX0  , iY0+1, _uiSeed);
+	float s11 = (float)Sample2D(iX0+1, iY0+1, _uiSeed);
 
 	float u = InterpolationPolynom(fFracX);
 	float v = InterpolationPolynom(fFracY);
@@ -77,7 +68,7 @@ float Rand2D(float _fX, float _fY, float _fFrequence, float& _fOutGradX, float&
     return k0 + k1*u + k2*v + k4*u*v;
 }
 
-float Rand2DHermite(float _fX, float _fY, float _fFrequence, float& _fOutGradX, float& _fOutGradY)
+float Rand2DHermite(float _fX, float _fY, float _fFrequence, unsigned int _uiSeed, float& _fOutGradX, float& _fOutGradY)
 {
 	// We need 2 samples per dimension -> 4 samples total
 	float u, v;
@@ -85,25 +76,25 @@ float Rand2DHermite(float _fX, float _fY, float _fFrequence, float& _fOutGradX,
 	IntFrac(_fX*_fFrequence, iX0, u);
 	IntFrac(_fY*_fFrequence, iY0, v);
 
-	float s00 = (float)Sample2D(iX0  , iY0  );
-	float s10 = (float)Sample2D(iX0+1, iY0  );
-	float s20 = (float)Sample2D(iX0+2, iY0  );
-	float s30 = (float)Sample2D(iX0+3, iY0  );
+	float s00 = (float)Sample2D(iX0  , iY0  , _uiSeed);
+	float s10 = (float)Sample2D(iX0+1, iY0  , _uiSeed);
+	float s20 = (float)Sample2D(iX0+2, iY0  , _uiSeed);
+	float s30 = (float)Sample2D(iX0+3, iY0  , _uiSeed);
 
-	float s01 = (float)Sample2D(iX0  , iY0+1);
-	float s11 = (float)Sample2D(iX0+1, iY0+1);
-	float s21 = (float)Sample2D(iX0+2, iY0+1);
-	float s31 = (float)Sample2D(iX0+3, iY0+1);
+	float s01 = (float)Sample2D(iX0  , iY0+1, _uiSeed);
+	float s11 = (float)Sample2D(iX0+1, iY0+1, _uiSeed);
+	float s21 = (float)Sample2D(iX0+2, iY0+1, _uiSeed);
+	float s31 = (float)Sample2D(iX0+3, iY0+1, _uiSeed);
 
-	float s02 = (float)Sample2D(iX0  , iY0+2);
-	float s12 = (float)Sample2D(iX0+1, iY0+2);
-	float s22 = (float)Sample2D(iX0+2, iY0+2);
-	float s32 = (float)Sample2D(iX0+3, iY0+2);
+	float s02 = (float)Sample2D(iX0  , iY0+2, _uiSeed);
+	float s12 = (float)Sample2D(iX0+1, iY0+2, _uiSeed);
+	float s22 = (float)Sample2D(iX0+2, iY0+2, _uiSeed);
+	float s32 = (float)Sample2D(iX0+3, iY0+2, _uiSeed);
 
-	float s03 = (float)Sample2D(iX0  , iY0+3);
-	float s13 = (float)Sample2D(iX0+1, iY0+3);
-	float s23 = (float)Sample2D(iX0+2, iY0+3);
-	float s33 = (float)Sample2D(iX0+3, iY0+3);
+	float s03 = (float)Sample2D(iX0  , iY0+3, _uiSeed);
+	float s13 = (float)Sample2D(iX0+1, iY0+3, _uiSeed);
+	float s23 = (float)Sample2D(iX0+2, iY0+3, _uiSeed);
+	float s33 = (float)Sample2D(iX0+3, iY0+3, _uiSeed);
 
 	// the 1/2 is moved to the very out side as 1/2 * 1/2 = 0.25
 	float hu0 = u*((2-u)*u-1);
@@ -132,7 +123,7 @@ float Rand2DHermite(float _fX, float _fY, float _fFrequence, float& _fOutGradX,
 }
 
 
-float Rand2D(int _iLowOctave, int _iHeightOctave, float _fPersistence, float _fX, float _fY, float& _fOutGradX, float& _fOutGradY)
+float Rand2D(int _iLowOctave, int _iHeightOctave, float _fPersistence, float _fX, float _fY, unsigned int _uiSeed, float& _fOutGradX, float& _fOutGradY)
 {
 	// Octaves cannot be smaller than zero and the height octave
 	// must be larger than the low one.
@@ -145,7 +136,7 @@ float Rand2D(int _iLowOctave, int _iHeightOctave, float _fPersistence, float _fX
 	for(int i=_iLowOctave; i<=_iHeightOctave; ++i)
 	{
 		float fGradX, fGradY;
-		fRes += fAmplitude*Rand2DHermite(_fX, _fY, fFrequence, fGradX, fGradY );
+		fRes += fAmplitude*Rand2DHermite(_fX, _fY, fFrequence, _uiSeed, fGradX, fGradY );
 		_fOutGradX += fFrequence*fAmplitude*fGradX;
 		_fOutGradY += fFrequence*fAmplitude*fGradY;
 
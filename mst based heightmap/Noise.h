@@ -3,10 +3,11 @@
 #include <cstdint>
 
 /// \brief Create an integer hash and transform it to [0,1]
-double Sample1D(int64_t _i);
+/// \param _uiSeed [in] Which noise should be sampled.
+double Sample1D(int64_t _i, unsigned int _uiSeed);
 
 /// \brief Create an integer hash from a 2D coordinate
-double Sample2D(int64_t _x, int64_t _y);
+double Sample2D(int64_t _x, int64_t _y, unsigned int _uiSeed);
 
 /// \brief Samples a 2D Value Noise function.
 /// \param _iLowOctave [in] "Frequence" of large scale noise - at least 0.
@@ -23,21 +24,20 @@ float Rand2D( int _iLowOctave,
 			 float _fPersistence,
 			 float _fX,
 			 float _fY,
+			 unsigned int _uiSeed,
 			 float& _fOutGradX,
 			 float& _fOutGradY );
 
-/// \brief Sets a global value for the current noise function.
-///
-void SetSeed( unsigned int _uiSeed );
-
 /// \brief Create a random sample in a 2D pink noise.
 /// \param [in] _fX Sampling position X
 /// \param [in] _fY Sampling position Y
 /// \param [in] _fFrequence The highest frequence of the created noise.
+/// \param [in] _uiSeed Which noise should be sampled.
 /// \param [out] _fOutGradX The analytically computed gradient of the noise.
 /// \param [out] _fOutGradY The analytically computed gradient of the noise.
 /// \return A value in [0,1]
 float Rand2D(float _fX, float _fY,
 			 float _fFrequence,
+			 unsigned int _uiSeed,
 			 float& _fOutGradX,
 			 float& _fOutGradY);
\ No newline at end of file
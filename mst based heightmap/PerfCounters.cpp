@@ -0,0 +1,82 @@
+#include "PerfCounters.hpp"
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/// Number of counters in CounterValues.
+const int NUM_PERF_COUNTERS = 4;
+
+namespace {
+
+/// \brief One group of counters per thread. All counters of the group are
+///		read together with one system call.
+struct ThreadCounters
+{
+	int Files[NUM_PERF_COUNTERS];	///< File descriptor of each counter or -1.
+	int Index[NUM_PERF_COUNTERS];	///< Position of each counter in the group read or -1.
+	int Leader;						///< The first opened counter or -1.
+	int NumOpen;
+
+	ThreadCounters() : Leader(-1), NumOpen(0)
+	{
+		// Same order as in CounterValues.
+		static const uint64_t CONFIGS[NUM_PERF_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+		for( int i=0; i<NUM_PERF_COUNTERS; ++i )
+		{
+			perf_event_attr attributes;
+			memset( &attributes, 0, sizeof(attributes) );
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.size = sizeof(attributes);
+			attributes.config = CONFIGS[i];
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			attributes.read_format = PERF_FORMAT_GROUP;
+			// pid 0, cpu -1: this thread on any CPU.
+			Files[i] = (int)syscall( __NR_perf_event_open, &attributes, 0, -1, Leader, 0 );
+			Index[i] = Files[i] >= 0 ? NumOpen++ : -1;
+			if( Files[i] >= 0 && Leader < 0 ) Leader = Files[i];
+		}
+	}
+
+	~ThreadCounters()
+	{
+		for( int i=0; i<NUM_PERF_COUNTERS; ++i )
+			if( Files[i] >= 0 ) close( Files[i] );
+	}
+
+	bool Read( CounterValues& values ) const
+	{
+		if( Leader < 0 ) return false;
+		// Group format: number of counters followed by the values.
+		uint64_t buffer[1 + NUM_PERF_COUNTERS];
+		if( read( Leader, buffer, sizeof(buffer) ) < ssize_t(sizeof(uint64_t) * (1 + NumOpen)) )
+			return false;
+		uint64_t* fields[NUM_PERF_COUNTERS] = { &values.Cycles, &values.Instructions, &values.CacheMisses, &values.BranchMisses };
+		for( int i=0; i<NUM_PERF_COUNTERS; ++i )
+			*fields[i] = Index[i] >= 0 ? buffer[1 + Index[i]] : 0;
+		return true;
+	}
+};
+
+} // namespace
+
+// ************************************************************************* //
+bool ReadThreadCounters( CounterValues& values )
+{
+	thread_local ThreadCounters counters;
+	return counters.Read( values );
+}
+
+#else
+
+bool ReadThreadCounters( CounterValues& values )
+{
+	values = CounterValues();
+	return false;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+/// \brief Values of the hardware performance counters.
+struct CounterValues
+{
+	uint64_t Cycles;
+	uint64_t Instructions;
+	uint64_t CacheMisses;		///< Last level cache misses.
+	uint64_t BranchMisses;
+
+	CounterValues() : Cycles(0), Instructions(0), CacheMisses(0), BranchMisses(0)	{}
+
+	CounterValues& operator += ( const CounterValues& other )
+	{
+		Cycles += other.Cycles;
+		Instructions += other.Instructions;
+		CacheMisses += other.CacheMisses;
+		BranchMisses += other.BranchMisses;
+		return *this;
+	}
+
+	CounterValues operator - ( const CounterValues& other ) const
+	{
+		CounterValues result;
+		result.Cycles = Cycles - other.Cycles;
+		result.Instructions = Instructions - other.Instructions;
+		result.CacheMisses = CacheMisses - other.CacheMisses;
+		result.BranchMisses = BranchMisses - other.BranchMisses;
+		return result;
+	}
+
+	/// Instructions per cycle or 0 if there were no cycles.
+	double GetIPC() const	{ return Cycles ? double(Instructions) / double(Cycles) : 0.0; }
+};
+
+/// \brief Read the hardware counters of the calling thread (user mode only).
+/// \details Uses perf_event_open on Linux. The counters of a thread are
+///		opened on its first call and closed when the thread ends. Counters
+///		which the CPU or the permissions (perf_event_paranoid) do not allow
+///		stay 0.
+/// \return false if no counter is available (always on other platforms).
+bool ReadThreadCounters( CounterValues& values );
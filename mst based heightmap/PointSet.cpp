@@ -0,0 +1,56 @@
+#include <cassert>
+#include <cstdio>
+#include "PointSet.hpp"
+
+// ************************************************************************* //
+PointSet::PointSet() :
+	_points(nullptr),
+	_numPoints(0)
+{
+}
+
+PointSet::PointSet( std::vector<Vec3>&& points ) :
+	_decoded(std::move(points))
+{
+	_points = _decoded.empty() ? nullptr : _decoded.data();
+	_numPoints = int(_decoded.size());
+}
+
+PointSet::~PointSet()
+{
+}
+
+// ************************************************************************* //
+bool PointSet::MapFile( const std::string& fileName )
+{
+	_decoded.clear();
+	_points = nullptr;
+	_numPoints = 0;
+
+	if( !_file.Open( fileName ) ) return false;
+	const PointSetFileHeader* header = (const PointSetFileHeader*)_file.GetData();
+	if( _file.GetSize() < sizeof(PointSetFileHeader)
+		|| header->Magic != POINT_SET_MAGIC || header->Version != POINT_SET_VERSION
+		|| (_file.GetSize() - sizeof(PointSetFileHeader)) / sizeof(Vec3) < header->NumPoints )
+	{
+		_file.Close();
+		return false;
+	}
+	_points = (const Vec3*)(header + 1);
+	_numPoints = int(header->NumPoints);
+	return true;
+}
+
+// ************************************************************************* //
+bool PointSet::Save( const std::string& fileName ) const
+{
+	static_assert( sizeof(Vec3) == 12, "The file format expects packed float triples." );
+	FILE* file = fopen( fileName.c_str(), "wb" );
+	if( !file ) return false;
+	PointSetFileHeader header = { POINT_SET_MAGIC, POINT_SET_VERSION, uint32_t(_numPoints), 0 };
+	bool success = fwrite( &header, sizeof(header), 1, file ) == 1;
+	if( _numPoints > 0 )
+		success &= fwrite( _points, sizeof(Vec3), _numPoints, file ) == size_t(_numPoints);
+	success &= fclose( file ) == 0;
+	return success;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+#include "math.hpp"
+
+/// Magic number at the begin of a binary point set file ("MSTP").
+const uint32_t POINT_SET_MAGIC = 0x5054534d;
+/// Current version of the binary point set format.
+const uint32_t POINT_SET_VERSION = 1;
+
+/// \brief Header of the binary point set format.
+/// \details The file consists of this header followed by NumPoints x, y, z
+///		triples of 32 bit floats (little endian). The header size is a
+///		multiple of 16 so a mapped file can be used without any copy.
+struct PointSetFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t NumPoints;
+	uint32_t Reserved;
+};
+
+/// \brief An immutable list of points shared by all commands which use it.
+/// \details The points are either decoded from a script into owned memory
+///		or a read only view into a memory mapped binary file.
+class PointSet
+{
+	std::vector<Vec3> _decoded;		///< Storage of points which come from a script.
+	const Vec3* _points;			///< Either _decoded or a pointer into the mapped file.
+	int _numPoints;
+
+	MappedFile _file;				///< Source of points from a binary file.
+
+	// Prevent copy constructor and operator = being generated.
+	PointSet(const PointSet&);
+	PointSet& operator = (const PointSet&);
+public:
+	/// Empty point set.
+	PointSet();
+
+	/// \brief Take the points without any copy.
+	PointSet( std::vector<Vec3>&& points );
+
+	~PointSet();
+
+	/// \brief Map a binary point set file.
+	/// \return false if the file does not exist or has a wrong format.
+	///		The point set is empty then.
+	bool MapFile( const std::string& fileName );
+
+	/// \brief Write the points in the binary point set format.
+	bool Save( const std::string& fileName ) const;
+
+	const Vec3* GetPoints() const	{ return _points; }
+	int GetNumPoints() const		{ return _numPoints; }
+	/// Memory of decoded points. Mapped files are not counted.
+	size_t GetOwnedBytes() const	{ return _decoded.capacity() * sizeof(Vec3); }
+	const Vec3& operator [] ( int index ) const	{ return _points[index]; }
+};
@@ -0,0 +1,239 @@
+#include "Stdafx.h"
+#include "CommandBuffer.hpp"
+#include "JsonStream.hpp"
+#include "PointSet.hpp"
+#include "json-parser/json.h"
+
+// ************************************************************************* //
+/// \brief Builds the jsoncpp tree of a script from the events of the
+///		streaming parser.
+/// \details Arrays with the key "Points" inside a "PointSet" object are not
+///		put into the tree. Their points are decoded directly into a PointSet
+///		and the tree gets the index of the set instead.
+class ScriptBuilder : public JsonHandler
+{
+	Json::Value& _root;
+	std::vector<std::shared_ptr<const PointSet> >& _pointSets;
+
+	/// Open objects/arrays and the key under which each was opened.
+	struct Container
+	{
+		Json::Value* Value;
+		std::string Key;
+	};
+	std::vector<Container> _stack;
+	std::string _key;				///< The last key in the innermost object.
+
+	// State of the point decoding
+	enum struct PointState { NONE, NEXT, SET, POINT };
+	PointState _pointState;
+	std::vector<Vec3> _points;
+	float _coordinates[3];
+	int _numCoordinates;
+	int _skipDepth;					///< Nesting level of an unexpected object/array in a point set.
+
+	/// Insert a value at the current position of the tree.
+	Json::Value& Add( const Json::Value& value )
+	{
+		if( _stack.empty() )
+			return _root = value;
+		Json::Value& parent = *_stack.back().Value;
+		if( parent.isArray() )
+			return parent.append( value );
+		return parent[_key] = value;
+	}
+
+	bool Open( const Json::Value& empty )
+	{
+		Container container;
+		container.Key = _stack.empty() || _stack.back().Value->isArray() ? std::string() : _key;
+		container.Value = &Add( empty );
+		_stack.push_back( container );
+		return true;
+	}
+
+	/// A scalar or a skipped container inside the point array.
+	void Element()
+	{
+		if( _pointState == PointState::POINT )
+		{
+			if( _numCoordinates < 3 ) _coordinates[_numCoordinates] = 0.0f;
+			++_numCoordinates;
+		} else
+			// Points which are no array have no coordinates.
+			_points.push_back( Vec3(0.0f, 0.0f, 0.0f) );
+	}
+
+	bool IsInPointSet() const	{ return _pointState == PointState::SET || _pointState == PointState::POINT; }
+
+public:
+	ScriptBuilder( Json::Value& root, std::vector<std::shared_ptr<const PointSet> >& pointSets ) :
+		_root(root),
+		_pointSets(pointSets),
+		_pointState(PointState::NONE),
+		_numCoordinates(0),
+		_skipDepth(0)
+	{}
+
+	virtual bool BeginObject() override
+	{
+		if( IsInPointSet() ) { ++_skipDepth; return true; }
+		_pointState = PointState::NONE;
+		return Open( Json::Value(Json::objectValue) );
+	}
+
+	virtual bool Key( const char* string, size_t length ) override
+	{
+		if( _skipDepth ) return true;
+		_key.assign( string, length );
+		// Decode the next value as points if it is an array.
+		_pointState = (_key == "Points" && _stack.size() >= 1 && _stack.back().Key == "PointSet")
+			? PointState::NEXT : PointState::NONE;
+		return true;
+	}
+
+	virtual bool EndObject() override
+	{
+		if( _skipDepth )
+		{
+			if( --_skipDepth == 0 ) Element();
+			return true;
+		}
+		_stack.pop_back();
+		return true;
+	}
+
+	virtual bool BeginArray() override
+	{
+		if( _skipDepth ) { ++_skipDepth; return true; }
+		switch( _pointState )
+		{
+		case PointState::NEXT:
+			_pointState = PointState::SET;
+			_points.clear();
+			return true;
+		case PointState::SET:
+			_pointState = PointState::POINT;
+			_numCoordinates = 0;
+			return true;
+		case PointState::POINT:
+			++_skipDepth;
+			return true;
+		default:
+			return Open( Json::Value(Json::arrayValue) );
+		}
+	}
+
+	virtual bool EndArray() override
+	{
+		if( _skipDepth )
+		{
+			if( --_skipDepth == 0 ) Element();
+			return true;
+		}
+		switch( _pointState )
+		{
+		case PointState::POINT:
+			// Like before: points without exactly three coordinates are zero.
+			if( _numCoordinates == 3 )
+				_points.push_back( Vec3(_coordinates[0], _coordinates[1], _coordinates[2]) );
+			else _points.push_back( Vec3(0.0f, 0.0f, 0.0f) );
+			_pointState = PointState::SET;
+			return true;
+		case PointState::SET:
+			_pointSets.push_back( std::make_shared<PointSet>(std::move(_points)) );
+			_points = std::vector<Vec3>();
+			Add( Json::Value(Json::UInt(_pointSets.size() - 1)) );
+			_pointState = PointState::NONE;
+			return true;
+		default:
+			_stack.pop_back();
+			return true;
+		}
+	}
+
+	virtual bool String( const char* string, size_t length ) override
+	{
+		if( _skipDepth ) return true;
+		if( IsInPointSet() ) { Element(); return true; }
+		_pointState = PointState::NONE;
+		Add( Json::Value(string, string + length) );
+		return true;
+	}
+
+	virtual bool Number( double value, bool isInteger ) override
+	{
+		if( _skipDepth ) return true;
+		if( _pointState == PointState::POINT )
+		{
+			if( _numCoordinates < 3 ) _coordinates[_numCoordinates] = float(value);
+			++_numCoordinates;
+			return true;
+		}
+		if( _pointState == PointState::SET ) { Element(); return true; }
+		_pointState = PointState::NONE;
+		// Keep integers as integers (asInt/asString behave as with jsoncpp).
+		if( isInteger && value >= -2147483648.0 && value <= 2147483647.0 )
+			Add( Json::Value(Json::Int(value)) );
+		else Add( Json::Value(value) );
+		return true;
+	}
+
+	virtual bool Bool( bool value ) override
+	{
+		if( _skipDepth ) return true;
+		if( IsInPointSet() ) { Element(); return true; }
+		_pointState = PointState::NONE;
+		Add( Json::Value(value) );
+		return true;
+	}
+
+	virtual bool Null() override
+	{
+		if( _skipDepth ) return true;
+		if( IsInPointSet() ) { Element(); return true; }
+		_pointState = PointState::NONE;
+		Add( Json::Value() );
+		return true;
+	}
+};
+
+// ************************************************************************* //
+bool GeneratorPipeline::ParseScript( const std::string& jsonCode, Json::Value& root )
+{
+	ScriptBuilder builder( root, _pointSets );
+	return ParseJsonStream( jsonCode.data(), jsonCode.data() + jsonCode.size(), builder );
+}
+
+// ************************************************************************* //
+std::shared_ptr<const PointSet> GeneratorPipeline::LoadPointSet( const Json::Value& commandInfo )
+{
+	const Json::Value& pointSet = commandInfo["PointSet"];
+	if( pointSet.isObject() )
+	{
+		// A binary sidecar file is mapped without any copy.
+		if( pointSet.isMember("File") )
+		{
+			std::shared_ptr<PointSet> points = std::make_shared<PointSet>();
+			bool isMapped = points->MapFile( pointSet["File"].asString() );
+			assert( isMapped && "Cannot read the point set file." );
+			_isValid &= isMapped;
+			// Snapshots depend on the file content too.
+			uint64_t fileHash = OrE::Algorithm::CreateHash64( points->GetPoints(), size_t(points->GetNumPoints()) * sizeof(Vec3) );
+			_contentHash = (_contentHash * 0x00000100000001b3ULL) ^ fileHash;
+			return points;
+		}
+		// Index of a set which was decoded by the ScriptBuilder
+		const Json::Value& index = pointSet["Points"];
+		if( index.isIntegral() && index.asUInt() < _pointSets.size() )
+			return _pointSets[index.asUInt()];
+	}
+	// Anything else (e.g. a bare point array) is malformed. Only a missing
+	// point set is accepted as an empty one.
+	if( !pointSet.isNull() )
+	{
+		assert( false && "Invalid point set." );
+		_isValid = false;
+	}
+	return std::make_shared<PointSet>();
+}
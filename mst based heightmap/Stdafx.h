@@ -3,7 +3,9 @@
 // but are changed infrequently
 
 #pragma once
+#ifdef _MSC_VER
 #pragma unmanaged
+#endif
 
 #include <memory>
 #include <stdint.h>
@@ -13,11 +15,14 @@
 
 // Stuff copied from OrBaseLib
 #include "src-mst/OrADTObjects.h"
+#include "src-mst/OrArena.h"
 #include "src-mst/OrHeap.h"
 #include "src-mst/OrHash.h"
 #include "src-mst/OrGraph.h"
 
-#ifdef DLL
+#if !defined(_WIN32)
+#define CPP_DLL __attribute__((visibility("default")))
+#elif defined(DLL)
 #define CPP_DLL __declspec(dllexport)
 #else
 #define CPP_DLL __declspec(dllimport)
@@ -0,0 +1,51 @@
+#include "Storage.h"
+
+// ************************************************************************* //
+void DecodeLine( const void* buffer, const StorageDesc& storage, size_t offset, int count, float* out )
+{
+	if( !buffer )
+	{
+		for( int i=0; i<count; ++i ) out[i] = 0.0f;
+		return;
+	}
+
+	switch( storage.Format )
+	{
+	case StorageFormat::FLOAT:
+		memcpy( out, (const float*)buffer + offset, count * sizeof(float) );
+		break;
+	case StorageFormat::HALF: {
+		const uint16_t* in = (const uint16_t*)buffer + offset;
+		for( int i=0; i<count; ++i ) out[i] = HalfToFloat(in[i]);
+		break; }
+	case StorageFormat::UNORM16: {
+		const uint16_t* in = (const uint16_t*)buffer + offset;
+		float scale = storage.Scale / 65535.0f;
+		for( int i=0; i<count; ++i ) out[i] = storage.Offset + in[i] * scale;
+		break; }
+	}
+}
+
+void EncodeLine( void* buffer, const StorageDesc& storage, size_t offset, int count, const float* values )
+{
+	switch( storage.Format )
+	{
+	case StorageFormat::FLOAT:
+		memcpy( (float*)buffer + offset, values, count * sizeof(float) );
+		break;
+	case StorageFormat::HALF: {
+		uint16_t* out = (uint16_t*)buffer + offset;
+		for( int i=0; i<count; ++i ) out[i] = FloatToHalf(values[i]);
+		break; }
+	case StorageFormat::UNORM16: {
+		uint16_t* out = (uint16_t*)buffer + offset;
+		float scale = 65535.0f / storage.Scale;
+		for( int i=0; i<count; ++i )
+		{
+			float u = (values[i] - storage.Offset) * scale;
+			u = u < 0.0f ? 0.0f : (u > 65535.0f ? 65535.0f : u);
+			out[i] = uint16_t(u + 0.5f);
+		}
+		break; }
+	}
+}
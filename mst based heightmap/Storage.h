@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/// Element formats for intermediate map buffers.
+enum struct StorageFormat
+{
+	FLOAT,			///< 32 bit float (default and always used for the final result)
+	HALF,			///< IEEE 754 half precision float
+	UNORM16			///< 16 bit fixed point within a given value range
+};
+
+/// \brief Format and value mapping of a map buffer.
+/// \details For UNORM16 a value is stored as (v - Offset) / Scale in [0,1].
+///		Values outside the range are clamped.
+struct StorageDesc
+{
+	StorageFormat Format;
+	float Offset;
+	float Scale;
+
+	StorageDesc() : Format(StorageFormat::FLOAT), Offset(0.0f), Scale(1.0f) {}
+	StorageDesc( StorageFormat format, float offset = 0.0f, float scale = 1.0f ) : Format(format), Offset(offset), Scale(scale) {}
+
+	/// Bytes per pixel
+	int ElementSize() const		{ return Format == StorageFormat::FLOAT ? 4 : 2; }
+};
+
+// ************************************************************************* //
+/// Round to nearest even conversion of a float to half precision.
+inline uint16_t FloatToHalf( float value )
+{
+	uint32_t x;	memcpy(&x, &value, 4);
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t abs = x & 0x7fffffff;
+	// Overflow, infinity and NaN
+	if( abs >= 0x47800000 )
+		return uint16_t(sign | (abs > 0x7f800000 ? 0x7e00 : 0x7c00));
+	// Denormalized result: the float unit does the rounding.
+	if( abs < 0x38800000 )
+	{
+		float a;	memcpy(&a, &abs, 4);
+		return uint16_t(sign | uint32_t(a * 16777216.0f + 0.5f));
+	}
+	// Rebias the exponent and round the mantissa (ties to even).
+	abs += 0xc8000fff + ((abs >> 13) & 1);
+	return uint16_t(sign | (abs >> 13));
+}
+
+inline float HalfToFloat( uint16_t value )
+{
+	uint32_t sign = uint32_t(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+	if( exponent == 0 )
+	{
+		float f = mantissa * (1.0f / 16777216.0f);
+		uint32_t x;	memcpy(&x, &f, 4);
+		x |= sign;
+		memcpy(&f, &x, 4);
+		return f;
+	}
+	uint32_t x = exponent == 31 ? (sign | 0x7f800000 | (mantissa << 13))
+								: (sign | ((exponent + 112) << 23) | (mantissa << 13));
+	float f;	memcpy(&f, &x, 4);
+	return f;
+}
+
+// ************************************************************************* //
+/// \brief Convert count elements starting at element offset of a buffer to
+///		float. A nullptr buffer is decoded as zeros.
+void DecodeLine( const void* buffer, const StorageDesc& storage, size_t offset, int count, float* out );
+
+/// \brief Convert count floats to the storage format and write them at
+///		element offset of the buffer.
+void EncodeLine( void* buffer, const StorageDesc& storage, size_t offset, int count, const float* values );
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include "ThreadPool.hpp"
+
+namespace {
+	/// Index of the thread in the pool, 0 for all threads which are no worker.
+	thread_local int t_threadIndex = 0;
+	/// Trace of the task which currently runs on the thread.
+	thread_local TaskTrace* t_trace = nullptr;
+	/// Control of the task which currently runs on the thread.
+	thread_local TaskControl* t_control = nullptr;
+	/// Number of tasks which currently run nested on the thread.
+	thread_local int t_depth = 0;
+	/// Tag of the task which currently runs on the thread.
+	thread_local int t_tag = -1;
+	/// Group of the task which currently runs on the thread.
+	thread_local TaskGroup* t_group = nullptr;
+	/// Sum of the counters of all finished tasks per nesting depth. A task
+	///	subtracts the counters of the tasks nested in it.
+	thread_local std::vector<CounterValues> t_nestedCounters;
+
+	/// Counters of the task at the given depth including nested tasks.
+	bool ReadCounters( int depth, CounterValues& values )
+	{
+		if( t_nestedCounters.size() <= size_t(depth+1) )
+			t_nestedCounters.resize( depth+2 );
+		t_nestedCounters[depth+1] = CounterValues();
+		return ReadThreadCounters( values );
+	}
+
+	/// Execute a task and append its interval to the trace.
+	void RunTraced( const std::function<void()>& function, TaskTrace& trace, int depth )
+	{
+		CounterValues begin, end;
+		bool hasCounters = trace.UseCounters && ReadCounters( depth, begin );
+		double beginTime = trace.GetTime();
+		function();
+		TaskTrace::Interval interval = { t_threadIndex, depth, t_tag, beginTime, trace.GetTime(), CounterValues() };
+		if( hasCounters && ReadThreadCounters( end ) )
+		{
+			CounterValues inclusive = end - begin;
+			interval.Counters = inclusive - t_nestedCounters[depth+1];
+			t_nestedCounters[depth] += inclusive;
+		}
+		std::lock_guard<std::mutex> guard(trace.Lock);
+		trace.Intervals.push_back( interval );
+	}
+}
+
+// ************************************************************************* //
+ThreadPool::ThreadPool( int numWorkers ) :
+	_numSleepingWaiters(0),
+	_shutdown(false)
+{
+	StartWorkers( numWorkers );
+}
+
+ThreadPool::~ThreadPool()
+{
+	StopWorkers();
+}
+
+void ThreadPool::StartWorkers( int numWorkers )
+{
+	_shutdown = false;
+	for( int i=0; i<numWorkers; ++i )
+		_workers.push_back( std::thread(&ThreadPool::WorkerLoop, this, i+1) );
+}
+
+void ThreadPool::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		_shutdown = true;
+	}
+	_changed.notify_all();
+	for( size_t i=0; i<_workers.size(); ++i )
+		_workers[i].join();
+	_workers.clear();
+}
+
+void ThreadPool::SetNumThreads( int numThreads )
+{
+	StopWorkers();
+	StartWorkers( std::max(1, numThreads) - 1 );
+}
+
+int ThreadPool::GetThreadIndex()
+{
+	return t_threadIndex;
+}
+
+TaskTrace* ThreadPool::SetTrace( TaskTrace* trace )
+{
+	TaskTrace* previous = t_trace;
+	t_trace = trace;
+	return previous;
+}
+
+TaskControl* ThreadPool::SetControl( TaskControl* control )
+{
+	TaskControl* previous = t_control;
+	t_control = control;
+	return previous;
+}
+
+TaskControl* ThreadPool::GetControl()
+{
+	return t_control;
+}
+
+void ThreadPool::SetTaskTag( int tag )
+{
+	t_tag = tag;
+}
+
+int ThreadPool::GetTaskTag()
+{
+	return t_tag;
+}
+
+ThreadPool& ThreadPool::Get()
+{
+	// Never destroyed: joining threads during the static destruction (DLL
+	// unload) can dead lock. The OS ends the workers with the process.
+	static ThreadPool* pool = new ThreadPool( std::max(1u, std::thread::hardware_concurrency()) - 1 );
+	return *pool;
+}
+
+// ************************************************************************* //
+void ThreadPool::RunOne( std::unique_lock<std::mutex>& lock, std::deque<Task>::iterator queued )
+{
+	Task task = std::move(*queued);
+	_queue.erase( queued );
+	lock.unlock();
+	TaskGroup* outerGroup = t_group;
+	t_group = task.Group;
+	TaskTrace* outerTrace = SetTrace( task.Trace );
+	TaskControl* outerControl = SetControl( task.Control );
+	int outerTag = t_tag;
+	t_tag = task.Tag;
+	int depth = t_depth++;
+	CounterValues begin, end;
+	// The exception is passed to the waiting thread. The bookkeeping below
+	// must happen in any case, otherwise Wait never returns.
+	std::exception_ptr exception;
+	try {
+		if( task.Trace )
+			RunTraced( task.Function, *task.Trace, depth );
+		else if( outerTrace && outerTrace->UseCounters && ReadCounters( depth, begin ) )
+		{
+			// A foreign task inside a traced one: its counters must not be
+			// attributed to the outer task.
+			task.Function();
+			if( ReadThreadCounters( end ) )
+				t_nestedCounters[depth] += end - begin;
+		} else
+			task.Function();
+	} catch( ... ) {
+		exception = std::current_exception();
+	}
+	--t_depth;
+	t_tag = outerTag;
+	SetControl( outerControl );
+	SetTrace( outerTrace );
+	t_group = outerGroup;
+	lock.lock();
+	if( exception && !task.Group->_exception )
+		task.Group->_exception = exception;
+	// The last task of a group wakes the waiting thread.
+	if( --task.Group->_pending == 0 )
+		_changed.notify_all();
+}
+
+void ThreadPool::WorkerLoop( int threadIndex )
+{
+	t_threadIndex = threadIndex;
+	std::unique_lock<std::mutex> lock(_lock);
+	while( !_shutdown )
+	{
+		if( _queue.empty() )
+			_changed.wait(lock);
+		else RunOne(lock, _queue.begin());
+	}
+}
+
+std::deque<ThreadPool::Task>::iterator ThreadPool::FindTask( const TaskGroup& group )
+{
+	for( auto it = _queue.begin(); it != _queue.end(); ++it )
+	{
+		// The ancestors of a queued task wait for it, so they still exist.
+		for( const TaskGroup* ancestor = it->Group; ancestor; ancestor = ancestor->_parent )
+			if( ancestor == &group )
+				return it;
+	}
+	return _queue.end();
+}
+
+// ************************************************************************* //
+void ThreadPool::Submit( TaskGroup& group, std::function<void()> task )
+{
+	bool wakeAll;
+	{
+		std::lock_guard<std::mutex> guard(_lock);
+		++group._pending;
+		// Tasks of a group may submit more tasks to it (the pipeline graph).
+		if( t_group != &group )
+			group._parent = t_group;
+		Task t = { std::move(task), &group, t_trace, t_control, t_tag };
+		_queue.push_back( std::move(t) );
+		wakeAll = _numSleepingWaiters > 0;
+	}
+	if( wakeAll ) _changed.notify_all();
+	else _changed.notify_one();
+}
+
+void ThreadPool::Wait( TaskGroup& group )
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	while( group._pending > 0 )
+	{
+		auto task = FindTask( group );
+		if( task == _queue.end() )
+		{
+			// The remaining tasks run on other threads or are not queued yet.
+			++_numSleepingWaiters;
+			_changed.wait(lock);
+			--_numSleepingWaiters;
+		} else RunOne(lock, task);
+	}
+	if( group._exception )
+	{
+		std::exception_ptr exception = group._exception;
+		group._exception = nullptr;
+		std::rethrow_exception( exception );
+	}
+}
\ No newline at end of file
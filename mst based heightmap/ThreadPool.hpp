@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "PerfCounters.hpp"
+
+/// \brief Counter of unfinished tasks which were submitted together.
+/// \details Only the pool changes the counter (under its lock).
+class TaskGroup
+{
+	int _pending;
+	/// Group of the task which submitted to this group or nullptr.
+	TaskGroup* _parent;
+	/// First exception of a task, rethrown by ThreadPool::Wait.
+	std::exception_ptr _exception;
+	friend class ThreadPool;
+public:
+	TaskGroup() : _pending(0), _parent(nullptr)	{}
+};
+
+/// \brief Records when and on which thread tasks run.
+/// \details Tasks inherit the trace of the thread which submits them. So
+///		everything a traced task starts (e.g. the blocks of GenerateLines)
+///		is recorded as well.
+struct TaskTrace
+{
+	struct Interval
+	{
+		int Thread;			///< ThreadPool::GetThreadIndex() of the executing thread.
+		int Depth;			///< Number of tasks this one is nested in on the same thread.
+		int Tag;			///< See ThreadPool::SetTaskTag.
+		double BeginMs;		///< Relative to Start.
+		double EndMs;
+		/// Hardware counters of the task without the tasks nested in it.
+		CounterValues Counters;
+	};
+	std::chrono::steady_clock::time_point Start;
+	bool UseCounters;		///< Read the hardware counters around each task (ReadThreadCounters).
+	std::mutex Lock;
+	std::vector<Interval> Intervals;
+
+	TaskTrace() : Start(std::chrono::steady_clock::now()), UseCounters(false)	{}
+
+	/// Milliseconds since Start.
+	double GetTime() const	{ return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count(); }
+};
+
+/// \brief Cooperative cancellation and progress of a group of tasks.
+/// \details Tasks inherit the control of the thread which submits them like
+///		a trace. GenerateLines checks it between its blocks.
+struct TaskControl
+{
+	std::atomic<bool> IsCancelled;
+	/// Called after each finished block of GenerateLines with the tag of
+	///	the task (see ThreadPool::SetTaskTag) and the finished fraction of
+	///	the lines. Runs concurrently on the pool threads. May be empty.
+	std::function<void(int tag, float fraction)> OnBlockFinished;
+
+	TaskControl() : IsCancelled(false)	{}
+};
+
+/// \brief Persistent worker threads for all parallel work of the library.
+/// \details There is one global pool with hardware_concurrency-1 workers.
+///		The thread which waits for a group executes queued tasks of this
+///		group or of groups which its tasks submitted to (recursively)
+///		meanwhile. So tasks may submit and wait for other tasks without
+///		blocking a worker - e.g. a command which runs as task of the pipeline
+///		graph calls GenerateLines. Unrelated tasks are not started by a
+///		waiting thread, so the stack and the state of a waiting task do not
+///		grow with the number of queued tasks.
+class ThreadPool
+{
+	struct Task
+	{
+		std::function<void()> Function;
+		TaskGroup* Group;
+		TaskTrace* Trace;		///< Trace of the submitting thread or nullptr.
+		TaskControl* Control;	///< Control of the submitting thread or nullptr.
+		int Tag;				///< Tag of the submitting thread.
+	};
+
+	std::vector<std::thread> _workers;
+	std::deque<Task> _queue;
+	std::mutex _lock;
+	/// Signaled if a task was added or finished.
+	std::condition_variable _changed;
+	/// Number of threads in Wait which sleep on _changed. They might not be
+	///	able to execute a new task, so all threads are woken up then.
+	int _numSleepingWaiters;
+	bool _shutdown;
+
+	void WorkerLoop( int threadIndex );
+	void StartWorkers( int numWorkers );
+	void StopWorkers();
+	/// Execute and remove a queued task. The lock is released during the
+	///	execution.
+	void RunOne( std::unique_lock<std::mutex>& lock, std::deque<Task>::iterator task );
+	/// The oldest queued task of the group or its descendants or _queue.end().
+	std::deque<Task>::iterator FindTask( const TaskGroup& group );
+
+	// Prevent copy constructor and operator = being generated.
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator = (const ThreadPool&);
+public:
+	/// \param [in] numWorkers Number of additional threads. The waiting
+	///		thread is always the last worker.
+	ThreadPool( int numWorkers );
+	~ThreadPool();
+
+	/// \brief The pool used by GenerateLines and the pipeline.
+	static ThreadPool& Get();
+
+	/// \brief Number of threads which execute tasks (workers + caller).
+	int GetNumThreads() const		{ return int(_workers.size()) + 1; }
+
+	/// \brief Index of the calling thread: 1 to GetNumThreads()-1 for the
+	///		workers and 0 for all other threads.
+	static int GetThreadIndex();
+
+	/// \brief Record all tasks which the calling thread submits from now on.
+	/// \param [in] trace The new trace of the thread or nullptr.
+	/// \return The previous trace of the thread.
+	static TaskTrace* SetTrace( TaskTrace* trace );
+
+	/// \brief Control all tasks which the calling thread submits from now on.
+	/// \return The previous control of the thread.
+	static TaskControl* SetControl( TaskControl* control );
+	/// \brief Control of the task which runs on the calling thread or nullptr.
+	static TaskControl* GetControl();
+
+	/// \brief Label the task which runs on the calling thread, e.g. with
+	///		the command it executes. The interval of the task in the trace
+	///		gets the tag the thread has when the task ends. Tasks inherit
+	///		the tag of the thread which submits them.
+	static void SetTaskTag( int tag );
+	static int GetTaskTag();
+
+	/// \brief Restart the pool with a different number of threads
+	///		(workers + caller, at least 1).
+	/// \details Must not be called while tasks are queued or running.
+	void SetNumThreads( int numThreads );
+
+	/// \brief Enqueue a task. It might be started immediately.
+	void Submit( TaskGroup& group, std::function<void()> task );
+
+	/// \brief Block until all tasks of the group are finished and help
+	///		executing queued tasks of the group (or of groups its tasks
+	///		submitted to) in the meantime.
+	/// \details If a task threw an exception the first one is rethrown
+	///		after all tasks of the group are finished.
+	void Wait( TaskGroup& group );
+};
\ No newline at end of file
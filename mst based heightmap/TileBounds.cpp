@@ -0,0 +1,56 @@
+#include <limits>
+#include "CommandInfo.h"
+#include "math.hpp"
+
+// ************************************************************************* //
+void TileBounds::SetSize( const MapBufferInfo& bufferInfo )
+{
+	NumTilesX = (bufferInfo.GetSamplesX() + BOUNDS_TILE_SIZE - 1) / BOUNDS_TILE_SIZE;
+	NumTilesY = (bufferInfo.GetSamplesY() + BOUNDS_TILE_SIZE - 1) / BOUNDS_TILE_SIZE;
+}
+
+void TileBounds::GetWorldRect( const MapBufferInfo& bufferInfo, int tileX, int tileY, float* rect )
+{
+	// Same coordinates as the kernels: sample * stride * PixelSize
+	int lastX = min( int(bufferInfo.GetSamplesX()), (tileX+1) * BOUNDS_TILE_SIZE ) - 1;
+	int lastY = min( int(bufferInfo.GetSamplesY()), (tileY+1) * BOUNDS_TILE_SIZE ) - 1;
+	float scale = bufferInfo.SampleStride * bufferInfo.PixelSize;
+	rect[0] = tileX * BOUNDS_TILE_SIZE * scale;
+	rect[1] = tileY * BOUNDS_TILE_SIZE * scale;
+	rect[2] = lastX * scale;
+	rect[3] = lastY * scale;
+}
+
+void TileBounds::Quantize( const StorageDesc& storage )
+{
+	if( storage.Format == StorageFormat::FLOAT ) return;
+	// Rounding and clamping are monotone, so the rounded bounds still
+	// contain all rounded values. Constant tiles stay constant.
+	float buffer[2];
+	for( int t=0; t<GetNumTiles(); ++t )
+	{
+		buffer[0] = Tiles[t].Min;
+		buffer[1] = Tiles[t].Max;
+		float encoded[2];
+		EncodeLine( encoded, storage, 0, 2, buffer );
+		DecodeLine( encoded, storage, 0, 2, buffer );
+		Tiles[t].Min = buffer[0];
+		Tiles[t].Max = buffer[1];
+	}
+}
+
+ValueRange TileBounds::Unbounded()
+{
+	ValueRange range;
+	range.Min = -std::numeric_limits<float>::infinity();
+	range.Max = std::numeric_limits<float>::infinity();
+	return range;
+}
+
+void TileBounds::Widen( ValueRange& range )
+{
+	// The kernels round after each operation: a few ulps of the magnitude.
+	float margin = 1e-5f * (fabsf(range.Min) + fabsf(range.Max)) + std::numeric_limits<float>::min();
+	range.Min -= margin;
+	range.Max += margin;
+}
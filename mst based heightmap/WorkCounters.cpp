@@ -0,0 +1,126 @@
+#include "WorkCounters.hpp"
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// ************************************************************************* //
+void WorkStats::Clear()
+{
+	memset( Total, 0, sizeof(Total) );
+	memset( Pixels, 0, sizeof(Pixels) );
+	memset( Histogram, 0, sizeof(Histogram) );
+}
+
+void WorkStats::Merge( const WorkStats& other )
+{
+	for( int c=0; c<NUM_WORK_COUNTERS; ++c )
+	{
+		Total[c] += other.Total[c];
+		Pixels[c] += other.Pixels[c];
+		for( int b=0; b<WORK_HISTOGRAM_SIZE; ++b )
+			Histogram[c][b] += other.Histogram[c][b];
+	}
+}
+
+const char* WorkStats::GetName( int counter )
+{
+	static const char* NAMES[NUM_WORK_COUNTERS] = { "mst_segments", "rbf_nodes", "lattice_hashes", "points_scanned" };
+	return counter >= 0 && counter < NUM_WORK_COUNTERS ? NAMES[counter] : "";
+}
+
+#if MST_WORK_COUNTERS
+
+namespace {
+
+/// \brief Counters of all living threads and of the finished ones.
+struct WorkRegistry
+{
+	std::mutex Lock;
+	std::vector<ThreadWorkCounters*> Threads;
+	WorkStats Finished;
+};
+
+WorkRegistry& GetRegistry()
+{
+	// Never destroyed: threads may end during the static destruction.
+	static WorkRegistry* registry = new WorkRegistry;
+	return *registry;
+}
+
+} // namespace
+
+// ************************************************************************* //
+ThreadWorkCounters::ThreadWorkCounters()
+{
+	memset( Pixel, 0, sizeof(Pixel) );
+	WorkRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock( registry.Lock );
+	registry.Threads.push_back( this );
+}
+
+ThreadWorkCounters::~ThreadWorkCounters()
+{
+	WorkRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock( registry.Lock );
+	registry.Finished.Merge( Stats );
+	for( size_t i=0; i<registry.Threads.size(); ++i )
+		if( registry.Threads[i] == this )
+		{
+			registry.Threads.erase( registry.Threads.begin() + i );
+			break;
+		}
+}
+
+void ThreadWorkCounters::EndPixel()
+{
+	for( int c=0; c<NUM_WORK_COUNTERS; ++c )
+	{
+		uint64_t work = Pixel[c];
+		if( work == 0 ) continue;
+		int bucket = 0;
+		while( bucket < WORK_HISTOGRAM_SIZE-1 && (work >> (bucket+1)) != 0 )
+			++bucket;
+		Stats.Total[c] += work;
+		++Stats.Pixels[c];
+		++Stats.Histogram[c][bucket];
+		Pixel[c] = 0;
+	}
+}
+
+ThreadWorkCounters& GetThreadWorkCounters()
+{
+	thread_local ThreadWorkCounters counters;
+	return counters;
+}
+
+// ************************************************************************* //
+void CollectWorkCounters( WorkStats& stats )
+{
+	WorkRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock( registry.Lock );
+	stats = registry.Finished;
+	for( size_t i=0; i<registry.Threads.size(); ++i )
+		stats.Merge( registry.Threads[i]->Stats );
+}
+
+void ResetWorkCounters()
+{
+	WorkRegistry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock( registry.Lock );
+	registry.Finished.Clear();
+	for( size_t i=0; i<registry.Threads.size(); ++i )
+		registry.Threads[i]->Stats.Clear();
+}
+
+#else
+
+void CollectWorkCounters( WorkStats& stats )
+{
+	stats.Clear();
+}
+
+void ResetWorkCounters()
+{
+}
+
+#endif
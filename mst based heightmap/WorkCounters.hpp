@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+
+/// Build with MST_WORK_COUNTERS=1 to count the work of the kernels. Otherwise
+/// the counters compile to nothing.
+#ifndef MST_WORK_COUNTERS
+#define MST_WORK_COUNTERS 0
+#endif
+
+/// Kinds of work which the kernels count.
+enum WorkCounter
+{
+	WORK_MST_SEGMENTS,		///< Distance tests against MST edges.
+	WORK_RBF_NODES,			///< Nodes evaluated in computeHeight.
+	WORK_LATTICE_HASHES,	///< Lattice samples of the noise functions (Sample2D).
+	WORK_POINTS_SCANNED,	///< Points tested by Voronoi and Worley noise.
+	NUM_WORK_COUNTERS
+};
+
+/// Number of power of two buckets of the per pixel histograms.
+const int WORK_HISTOGRAM_SIZE = 32;
+
+/// \brief Counters of all threads.
+struct WorkStats
+{
+	uint64_t Total[NUM_WORK_COUNTERS];		///< Sum over all pixels.
+	uint64_t Pixels[NUM_WORK_COUNTERS];		///< Number of pixels which did this kind of work.
+	/// Number of pixels per amount of work. Bucket b counts the pixels
+	///	with [2^b, 2^(b+1)) units of work (the last one everything above).
+	uint64_t Histogram[NUM_WORK_COUNTERS][WORK_HISTOGRAM_SIZE];
+
+	WorkStats()	{ Clear(); }
+	void Clear();
+	void Merge( const WorkStats& other );
+
+	/// Average work per pixel which did this kind of work.
+	double GetAverage( int counter ) const	{ return Pixels[counter] ? double(Total[counter]) / double(Pixels[counter]) : 0.0; }
+
+	static const char* GetName( int counter );
+};
+
+/// \brief Sum of the counters of all threads since the last reset.
+/// \details All zero without MST_WORK_COUNTERS. Must not be called while
+///		kernels are running.
+void CollectWorkCounters( WorkStats& stats );
+void ResetWorkCounters();
+
+#if MST_WORK_COUNTERS
+
+/// \brief Counters of one thread. The work of the current pixel is moved
+///		to the statistics by EndPixel.
+struct ThreadWorkCounters
+{
+	uint64_t Pixel[NUM_WORK_COUNTERS];
+	WorkStats Stats;
+
+	ThreadWorkCounters();
+	~ThreadWorkCounters();
+	void EndPixel();
+};
+ThreadWorkCounters& GetThreadWorkCounters();
+
+#define WORK_COUNT( counter, amount )	(GetThreadWorkCounters().Pixel[counter] += uint64_t(amount))
+#define WORK_END_PIXEL()				GetThreadWorkCounters().EndPixel()
+
+#else
+
+#define WORK_COUNT( counter, amount )	((void)0)
+#define WORK_END_PIXEL()				((void)0)
+
+#endif
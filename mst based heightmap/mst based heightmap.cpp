@@ -17,17 +17,30 @@ namespace MstBasedHeightmap
 	{
 		std::string stdString = msclr::interop::marshal_as<std::string>(jsonCode);
 		_nativeGenerator = new ::GeneratorPipeline(stdString);
+		_control = new ::ExecutionControl();
 	}
 
 	GeneratorPipeline::~GeneratorPipeline()
 	{
+		delete _control;
 		delete _nativeGenerator;
 	}
 
-	void GeneratorPipeline::Execute(array<float, 2>^ outData)
+	bool GeneratorPipeline::Execute(array<float, 2>^ outData)
 	{
 		pin_ptr<float> pinnedArray = &outData[0,0];
-		_nativeGenerator->Execute(outData->GetLength(1), outData->GetLength(0), pinnedArray);
+		return _nativeGenerator->Execute(outData->GetLength(1), outData->GetLength(0), pinnedArray,
+			true, 0, nullptr, _control) == ExecuteStatus::OK;
+	}
+
+	void GeneratorPipeline::Cancel()
+	{
+		_control->Cancel();
+	}
+
+	float GeneratorPipeline::Progress::get()
+	{
+		return _control->GetProgress();
 	}
 }
 
@@ -5,6 +5,7 @@ using namespace System::Runtime::InteropServices;
 using namespace System;
 class HeightmapFactory;
 class GeneratorPipeline;
+class ExecutionControl;
 
 namespace MstBasedHeightmap {
 
@@ -23,10 +24,20 @@ namespace MstBasedHeightmap {
 		///		during construction.
 		/// \param [out] outData The array which is filled with the results.
 		///		The size defines the sampling of the map.
-		void Execute(array<float, 2>^ outData);
+		/// \return false if the execution was cancelled. The array is
+		///		incomplete then.
+		bool Execute(array<float, 2>^ outData);
+
+		/// \brief Stop the running and all following executions. Can be
+		///		called from any thread.
+		void Cancel();
+
+		/// \brief Finished fraction [0,1] of the running execution.
+		property float Progress { float get(); }
 
 	private:
 		::GeneratorPipeline* _nativeGenerator;
+		::ExecutionControl* _control;
 	};
 }
 
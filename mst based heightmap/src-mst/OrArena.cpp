@@ -0,0 +1,64 @@
+// ******************************************************************************** //
+// OrArena.cpp																		//
+// ===========																		//
+// This file is part of the OrBaseLib.												//
+//																					//
+// Author: Johannes Jendersie														//
+//																					//
+// Here is a quite easy licensing as open source:									//
+// http://creativecommons.org/licenses/by/3.0/										//
+// If you use parts of this project, please let me know what the purpose of your	//
+// project is. You can do this by writing a comment at github.com/Jojendersie/.		//
+//																					//
+// For details on this project see: Readme.txt										//
+// ******************************************************************************** //
+
+#include "Stdafx.h"
+#include "OrArena.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+
+using namespace OrE::ADT;
+
+// Blocks do not grow beyond this size, larger allocations get an own block.
+static const size_t ARENA_MAX_BLOCK_SIZE = 4 * 1024 * 1024;
+
+// ******************************************************************************** //
+// Get a new block which can hold at least _uiSize bytes. Throws std::bad_alloc
+// if out of memory.
+void* OrE::ADT::MonotonicArena::AllocBlock(size_t _uiSize)
+{
+	// The header is padded such that the data keeps the alignment.
+	const size_t uiHeaderSize = (sizeof(Block) + ALIGNMENT-1) & ~(ALIGNMENT-1);
+	size_t uiSize = std::max(m_uiNextBlockSize, _uiSize + uiHeaderSize);
+	Block* pBlock = (Block*)malloc(uiSize);
+	// The callers construct objects in place, like a failed new.
+	if(!pBlock) throw std::bad_alloc();
+	pBlock->pNext = m_pBlocks;
+	pBlock->uiSize = uiSize;
+	m_pBlocks = pBlock;
+	m_uiNextBlockSize = std::min(m_uiNextBlockSize * 2, ARENA_MAX_BLOCK_SIZE);
+
+	// Continue in the new block. The rest of the old one is wasted.
+	m_pCurrent = (uint8_t*)pBlock + uiHeaderSize + _uiSize;
+	m_pEnd = (uint8_t*)pBlock + uiSize;
+	return (uint8_t*)pBlock + uiHeaderSize;
+}
+
+// ******************************************************************************** //
+// Free all blocks
+void OrE::ADT::MonotonicArena::Release()
+{
+	while( m_pBlocks )
+	{
+		Block* pNext = m_pBlocks->pNext;
+		free( m_pBlocks );
+		m_pBlocks = pNext;
+	}
+	m_pCurrent = m_pEnd = 0;
+	m_uiNumBytes = 0;
+}
+
+// *************************************EOF**************************************** //
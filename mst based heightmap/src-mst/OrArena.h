@@ -0,0 +1,96 @@
+// ******************************************************************************** //
+// OrArena.h																		//
+// =========																		//
+// This file is part of the OrBaseLib.												//
+//																					//
+// Author: Johannes Jendersie														//
+//																					//
+// Here is a quite easy licensing as open source:									//
+// http://creativecommons.org/licenses/by/3.0/										//
+// If you use parts of this project, please let me know what the purpose of your	//
+// project is. You can do this by writing a comment at github.com/Jojendersie/.		//
+//																					//
+// For details on this project see: Readme.txt										//
+// ******************************************************************************** //
+// Monotonic memory arena.															//
+// Memory is taken from large blocks by incrementing a pointer. Single allocations	//
+// are never returned - everything is freed at once when the arena is released or	//
+// destroyed. Objects placed in the arena must be destructed manually if their		//
+// destructor has side effects.														//
+//																					//
+// MonotonicArena:																	//
+//	Alloc()						O(1) amort.											//
+//	Release()					O(#Blocks)											//
+// ******************************************************************************** //
+
+#pragma once
+
+#include <stddef.h>
+
+namespace OrE {
+namespace ADT {
+
+// ******************************************************************************** //
+class MonotonicArena
+{
+private:
+	// Each block starts with this header. The blocks form a single linked list.
+	struct Block
+	{
+		Block* pNext;
+		size_t uiSize;
+	};
+
+	Block*			m_pBlocks;					// Most recent block (head of the list)
+	uint8_t*		m_pCurrent;					// Next free byte in the most recent block
+	uint8_t*		m_pEnd;						// End of the most recent block
+	size_t			m_uiNextBlockSize;			// Size of the next block (grows geometrically)
+	size_t			m_uiNumBytes;				// Allocated bytes (including alignment)
+
+	// Get a new block which can hold at least _uiSize bytes
+	void* AllocBlock(size_t _uiSize);
+
+	// Prevent copy constructor and operator = being generated.
+	MonotonicArena(const MonotonicArena&);
+	MonotonicArena& operator = (const MonotonicArena&);
+public:
+	// All allocations are aligned to this. This is enough for all fundamental types.
+	static const size_t ALIGNMENT = 16;
+
+	// Input: _uiFirstBlockSize - Size of the first block. Choose an estimate of the
+	//			total size to avoid too many blocks.
+	MonotonicArena(size_t _uiFirstBlockSize = 4096) :
+		m_pBlocks(0),
+		m_pCurrent(0),
+		m_pEnd(0),
+		m_uiNextBlockSize(_uiFirstBlockSize),
+		m_uiNumBytes(0)	{}
+
+	~MonotonicArena()					{ Release(); }
+
+	// Get _uiSize bytes of uninitialized memory. Throws std::bad_alloc if out of
+	// memory.
+	void* Alloc(size_t _uiSize)
+	{
+		_uiSize = (_uiSize + ALIGNMENT-1) & ~(ALIGNMENT-1);
+		m_uiNumBytes += _uiSize;
+		if( size_t(m_pEnd - m_pCurrent) >= _uiSize )
+		{
+			void* pResult = m_pCurrent;
+			m_pCurrent += _uiSize;
+			return pResult;
+		}
+		return AllocBlock(_uiSize);
+	}
+
+	// Free all blocks. Each reference into the arena is invalid afterwards.
+	void Release();
+
+	// Sum of all allocation sizes since the last release.
+	size_t GetNumBytes() const			{ return m_uiNumBytes; }
+};
+typedef MonotonicArena* MonotonicArenaP;
+
+}; // namespace ADT
+}; // namespace OrE
+// *************************************EOF**************************************** //
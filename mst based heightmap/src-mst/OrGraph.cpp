@@ -15,6 +15,7 @@
 
 #include "Stdafx.h"
 #include "OrADTObjects.h"
+#include "OrArena.h"
 #include "OrHash.h"
 #include "OrGraph.h"
 
@@ -70,12 +71,13 @@ OrE::ADT::Graph::EdgeCP OrE::ADT::Graph::Node::GetEdge( NodeCP _pNode ) const
 // Destructor deletes all edges, nodes and adjacence objects.
 OrE::ADT::Graph::~Graph()
 {
-	// Go through the pointer array and delete everything
+	// Go through the pointer array and destruct everything. The memory itself
+	// is freed at once by the arena afterwards.
 	for( unsigned int i=0; i<m_Nodes.size(); ++i )
-		delete m_Nodes[i];
+		m_Nodes[i]->~Node();
 
 	for( unsigned int i=0; i<m_Edges.size(); ++i )
-		delete m_Edges[i];
+		m_Edges[i]->~Edge();
 }
 
 
@@ -103,7 +105,7 @@ void OrE::ADT::Graph::Delete( Node* _pNode )
 	{
 		if( m_Edges[i]->GetDst() == _pNode || m_Edges[i]->GetSrc() == _pNode )
 		{
-			delete m_Edges[i];
+			m_Edges[i]->~Edge();
 			m_Edges.erase( m_Edges.begin()+i );
 		}
 	}
@@ -114,7 +116,7 @@ void OrE::ADT::Graph::Delete( Node* _pNode )
 	{
 		if( m_Nodes[i] == _pNode )
 		{
-			delete m_Nodes[i];
+			m_Nodes[i]->~Node();
 			m_Nodes.erase( m_Nodes.begin()+i );
 			break;
 		}
@@ -145,7 +147,7 @@ void OrE::ADT::Graph::Delete( Edge* _pEdge )
 	{
 		if( m_Edges[i] == _pEdge )
 		{
-			delete m_Edges[i];
+			m_Edges[i]->~Edge();
 			m_Edges.erase( m_Edges.begin()+i );
 		}
 	}
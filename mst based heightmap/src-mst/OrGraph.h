@@ -17,11 +17,14 @@
 // Each node can have arbitrary parameters and functions. Therefor a Graph subclass	//
 // has to be implemented.															//
 // Undirected and directed graphs, or even mixed ones are possible.					//
+// All nodes, edges and adjacence lists are allocated from an arena owned by the	//
+// graph. The memory is released at once with the graph.							//
 // ******************************************************************************** //
 
 #pragma once
 
 #include <vector>
+#include <new>
 #include <assert.h>
 #include "../math.hpp"
 
@@ -180,8 +183,12 @@ namespace ADT {
 		};
 		
 	private:
+		// Memory of all nodes, edges and adjacence maps. Must be declared before
+		// anything which uses it.
+		MonotonicArena m_Arena;
+
 		// Lists of Edge and Node data. These lists store each Edge and Node
-		// exactly once. These lists are used to iterate and to clear the memory
+		// exactly once. These lists are used to iterate and to call the destructors
 		// in the graph destructor.
 		// TODO: Test performance with Hashmaps for dynamic and static case.
 		std::vector<NodeP> m_Nodes;
@@ -195,6 +202,7 @@ namespace ADT {
 		// The graph can grow beyond this number or remain smaller. The speed gets
 		// better, if the number is already known. Than no resizing is necessary
 		Graph( uint32_t _uiNumNodes = 32, uint32_t _uiNumEdges = 64 ) : 
+			m_Arena( (_uiNumNodes + _uiNumEdges) * 64 ),
 			m_Nodes(),
 			m_Edges()
 		{
@@ -206,23 +214,29 @@ namespace ADT {
 		// to a node or edge is invalid afterwards.
 		virtual ~Graph();
 
+		// Bytes taken from the arena (including deleted nodes and edges).
+		size_t GetMemoryUsage() const	{ return m_Arena.GetNumBytes(); }
+
 		// ******************************************************************************** //
 		// Graph modification methods
 
-		// Create a new node and return its reference. 0 if out of memory.
+		// Create a new node and return its reference. Throws std::bad_alloc if out
+		// of memory.
 		template<typename _NodeType> _NodeType* AddNode()
 		{
 			// If you end here with the error 'no appropriate default constructor available' or
 			// similar you have added some data values to the nodes declaration., which have no
 			// default constructor. Therefor the compiler cannot create a default ctor for 
 			// _NodeType. Implement it manually.
-			_NodeType* pN = new _NodeType;
+			_NodeType* pN = new (m_Arena.Alloc( sizeof(_NodeType) )) _NodeType;
 			// This line causes an error, if your _NodeType is not derived from Graph::Node!
 			m_Nodes.push_back( pN );
+			pN->m_Adjacence.SetArena( &m_Arena );
 			return pN;
 		}
 
-		// Create a new edge and return its reference. 0 if out of memory.
+		// Create a new edge and return its reference. Throws std::bad_alloc if out
+		// of memory.
 		// This does not check for other existing edges. There are cases where the graph
 		// can have multiple edges between two nodes. If you wanna have unique edges check
 		// with ... before. TODO: aktuell ist nur eine Kante mglich!
@@ -231,7 +245,7 @@ namespace ADT {
 			// If you end here with the error 'no constructor available' or 'function does not
 			// take...' or similar you have not implemented the 3-Param-Edge-Ctor for your
 			// derived class, or _EdgeType is even not of type Edge.
-			_EdgeType* pR = new _EdgeType( _pNSrc, _pNDst, _bDirected );
+			_EdgeType* pR = new (m_Arena.Alloc( sizeof(_EdgeType) )) _EdgeType( _pNSrc, _pNDst, _bDirected );
 			// This line causes an error, if your _EdgeType is not derived from Graph::Edge!
 			EdgeP pE = pR;
 			m_Edges.push_back( pE );
@@ -247,7 +261,8 @@ namespace ADT {
 			return pR;
 		}
 
-		// Remove a node and all edges to that node.
+		// Remove a node and all edges to that node. The memory is not reused
+		// before the graph is deleted.
 		// This is currently very slow: O(n*Degree)
 		void Delete( Node* _pNode );
 
@@ -15,6 +15,7 @@
 
 #include "Stdafx.h"
 #include "OrADTObjects.h"
+#include "OrArena.h"
 #include "OrHash.h"
 
 // Do not use in the file! This causes endless loops in debug garbage collection.
@@ -22,6 +23,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <new>
 #include <algorithm>
 #include <cmath>
 
@@ -30,7 +32,7 @@ using namespace OrE::ADT;
 
 // ******************************************************************************** //
 // Create a 32 bit hash value of a data set
-uint32_t OrE::Algorithm::CreateHash32(const void* pData, const int iSize)
+uint32_t OrE::Algorithm::CreateHash32(const void* pData, const size_t iSize)
 {
 	uint64_t qwHash = CreateHash64(pData, iSize);
 	return ((uint32_t)qwHash) ^ ((uint32_t)(qwHash >> 32));
@@ -38,7 +40,7 @@ uint32_t OrE::Algorithm::CreateHash32(const void* pData, const int iSize)
 
 // ******************************************************************************** //
 // Create a 64 bit hash value of a data set
-uint64_t OrE::Algorithm::CreateHash64(const void* pData, const int iSize)
+uint64_t OrE::Algorithm::CreateHash64(const void* pData, const size_t iSize)
 {
 	uint64_t qwHash = 0x84222325cbf29ce4ULL;
 
@@ -167,18 +169,51 @@ void OrE::ADT::HashMap::RecursiveReAdd(Bucket* _pBucket)
 
 // ******************************************************************************** //
 // Initialization to given start size
-OrE::ADT::HashMap::HashMap( uint32_t _dwSize, Mode _Mode ) :
-	m_apBuckets( 0 )
+OrE::ADT::HashMap::HashMap( uint32_t _dwSize, Mode _Mode, MonotonicArenaP _pArena ) :
+	m_apBuckets( 0 ),
+	m_dwSize( _dwSize ),
+	m_dwNumElements( 0 ),
+	m_Mode( _Mode ),
+	m_pArena( _pArena )
 {
-	// Resize allocates memory too
-	Resize( _dwSize );
-	m_Mode = _Mode;
+	assert(_dwSize > 0 && "HashMap size of 0 is not permitted!");
+	// The table is created by the first Insert(). Many maps (e.g. adjacency
+	// lists of graph nodes) stay empty or are filled after SetArena().
 
 #ifdef _DEBUG
 	m_dwCollsionCounter = 0;
 #endif
 }
 
+// ******************************************************************************** //
+// Change the allocator. This is only possible as long as the map is empty.
+void OrE::ADT::HashMap::SetArena( MonotonicArenaP _pArena )
+{
+	assert( IsEmpty() && "The allocator of a filled HashMap cannot be changed!" );
+	// An empty table could still exist from a previous usage.
+	if( !m_pArena ) free( m_apBuckets );
+	m_apBuckets = 0;
+	m_pArena = _pArena;
+}
+
+// ******************************************************************************** //
+// Create a bucket from the arena or the heap.
+BucketP OrE::ADT::HashMap::NewBucket( void* _pObject, const uint64_t& _qwKey, BucketP _pParent )
+{
+	if( m_pArena )
+		return new (m_pArena->Alloc(sizeof(Bucket))) Bucket(_pObject, _qwKey, _pParent);
+	return new Bucket(_pObject, _qwKey, _pParent);
+}
+
+// ******************************************************************************** //
+// Destroy a bucket. Memory from an arena is not reused.
+void OrE::ADT::HashMap::FreeBucket( BucketP _pBucket )
+{
+	if( m_pArena )
+		_pBucket->~Bucket();
+	else delete _pBucket;
+}
+
 // ******************************************************************************** //
 // Delete data from user and (owned) identifier if in string mode
 void OrE::ADT::HashMap::RemoveData(BucketP _pBucket)
@@ -198,7 +233,7 @@ void OrE::ADT::HashMap::RecursiveRelease(BucketP _pBucket)
 	if(_pBucket->pLeft) RecursiveRelease(_pBucket->pLeft);
 	if(_pBucket->pRight) RecursiveRelease(_pBucket->pRight);
 	// Delete bucket/tree node itself. It is not part of the array.
-	delete _pBucket;
+	FreeBucket(_pBucket);
 }
 
 // ******************************************************************************** //
@@ -208,7 +243,7 @@ OrE::ADT::HashMap::~HashMap()
 	Clear();
 
 	// Delete table itself
-	free( m_apBuckets );
+	if( !m_pArena ) free( m_apBuckets );
 }
 
 // ******************************************************************************** //
@@ -216,7 +251,7 @@ OrE::ADT::HashMap::~HashMap()
 void OrE::ADT::HashMap::Clear()
 {
 	// Remove all binary trees and data.
-	for(uint32_t i=0;i<m_dwSize;++i)
+	if( m_apBuckets ) for(uint32_t i=0;i<m_dwSize;++i)
 	{
 		// Precondition of RecursiveRelease: Bucket exists (not proven in method
 		// for speed up)
@@ -238,7 +273,7 @@ void OrE::ADT::HashMap::Resize(const uint32_t _dwSize)
 	BucketP* pOldList = m_apBuckets;
 	uint32_t dwOldSize = m_dwSize;
 	// Allocate a new larger? table and make it empty
-	m_apBuckets = (BucketP*)malloc(sizeof(BucketP)*_dwSize);
+	m_apBuckets = (BucketP*)(m_pArena ? m_pArena->Alloc(sizeof(BucketP)*_dwSize) : malloc(sizeof(BucketP)*_dwSize));
 	if(!m_apBuckets) return;	// TODO: report error
 	memset(m_apBuckets, 0, sizeof(BucketP)*_dwSize);
 	// Set back properties to empty map
@@ -254,7 +289,7 @@ void OrE::ADT::HashMap::Resize(const uint32_t _dwSize)
 			if(pOldList[i]) RecursiveReAdd(pOldList[i]);
 
 		// Delete old list
-		free(pOldList);
+		if( !m_pArena ) free(pOldList);
 	}
 }
 
@@ -296,7 +331,9 @@ int OrE::ADT::HashMap::ListIndex(BucketP _pBucket)
 // Standard operation insert
 ADTElementP OrE::ADT::HashMap::Insert(void* _pObject, uint64_t _qwKey)
 {
-	// It seems that during initialization an out-of-memory error occured.
+	// The table is created on demand.
+	if( !m_apBuckets ) Resize( m_dwSize );
+	// It seems that an out-of-memory error occured.
 	assert( m_apBuckets );
 
 	TestSize();
@@ -314,10 +351,10 @@ ADTElementP OrE::ADT::HashMap::Insert(void* _pObject, uint64_t _qwKey)
 			// compare key -> tree search
 			if( pBucket->IsGreater( _qwKey ) )
 				if(pBucket->pLeft) pBucket = pBucket->pLeft;	// traverse
-				else {pBucket->pLeft = new Bucket(_pObject, _qwKey, pBucket); ++m_dwNumElements; return pBucket->pLeft;}
+				else {pBucket->pLeft = NewBucket(_pObject, _qwKey, pBucket); ++m_dwNumElements; return pBucket->pLeft;}
 			else if( pBucket->IsLess( _qwKey ) )
 				if(pBucket->pRight) pBucket = pBucket->pRight;	// traverse
-				else {pBucket->pRight = new Bucket(_pObject, _qwKey, pBucket); ++m_dwNumElements; return pBucket->pRight;}
+				else {pBucket->pRight = NewBucket(_pObject, _qwKey, pBucket); ++m_dwNumElements; return pBucket->pRight;}
 			else {
 				// This data already exists. It is obvious that this element collides with itself.
 #ifdef _DEBUG
@@ -329,7 +366,7 @@ ADTElementP OrE::ADT::HashMap::Insert(void* _pObject, uint64_t _qwKey)
 		}
 	} else
 	{
-		m_apBuckets[dwHash] = new Bucket(_pObject, _qwKey, BucketP(m_apBuckets+dwHash));
+		m_apBuckets[dwHash] = NewBucket(_pObject, _qwKey, BucketP(m_apBuckets+dwHash));
 		++m_dwNumElements;
 		return m_apBuckets[dwHash];
 	}
@@ -385,7 +422,7 @@ void OrE::ADT::HashMap::Delete( ADTElementP _pElement )
 	
 	// Delete data
 	RemoveData(pElement);
-	delete pElement;
+	FreeBucket(pElement);
 	// Now it is removed
 	--m_dwNumElements;
 }
@@ -394,6 +431,7 @@ void OrE::ADT::HashMap::Delete( ADTElementP _pElement )
 // Standard search with a key
 ADTElementP OrE::ADT::HashMap::Search( uint64_t _qwKey )
 {
+	if( !m_apBuckets ) return 0;
 	// Find correct bucked with hashing
 	uint32_t dwHash = _qwKey%m_dwSize;
 	BucketP pBucket = m_apBuckets[dwHash];
@@ -409,6 +447,7 @@ ADTElementP OrE::ADT::HashMap::Search( uint64_t _qwKey )
 
 const ADTElement* OrE::ADT::HashMap::Search( uint64_t _qwKey ) const
 {
+	if( !m_apBuckets ) return 0;
 	// Find correct bucked with hashing
 	uint32_t dwHash = _qwKey%m_dwSize;
 	BucketP pBucket = m_apBuckets[dwHash];
@@ -427,7 +466,9 @@ const ADTElement* OrE::ADT::HashMap::Search( uint64_t _qwKey ) const
 // insert using strings
 ADTElementP OrE::ADT::HashMap::Insert( void* _pObject, const char* _pcKey )
 {
-	// It seems that during initialization an out-of-memory error occured.
+	// The table is created on demand.
+	if( !m_apBuckets ) Resize( m_dwSize );
+	// It seems that an out-of-memory error occured.
 	assert( m_apBuckets );
 
 	assert( _pcKey );
@@ -450,10 +491,10 @@ ADTElementP OrE::ADT::HashMap::Insert( void* _pObject, const char* _pcKey )
 			// It could be that the map contains elements without a string.
 			if( pBucket->IsGreater( uiKey, _pcKey ) )
 				if(pBucket->pLeft) pBucket = pBucket->pLeft;	// traverse
-				else {pBucket->pLeft = new Bucket(_pObject, uiKey, pBucket); bAdded = true;}
+				else {pBucket->pLeft = NewBucket(_pObject, uiKey, pBucket); bAdded = true;}
 			else if( pBucket->IsLess( uiKey, _pcKey ) )
 				if(pBucket->pRight) pBucket = pBucket->pRight;	// traverse
-				else {pBucket->pRight = new Bucket(_pObject, uiKey, pBucket); bAdded = true;}
+				else {pBucket->pRight = NewBucket(_pObject, uiKey, pBucket); bAdded = true;}
 			else {
 				// This data already exists. It is obvious that this element collides with itself.
 #ifdef _DEBUG
@@ -467,7 +508,7 @@ ADTElementP OrE::ADT::HashMap::Insert( void* _pObject, const char* _pcKey )
 	} else
 	{
 		// Empty bucket
-		pBucket = m_apBuckets[dwHash] = new Bucket(_pObject, uiKey, BucketP(m_apBuckets+dwHash));
+		pBucket = m_apBuckets[dwHash] = NewBucket(_pObject, uiKey, BucketP(m_apBuckets+dwHash));
 	}
 
 	// Copy string.
@@ -491,6 +532,7 @@ void OrE::ADT::HashMap::Delete( const char* _pcKey )
 ADTElementP OrE::ADT::HashMap::Search( const char* _pcKey )
 {
 	assert( _pcKey );
+	if( !m_apBuckets ) return 0;
 
 	// Find bucket with hashing
 	uint64_t uiKey = OrStringHash(_pcKey);
@@ -509,6 +551,7 @@ ADTElementP OrE::ADT::HashMap::Search( const char* _pcKey )
 // ******************************************************************************** //
 ADTElementP OrE::ADT::HashMap::GetFirst()
 {
+	if( IsEmpty() ) return 0;
 	for(uint32_t i=0;i<m_dwSize;++i)
 		// Skip all empty buckets.
 		if(m_apBuckets[i])
@@ -523,6 +566,7 @@ ADTElementP OrE::ADT::HashMap::GetFirst()
 // ******************************************************************************** //
 ADTElementP OrE::ADT::HashMap::GetLast()
 {
+	if( IsEmpty() ) return 0;
 	for(uint32_t i=m_dwSize-1;i>=0;--i)
 		// Skip all empty buckets.
 		if(m_apBuckets[i])
@@ -547,7 +591,8 @@ ADTElementP OrE::ADT::HashMap::GetNext(ADTElementP _pCurrent)
 		// if we are in the right branch now. Then we have to move much more upwards
 		// until we come back from a left branch.
 		int iIndex = ListIndex(pBuck->pParent);
-		while(pBuck->pParent->pRight == pBuck && iIndex==-1)
+		// The parent of a tree root is the table entry - do not dereference it.
+		while(iIndex==-1 && pBuck->pParent->pRight == pBuck)
 		{
 			pBuck = pBuck->pParent;
 			iIndex = ListIndex(pBuck->pParent);
@@ -577,7 +622,7 @@ ADTElementP OrE::ADT::HashMap::GetPrevious(ADTElementP _pCurrent)
 		// if we are in the left branch now. Then we have to move much more upwards
 		// until we come back from a right branch.
 		int iIndex = ListIndex(pBuck->pParent);
-		while(pBuck->pParent->pLeft == pBuck && iIndex==-1) 
+		while(iIndex==-1 && pBuck->pParent->pLeft == pBuck)
 		{
 			pBuck = pBuck->pParent;
 			iIndex = ListIndex(pBuck->pParent);
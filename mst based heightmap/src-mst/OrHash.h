@@ -42,8 +42,8 @@ namespace Algorithm {
 
 // ******************************************************************************** //
 // Standard hash for any data. Should result in nice uniform distributions mostly.
-uint32_t CreateHash32(const void* pData, const int iSize);	// Create a 32 bit hash value of a data set
-uint64_t CreateHash64(const void* pData, const int iSize);	// Create a 64 bit hash value of a data set
+uint32_t CreateHash32(const void* pData, const size_t iSize);	// Create a 32 bit hash value of a data set
+uint64_t CreateHash64(const void* pData, const size_t iSize);	// Create a 64 bit hash value of a data set
 uint32_t CreateHash32(const void* pData);					// Create a 32 bit hash value of a 0-terminated data set (e.g. strings)
 uint64_t CreateHash64(const void* pData);					// Create a 64 bit hash value of a 0-terminated data set (e.g. strings)
 
@@ -125,7 +125,10 @@ private:
 	uint32_t			m_dwSize;					// Size of the array and therewith of hash map
 	uint32_t			m_dwNumElements;			// Number of elements currently in map (can be larger than array size)
 	Mode			m_Mode;						// Modes set in initialization (String mode?, Resize mode?)
+	MonotonicArenaP	m_pArena;					// If set, the table and the buckets are taken from this arena
 
+	BucketP NewBucket(void* _pObject, const uint64_t& _qwKey, BucketP _pParent);
+	void FreeBucket(BucketP _pBucket);
 	void RemoveData(BucketP _pBucket);
 	void RecursiveReAdd(BucketP _pBucket);
 	void RecursiveRelease(BucketP _pBucket);
@@ -137,9 +140,16 @@ private:
 	HashMap& operator = (const HashMap&);
 public:
 
-	HashMap(uint32_t _dwSize, Mode _Mode);
+	// The table is allocated lazily with the first insertion.
+	// Input: _pArena - Optional arena for the table and all buckets. Memory is not
+	//			given back to the arena on deletion/resize. The arena must outlive
+	//			the map.
+	HashMap(uint32_t _dwSize, Mode _Mode, MonotonicArenaP _pArena = 0);
 	virtual ~HashMap();
 
+	// Change the allocator. This is only possible as long as the map is empty.
+	void SetArena(MonotonicArenaP _pArena);
+
 	// Remove everything
 	void Clear();
 
@@ -185,7 +195,7 @@ public:
 	// Size of table array. This is not the number of elements (GetNumElements).
 	uint32_t GetSize() const			{return m_dwSize;}
 
-	typedef Iterator<ADTElement> Iterator;
+	typedef OrE::ADT::Iterator<ADTElement> Iterator;
 
 #ifdef _DEBUG
 	uint32_t m_dwCollsionCounter;
@@ -18,10 +18,12 @@
 
 #include "Stdafx.h"
 #include <limits.h>
+#include <limits>
 #include <math.h>
 #include <stdint.h>
 
 #include "OrADTObjects.h"
+#include "OrArena.h"
 #include "OrHash.h"
 #include "OrGraph.h"
 #include "OrHeap.h"